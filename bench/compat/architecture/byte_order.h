@@ -0,0 +1,16 @@
+#ifndef __compat_architecture_byte_order_h
+#define __compat_architecture_byte_order_h
+
+// <architecture/byte_order.h> for the Linux benchmark build
+
+#include <libkern/OSByteOrder.h>
+
+enum NXByteOrder{
+    NX_UnknownByteOrder,
+    NX_LittleEndian,
+    NX_BigEndian
+};
+
+enum NXByteOrder NXHostByteOrder(void);
+
+#endif
@@ -0,0 +1,119 @@
+#include <stddef.h>
+#include <mach-o/swap.h>
+
+/*
+ * the byte order functions of libSystem the parser calls, for the Linux benchmark build
+ * every swap_ function turns the struct around in place, which way doesn't matter for a byte swap
+ */
+
+enum NXByteOrder NXHostByteOrder(void){
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return NX_BigEndian;
+#else
+    return NX_LittleEndian;
+#endif
+}
+
+// swaps count consecutive 32 bit fields starting at p
+static void swap_words(void *p, size_t count){
+    uint32_t *word = p;
+
+    for(size_t i = 0; i < count; i++)
+        word[i] = OSSwapInt32(word[i]);
+}
+
+#define swap_all_words(p) swap_words((p), sizeof(*(p)) / sizeof(uint32_t))
+
+void swap_fat_header(struct fat_header *fat_header, enum NXByteOrder target_byte_order){
+    swap_all_words(fat_header);
+}
+
+void swap_fat_arch(struct fat_arch *fat_archs, uint32_t nfat_arch, enum NXByteOrder target_byte_order){
+    for(uint32_t i = 0; i < nfat_arch; i++)
+        swap_all_words(&fat_archs[i]);
+}
+
+void swap_mach_header(struct mach_header *mh, enum NXByteOrder target_byte_order){
+    swap_all_words(mh);
+}
+
+void swap_mach_header_64(struct mach_header_64 *mh, enum NXByteOrder target_byte_order){
+    swap_all_words(mh);
+}
+
+void swap_load_command(struct load_command *lc, enum NXByteOrder target_byte_order){
+    swap_all_words(lc);
+}
+
+void swap_segment_command(struct segment_command *sg, enum NXByteOrder target_byte_order){
+    swap_words(&sg->cmd, 2);
+    swap_words(&sg->vmaddr, 8);
+}
+
+void swap_segment_command_64(struct segment_command_64 *sg, enum NXByteOrder target_byte_order){
+    swap_words(&sg->cmd, 2);
+    sg->vmaddr = OSSwapInt64(sg->vmaddr);
+    sg->vmsize = OSSwapInt64(sg->vmsize);
+    sg->fileoff = OSSwapInt64(sg->fileoff);
+    sg->filesize = OSSwapInt64(sg->filesize);
+    swap_words(&sg->maxprot, 4);
+}
+
+void swap_section(struct section *s, uint32_t nsects, enum NXByteOrder target_byte_order){
+    for(uint32_t i = 0; i < nsects; i++)
+        swap_words(&s[i].addr, 9);
+}
+
+void swap_section_64(struct section_64 *s, uint32_t nsects, enum NXByteOrder target_byte_order){
+    for(uint32_t i = 0; i < nsects; i++){
+        s[i].addr = OSSwapInt64(s[i].addr);
+        s[i].size = OSSwapInt64(s[i].size);
+        swap_words(&s[i].offset, 8);
+    }
+}
+
+void swap_dylib_command(struct dylib_command *dl, enum NXByteOrder target_byte_order){
+    swap_all_words(dl);
+}
+
+void swap_symtab_command(struct symtab_command *st, enum NXByteOrder target_byte_order){
+    swap_all_words(st);
+}
+
+void swap_dysymtab_command(struct dysymtab_command *dyst, enum NXByteOrder target_byte_order){
+    swap_all_words(dyst);
+}
+
+void swap_entry_point_command(struct entry_point_command *ep, enum NXByteOrder target_byte_order){
+    swap_words(&ep->cmd, 2);
+    ep->entryoff = OSSwapInt64(ep->entryoff);
+    ep->stacksize = OSSwapInt64(ep->stacksize);
+}
+
+void swap_linkedit_data_command(struct linkedit_data_command *ld, enum NXByteOrder target_byte_order){
+    swap_all_words(ld);
+}
+
+void swap_uuid_command(struct uuid_command *uuid_cmd, enum NXByteOrder target_byte_order){
+    swap_words(&uuid_cmd->cmd, 2);
+}
+
+void swap_dyld_info_command(struct dyld_info_command *ed, enum NXByteOrder target_byte_order){
+    swap_all_words(ed);
+}
+
+void swap_nlist(struct nlist *symbols, uint32_t nsymbols, enum NXByteOrder target_byte_order){
+    for(uint32_t i = 0; i < nsymbols; i++){
+        symbols[i].n_un.n_strx = OSSwapInt32(symbols[i].n_un.n_strx);
+        symbols[i].n_desc = (int16_t)OSSwapInt16((uint16_t)symbols[i].n_desc);
+        symbols[i].n_value = OSSwapInt32(symbols[i].n_value);
+    }
+}
+
+void swap_nlist_64(struct nlist_64 *symbols, uint32_t nsymbols, enum NXByteOrder target_byte_order){
+    for(uint32_t i = 0; i < nsymbols; i++){
+        symbols[i].n_un.n_strx = OSSwapInt32(symbols[i].n_un.n_strx);
+        symbols[i].n_desc = OSSwapInt16(symbols[i].n_desc);
+        symbols[i].n_value = OSSwapInt64(symbols[i].n_value);
+    }
+}
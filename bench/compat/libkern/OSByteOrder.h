@@ -0,0 +1,19 @@
+#ifndef __compat_libkern_osbyteorder_h
+#define __compat_libkern_osbyteorder_h
+
+// <libkern/OSByteOrder.h> for the Linux benchmark build, little endian hosts only
+
+#include <stdint.h>
+
+#define OSSwapInt16(x) __builtin_bswap16(x)
+#define OSSwapInt32(x) __builtin_bswap32(x)
+#define OSSwapInt64(x) __builtin_bswap64(x)
+
+#define OSSwapBigToHostInt16(x) __builtin_bswap16(x)
+#define OSSwapBigToHostInt32(x) __builtin_bswap32(x)
+#define OSSwapBigToHostInt64(x) __builtin_bswap64(x)
+#define OSSwapHostToBigInt16(x) __builtin_bswap16(x)
+#define OSSwapHostToBigInt32(x) __builtin_bswap32(x)
+#define OSSwapHostToBigInt64(x) __builtin_bswap64(x)
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef __compat_mach_o_fat_h
+#define __compat_mach_o_fat_h
+
+// <mach-o/fat.h> for the Linux benchmark build, the fat header and arch table are big endian on disk
+
+#include <mach-o/loader.h>
+
+#define FAT_MAGIC 0xcafebabe
+#define FAT_CIGAM 0xbebafeca
+
+struct fat_header{
+    uint32_t magic;
+    uint32_t nfat_arch;
+};
+
+struct fat_arch{
+    cpu_type_t cputype;
+    cpu_subtype_t cpusubtype;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t align;
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef __compat_mach_o_loader_h
+#define __compat_mach_o_loader_h
+
+/*
+ * the parts of the SDK's <mach-o/loader.h> the parser uses, so it builds on Linux for the benchmarks
+ * layouts and values are copied from the SDK, nothing here is meant for anything but little endian hosts
+ */
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <sys/types.h>
+
+typedef int cpu_type_t;
+typedef int cpu_subtype_t;
+typedef int vm_prot_t;
+typedef int integer_t;
+typedef uint64_t mach_vm_address_t;
+typedef uint64_t mach_vm_size_t;
+
+#define CPU_ARCH_ABI64    0x01000000
+#define CPU_TYPE_ANY      (-1)
+#define CPU_TYPE_X86      7
+#define CPU_TYPE_I386     CPU_TYPE_X86
+#define CPU_TYPE_X86_64   (CPU_TYPE_X86 | CPU_ARCH_ABI64)
+#define CPU_TYPE_ARM      12
+#define CPU_TYPE_ARM64    (CPU_TYPE_ARM | CPU_ARCH_ABI64)
+#define CPU_SUBTYPE_MASK  0xff000000
+#define CPU_SUBTYPE_ARM64E 2
+
+struct mach_header{
+    uint32_t magic;
+    cpu_type_t cputype;
+    cpu_subtype_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+};
+
+struct mach_header_64{
+    uint32_t magic;
+    cpu_type_t cputype;
+    cpu_subtype_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+#define MH_MAGIC    0xfeedface
+#define MH_CIGAM    0xcefaedfe
+#define MH_MAGIC_64 0xfeedfacf
+#define MH_CIGAM_64 0xcffaedfe
+
+#define MH_OBJECT  0x1
+#define MH_EXECUTE 0x2
+#define MH_DYLIB   0x6
+
+#define MH_NOUNDEFS 0x1
+#define MH_DYLDLINK 0x4
+#define MH_TWOLEVEL 0x80
+#define MH_PIE      0x200000
+
+struct load_command{
+    uint32_t cmd;
+    uint32_t cmdsize;
+};
+
+#define LC_REQ_DYLD           0x80000000
+#define LC_SEGMENT            0x1
+#define LC_SYMTAB             0x2
+#define LC_DYSYMTAB           0xb
+#define LC_LOAD_DYLIB         0xc
+#define LC_ID_DYLIB           0xd
+#define LC_LOAD_WEAK_DYLIB    (0x18 | LC_REQ_DYLD)
+#define LC_SEGMENT_64         0x19
+#define LC_UUID               0x1b
+#define LC_CODE_SIGNATURE     0x1d
+#define LC_REEXPORT_DYLIB     (0x1f | LC_REQ_DYLD)
+#define LC_LAZY_LOAD_DYLIB    0x20
+#define LC_DYLD_INFO          0x22
+#define LC_DYLD_INFO_ONLY     (0x22 | LC_REQ_DYLD)
+#define LC_LOAD_UPWARD_DYLIB  (0x23 | LC_REQ_DYLD)
+#define LC_FUNCTION_STARTS    0x26
+#define LC_MAIN               (0x28 | LC_REQ_DYLD)
+#define LC_DATA_IN_CODE       0x29
+#define LC_DYLD_EXPORTS_TRIE  (0x33 | LC_REQ_DYLD)
+#define LC_DYLD_CHAINED_FIXUPS (0x34 | LC_REQ_DYLD)
+
+union lc_str{
+    uint32_t offset;
+};
+
+struct segment_command{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    char segname[16];
+    uint32_t vmaddr;
+    uint32_t vmsize;
+    uint32_t fileoff;
+    uint32_t filesize;
+    vm_prot_t maxprot;
+    vm_prot_t initprot;
+    uint32_t nsects;
+    uint32_t flags;
+};
+
+struct segment_command_64{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    char segname[16];
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    uint64_t fileoff;
+    uint64_t filesize;
+    vm_prot_t maxprot;
+    vm_prot_t initprot;
+    uint32_t nsects;
+    uint32_t flags;
+};
+
+struct section{
+    char sectname[16];
+    char segname[16];
+    uint32_t addr;
+    uint32_t size;
+    uint32_t offset;
+    uint32_t align;
+    uint32_t reloff;
+    uint32_t nreloc;
+    uint32_t flags;
+    uint32_t reserved1;
+    uint32_t reserved2;
+};
+
+struct section_64{
+    char sectname[16];
+    char segname[16];
+    uint64_t addr;
+    uint64_t size;
+    uint32_t offset;
+    uint32_t align;
+    uint32_t reloff;
+    uint32_t nreloc;
+    uint32_t flags;
+    uint32_t reserved1;
+    uint32_t reserved2;
+    uint32_t reserved3;
+};
+
+#define S_REGULAR                 0x0
+#define S_CSTRING_LITERALS        0x2
+#define S_ATTR_PURE_INSTRUCTIONS  0x80000000
+#define S_ATTR_SOME_INSTRUCTIONS  0x00000400
+
+struct dylib{
+    union lc_str name;
+    uint32_t timestamp;
+    uint32_t current_version;
+    uint32_t compatibility_version;
+};
+
+struct dylib_command{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    struct dylib dylib;
+};
+
+struct symtab_command{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t symoff;
+    uint32_t nsyms;
+    uint32_t stroff;
+    uint32_t strsize;
+};
+
+struct dysymtab_command{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t ilocalsym;
+    uint32_t nlocalsym;
+    uint32_t iextdefsym;
+    uint32_t nextdefsym;
+    uint32_t iundefsym;
+    uint32_t nundefsym;
+    uint32_t tocoff;
+    uint32_t ntoc;
+    uint32_t modtaboff;
+    uint32_t nmodtab;
+    uint32_t extrefsymoff;
+    uint32_t nextrefsyms;
+    uint32_t indirectsymoff;
+    uint32_t nindirectsyms;
+    uint32_t extreloff;
+    uint32_t nextrel;
+    uint32_t locreloff;
+    uint32_t nlocrel;
+};
+
+struct entry_point_command{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint64_t entryoff;
+    uint64_t stacksize;
+};
+
+struct linkedit_data_command{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t dataoff;
+    uint32_t datasize;
+};
+
+struct uuid_command{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint8_t uuid[16];
+};
+
+struct dyld_info_command{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t rebase_off;
+    uint32_t rebase_size;
+    uint32_t bind_off;
+    uint32_t bind_size;
+    uint32_t weak_bind_off;
+    uint32_t weak_bind_size;
+    uint32_t lazy_bind_off;
+    uint32_t lazy_bind_size;
+    uint32_t export_off;
+    uint32_t export_size;
+};
+
+#define REBASE_TYPE_POINTER                               1
+#define REBASE_TYPE_TEXT_ABSOLUTE32                       2
+#define REBASE_TYPE_TEXT_PCREL32                          3
+#define REBASE_OPCODE_MASK                                0xF0
+#define REBASE_IMMEDIATE_MASK                             0x0F
+#define REBASE_OPCODE_DONE                                0x00
+#define REBASE_OPCODE_SET_TYPE_IMM                        0x10
+#define REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB         0x20
+#define REBASE_OPCODE_ADD_ADDR_ULEB                       0x30
+#define REBASE_OPCODE_ADD_ADDR_IMM_SCALED                 0x40
+#define REBASE_OPCODE_DO_REBASE_IMM_TIMES                 0x50
+#define REBASE_OPCODE_DO_REBASE_ULEB_TIMES                0x60
+#define REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB             0x70
+#define REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB  0x80
+
+#define BIND_TYPE_POINTER                                 1
+#define BIND_SPECIAL_DYLIB_SELF                           0
+#define BIND_SPECIAL_DYLIB_MAIN_EXECUTABLE                (-1)
+#define BIND_SPECIAL_DYLIB_FLAT_LOOKUP                    (-2)
+#define BIND_SPECIAL_DYLIB_WEAK_LOOKUP                    (-3)
+#define BIND_SYMBOL_FLAGS_WEAK_IMPORT                     0x1
+#define BIND_SYMBOL_FLAGS_NON_WEAK_DEFINITION             0x8
+#define BIND_OPCODE_MASK                                  0xF0
+#define BIND_IMMEDIATE_MASK                               0x0F
+#define BIND_OPCODE_DONE                                  0x00
+#define BIND_OPCODE_SET_DYLIB_ORDINAL_IMM                 0x10
+#define BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB                0x20
+#define BIND_OPCODE_SET_DYLIB_SPECIAL_IMM                 0x30
+#define BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM         0x40
+#define BIND_OPCODE_SET_TYPE_IMM                          0x50
+#define BIND_OPCODE_SET_ADDEND_SLEB                       0x60
+#define BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB           0x70
+#define BIND_OPCODE_ADD_ADDR_ULEB                         0x80
+#define BIND_OPCODE_DO_BIND                               0x90
+#define BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB                 0xA0
+#define BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED           0xB0
+#define BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB      0xC0
+#define BIND_OPCODE_THREADED                              0xD0
+
+#define EXPORT_SYMBOL_FLAGS_KIND_MASK                     0x03
+#define EXPORT_SYMBOL_FLAGS_KIND_REGULAR                  0x00
+#define EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL             0x01
+#define EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE                 0x02
+#define EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION               0x04
+#define EXPORT_SYMBOL_FLAGS_REEXPORT                      0x08
+#define EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER             0x10
+
+#include <mach-o/nlist.h>
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __compat_mach_o_swap_h
+#define __compat_mach_o_swap_h
+
+// <mach-o/swap.h> for the Linux benchmark build, implemented in compat.c
+
+#include <mach-o/loader.h>
+#include <mach-o/fat.h>
+#include <architecture/byte_order.h>
+
+void swap_fat_header(struct fat_header *fat_header, enum NXByteOrder target_byte_order);
+void swap_fat_arch(struct fat_arch *fat_archs, uint32_t nfat_arch, enum NXByteOrder target_byte_order);
+void swap_mach_header(struct mach_header *mh, enum NXByteOrder target_byte_order);
+void swap_mach_header_64(struct mach_header_64 *mh, enum NXByteOrder target_byte_order);
+void swap_load_command(struct load_command *lc, enum NXByteOrder target_byte_order);
+void swap_segment_command(struct segment_command *sg, enum NXByteOrder target_byte_order);
+void swap_segment_command_64(struct segment_command_64 *sg, enum NXByteOrder target_byte_order);
+void swap_section(struct section *s, uint32_t nsects, enum NXByteOrder target_byte_order);
+void swap_section_64(struct section_64 *s, uint32_t nsects, enum NXByteOrder target_byte_order);
+void swap_dylib_command(struct dylib_command *dl, enum NXByteOrder target_byte_order);
+void swap_symtab_command(struct symtab_command *st, enum NXByteOrder target_byte_order);
+void swap_dysymtab_command(struct dysymtab_command *dyst, enum NXByteOrder target_byte_order);
+void swap_entry_point_command(struct entry_point_command *ep, enum NXByteOrder target_byte_order);
+void swap_linkedit_data_command(struct linkedit_data_command *ld, enum NXByteOrder target_byte_order);
+void swap_uuid_command(struct uuid_command *uuid_cmd, enum NXByteOrder target_byte_order);
+void swap_dyld_info_command(struct dyld_info_command *ed, enum NXByteOrder target_byte_order);
+void swap_nlist(struct nlist *symbols, uint32_t nsymbols, enum NXByteOrder target_byte_order);
+void swap_nlist_64(struct nlist_64 *symbols, uint32_t nsymbols, enum NXByteOrder target_byte_order);
+
+#endif
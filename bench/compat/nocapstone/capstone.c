@@ -0,0 +1,30 @@
+#include <stdlib.h>
+#include <capstone/capstone.h>
+
+// see capstone/capstone.h, nothing can be opened so nothing past cs_open ever runs
+
+cs_err cs_open(cs_arch arch, cs_mode mode, csh *handle){
+    *handle = 0;
+    return CS_ERR_ARCH;
+}
+
+cs_err cs_close(csh *handle){
+    *handle = 0;
+    return CS_ERR_OK;
+}
+
+cs_err cs_option(csh handle, cs_opt_type type, size_t value){
+    return CS_ERR_ARCH;
+}
+
+cs_insn* cs_malloc(csh handle){
+    return NULL;
+}
+
+void cs_free(cs_insn *insn, size_t count){
+    free(insn);
+}
+
+bool cs_disasm_iter(csh handle, const uint8_t **code, size_t *size, uint64_t *address, cs_insn *insn){
+    return false;
+}
@@ -0,0 +1,65 @@
+#ifndef __compat_capstone_h
+#define __compat_capstone_h
+
+/*
+ * stands in for Capstone when it isn't installed, just the API the parser calls
+ * cs_open always fails, so the parser prints no disassembly and the benchmark reports the stage as skipped
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef size_t csh;
+
+typedef enum cs_arch{
+    CS_ARCH_ARM,
+    CS_ARCH_ARM64,
+    CS_ARCH_X86
+} cs_arch;
+
+typedef enum cs_mode{
+    CS_MODE_LITTLE_ENDIAN = 0,
+    CS_MODE_ARM = 0,
+    CS_MODE_16 = 1 << 1,
+    CS_MODE_32 = 1 << 2,
+    CS_MODE_64 = 1 << 3,
+    CS_MODE_THUMB = 1 << 4
+} cs_mode;
+
+typedef enum cs_opt_type{
+    CS_OPT_INVALID = 0,
+    CS_OPT_SYNTAX,
+    CS_OPT_DETAIL,
+    CS_OPT_MODE
+} cs_opt_type;
+
+typedef enum cs_opt_value{
+    CS_OPT_OFF = 0,
+    CS_OPT_ON = 3
+} cs_opt_value;
+
+typedef enum cs_err{
+    CS_ERR_OK = 0,
+    CS_ERR_MEM,
+    CS_ERR_ARCH
+} cs_err;
+
+typedef struct cs_insn{
+    unsigned int id;
+    uint64_t address;
+    uint16_t size;
+    uint8_t bytes[24];
+    char mnemonic[32];
+    char op_str[160];
+    void *detail;
+} cs_insn;
+
+cs_err cs_open(cs_arch arch, cs_mode mode, csh *handle);
+cs_err cs_close(csh *handle);
+cs_err cs_option(csh handle, cs_opt_type type, size_t value);
+cs_insn* cs_malloc(csh handle);
+void cs_free(cs_insn *insn, size_t count);
+bool cs_disasm_iter(csh handle, const uint8_t **code, size_t *size, uint64_t *address, cs_insn *insn);
+
+#endif
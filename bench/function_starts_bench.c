@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "function_starts.h"
+
+/*
+ * decodes a synthetic LC_FUNCTION_STARTS blob with the scalar and the default decoder
+ * the delta mix follows real arm64 code: mostly short functions, a tail of big ones
+ * usage: function_starts_bench [megabytes] [iterations]
+ */
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t write_uleb(uint8_t *out, uint64_t value){
+    size_t n = 0;
+
+    do{
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+
+        if(value)
+            byte |= 0x80;
+
+        out[n++] = byte;
+    } while(value);
+
+    return n;
+}
+
+static uint64_t random_delta(void){
+    int bucket = rand() % 100;
+
+    // 4 byte aligned like arm64 functions, never 0 which would end the list
+    if(bucket < 70)
+        return 4 * (1 + rand() % 31);        // one byte
+    if(bucket < 97)
+        return 4 * (32 + rand() % 4000);     // two bytes
+    return 4 * (4096 + rand() % 200000);     // three bytes
+}
+
+int main(int argc, const char *argv[]){
+    size_t megabytes = argc > 1 ? strtoul(argv[1], NULL, 10) : 8;
+    int iterations = argc > 2 ? atoi(argv[2]) : 10;
+    size_t capacity = megabytes * 1048576;
+
+    uint8_t *blob = malloc(capacity + 16);
+    uint64_t *expected = malloc(capacity * sizeof(uint64_t));
+    uint64_t *reference = malloc(capacity * sizeof(uint64_t));
+    uint64_t *results = malloc(capacity * sizeof(uint64_t));
+
+    if(!blob || !expected || !reference || !results){
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    srand(1);
+
+    const uint64_t base = 0x100000000ULL;
+    uint64_t address = base;
+    uint32_t functions = 0;
+    size_t size = 0;
+
+    while(size + 10 < capacity){
+        uint64_t delta = random_delta();
+
+        size += write_uleb(blob + size, delta);
+        address += delta;
+        expected[functions++] = address;
+    }
+
+    blob[size++] = 0;
+
+    printf("%u function starts in %.1f MiB, default decoder: %s\n",
+           functions, size / 1048576.0, macho_function_starts_decoder_name());
+
+    int failures = 0;
+
+    for(int vectorized = 0; vectorized <= 1; vectorized++){
+        uint64_t *out = vectorized ? results : reference;
+        uint32_t count = 0;
+        double best = 0;
+
+        for(int i = 0; i < iterations; i++){
+            double start = now();
+
+            if(vectorized)
+                count = macho_decode_function_starts(blob, size, base, out, (uint32_t)size);
+            else
+                count = macho_decode_function_starts_scalar(blob, size, base, out, (uint32_t)size);
+
+            double seconds = now() - start;
+
+            if(i == 0 || seconds < best)
+                best = seconds;
+        }
+
+        int match = count == functions && memcmp(out, expected, functions * sizeof(uint64_t)) == 0;
+
+        printf("%-8s %9.1f MiB/s %8.1f M starts/s%s\n",
+               vectorized ? macho_function_starts_decoder_name() : "scalar",
+               size / 1048576.0 / best,
+               count / best / 1e6,
+               match ? "" : "  MISMATCH");
+
+        if(!match)
+            failures++;
+    }
+
+    free(blob);
+    free(expected);
+    free(reference);
+    free(results);
+
+    return failures ? 1 : 0;
+}
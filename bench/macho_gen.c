@@ -0,0 +1,831 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mach-o/fat.h>
+#include <mach-o/nlist.h>
+#include <libkern/OSByteOrder.h>
+#include "macho_gen.h"
+#include "mach-o.h"
+#include "objc.h"
+#include "sha.h"
+
+#define GEN_BASE          0x100000000ULL
+#define GEN_PAGE          0x1000 // code signature page
+#define GEN_SEGMENT_ALIGN 0x4000
+#define GEN_FAT_ALIGN     14
+#define GEN_IDENTIFIER    "com.example.macho-gen"
+
+// segment indexes the rebase and bind opcodes refer to
+#define GEN_SEGMENT_DATA 2
+
+#define gen_align(x, a) (((x) + (a) - 1) & ~(uint64_t)((a) - 1))
+
+typedef struct{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    bool failed;
+} gen_buffer;
+
+// size zeroed bytes at the end of buffer, NULL once anything failed to grow
+static uint8_t* gen_reserve(gen_buffer *buffer, size_t size){
+    if(buffer->failed)
+        return NULL;
+
+    if(buffer->size + size > buffer->capacity){
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+
+        while(capacity < buffer->size + size)
+            capacity *= 2;
+
+        uint8_t *grown = realloc(buffer->data, capacity);
+
+        if(!grown){
+            buffer->failed = true;
+            return NULL;
+        }
+
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+
+    uint8_t *p = buffer->data + buffer->size;
+
+    memset(p, 0, size);
+    buffer->size += size;
+
+    return p;
+}
+
+static void gen_append(gen_buffer *buffer, const void *data, size_t size){
+    uint8_t *p = gen_reserve(buffer, size);
+
+    if(p)
+        memcpy(p, data, size);
+}
+
+static void gen_byte(gen_buffer *buffer, uint8_t byte){
+    gen_append(buffer, &byte, 1);
+}
+
+// offset of the copy of s in buffer
+static uint32_t gen_string(gen_buffer *buffer, const char *s){
+    uint32_t offset = (uint32_t)buffer->size;
+
+    gen_append(buffer, s, strlen(s) + 1);
+
+    return offset;
+}
+
+static void gen_uleb(gen_buffer *buffer, uint64_t value){
+    do{
+        uint8_t byte = value & 0x7f;
+
+        value >>= 7;
+        gen_byte(buffer, value ? byte | 0x80 : byte);
+    } while(value);
+}
+
+// a ULEB128 that always takes 5 bytes, so a trie node can point at children that aren't written yet
+#define GEN_ULEB_PADDED 5
+
+static void gen_uleb_padded(uint8_t *p, uint64_t value){
+    for(int i = 0; i < GEN_ULEB_PADDED - 1; i++)
+        p[i] = ((value >> (7 * i)) & 0x7f) | 0x80;
+
+    p[GEN_ULEB_PADDED - 1] = (value >> (7 * (GEN_ULEB_PADDED - 1))) & 0x7f;
+}
+
+static void gen_pad(gen_buffer *buffer, size_t alignment){
+    gen_reserve(buffer, gen_align(buffer->size, alignment) - buffer->size);
+}
+
+static void gen_put32(uint8_t *p, uint32_t value){
+    memcpy(p, &value, sizeof(value));
+}
+
+static void gen_put64(uint8_t *p, uint64_t value){
+    memcpy(p, &value, sizeof(value));
+}
+
+static void gen_put32_big(uint8_t *p, uint32_t value){
+    gen_put32(p, OSSwapHostToBigInt32(value));
+}
+
+static void gen_dylib_name(uint32_t index, char *name, size_t size){
+    if(index == 0)
+        snprintf(name, size, "/usr/lib/libSystem.B.dylib");
+    else
+        snprintf(name, size, "/usr/lib/libgen%06u.dylib", index);
+}
+
+static uint32_t gen_dylib_command_size(uint32_t index){
+    char name[64];
+
+    gen_dylib_name(index, name, sizeof(name));
+
+    return (uint32_t)gen_align(sizeof(struct dylib_command) + strlen(name) + 1, 8);
+}
+
+// fills __text with functions of stride bytes, the last one runs to the end
+// straight line arithmetic and loads ending in a return, so a disassembler walks all of it
+static void gen_text(uint8_t *text, size_t size, uint32_t stride, uint32_t functions, bool x86){
+    static const uint32_t arm64_body[] = {
+        0x91000420, // add x0, x1, #1
+        0xf9400020, // ldr x0, [x1]
+        0xaa0103e0, // mov x0, x1
+        0x8b020020  // add x0, x1, x2
+    };
+    static const uint8_t x86_body[4] = {0x48, 0x83, 0xc0, 0x01}; // add rax, 1
+    static const uint8_t x86_ret[4] = {0x0f, 0x1f, 0x00, 0xc3};  // nop dword [rax]; ret
+
+    for(size_t i = 0; i < size / 4; i++){
+        if(x86)
+            memcpy(text + 4 * i, x86_body, 4);
+        else
+            gen_put32(text + 4 * i, arm64_body[i % (sizeof(arm64_body) / sizeof(arm64_body[0]))]);
+    }
+
+    for(uint32_t i = 0; i < functions; i++){
+        size_t end = i + 1 < functions ? (size_t)(i + 1) * stride : size;
+
+        if(x86)
+            memcpy(text + end - 4, x86_ret, 4);
+        else
+            gen_put32(text + end - 4, 0xd65f03c0); // ret
+    }
+}
+
+/*
+ * one node of the export trie for the sorted names [first, last) that share their first depth characters
+ * children are split on the next character and their edges take the longest prefix the names under them share
+ */
+static void gen_trie_node(gen_buffer *trie, char **names, const uint64_t *offsets, uint32_t first, uint32_t last, size_t depth){
+    if(names[first][depth] == '\0'){
+        gen_buffer info = {0};
+
+        gen_uleb(&info, EXPORT_SYMBOL_FLAGS_KIND_REGULAR);
+        gen_uleb(&info, offsets[first]);
+        gen_uleb(trie, info.size);
+        gen_append(trie, info.data, info.size);
+        trie->failed |= info.failed;
+        free(info.data);
+        first++;
+    } else {
+        gen_byte(trie, 0);
+    }
+
+    uint32_t children = 0;
+
+    for(uint32_t i = first; i < last; children++){
+        uint32_t j = i;
+
+        while(j < last && names[j][depth] == names[i][depth])
+            j++;
+
+        i = j;
+    }
+
+    gen_byte(trie, (uint8_t)children);
+
+    // edges first with room for the child offsets, the children follow in the same order
+    size_t *patch = calloc(children ? children : 1, sizeof(size_t));
+    uint32_t *bounds = calloc(2 * (size_t)children + 1, sizeof(uint32_t));
+    size_t *ends = calloc(children ? children : 1, sizeof(size_t));
+
+    if(!patch || !bounds || !ends){
+        trie->failed = true;
+        free(patch);
+        free(bounds);
+        free(ends);
+        return;
+    }
+
+    uint32_t child = 0;
+
+    for(uint32_t i = first; i < last; child++){
+        uint32_t j = i;
+
+        while(j < last && names[j][depth] == names[i][depth])
+            j++;
+
+        // sorted, so the first and last name of the group share what all of them do
+        size_t end = depth;
+
+        while(names[i][end] != '\0' && names[i][end] == names[j - 1][end])
+            end++;
+
+        gen_append(trie, names[i] + depth, end - depth);
+        gen_byte(trie, 0);
+        patch[child] = trie->size;
+        gen_reserve(trie, GEN_ULEB_PADDED);
+        bounds[2 * child] = i;
+        bounds[2 * child + 1] = j;
+        ends[child] = end;
+        i = j;
+    }
+
+    for(child = 0; child < children && !trie->failed; child++){
+        gen_uleb_padded(trie->data + patch[child], trie->size);
+        gen_trie_node(trie, names, offsets, bounds[2 * child], bounds[2 * child + 1], ends[child]);
+    }
+
+    free(patch);
+    free(bounds);
+    free(ends);
+}
+
+static int gen_compare_offsets(const void *a, const void *b){
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+// the rebase opcodes for pointers at the sorted __DATA offsets
+static void gen_rebase_opcodes(gen_buffer *rebase, const uint32_t *offsets, uint32_t count){
+    if(count){
+        gen_byte(rebase, REBASE_OPCODE_SET_TYPE_IMM | REBASE_TYPE_POINTER);
+        gen_byte(rebase, REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | GEN_SEGMENT_DATA);
+        gen_uleb(rebase, offsets[0]);
+
+        for(uint32_t i = 0; i + 1 < count; i++){
+            gen_byte(rebase, REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB);
+            gen_uleb(rebase, offsets[i + 1] - offsets[i] - sizeof(uint64_t));
+        }
+
+        gen_byte(rebase, REBASE_OPCODE_DO_REBASE_IMM_TIMES | 1);
+    }
+
+    gen_byte(rebase, REBASE_OPCODE_DONE);
+}
+
+// objc metadata goes into __DATA, every pointer it holds is recorded for the rebase opcodes
+typedef struct{
+    uint8_t *data;
+    uint64_t address;    // of data
+    uint32_t *rebases;
+    uint32_t num_rebases;
+} gen_data;
+
+static void gen_pointer(gen_data *data, uint64_t offset, uint64_t value){
+    gen_put64(data->data + offset, value);
+
+    if(value)
+        data->rebases[data->num_rebases++] = (uint32_t)offset;
+}
+
+uint8_t* macho_gen_image(const macho_gen_options *options, size_t *size, macho_gen_counts *counts){
+    uint32_t dylibs = options->dylibs ? options->dylibs : 1;
+    uint32_t symbols = options->symbols ? options->symbols : 1; // LC_MAIN points at the first one
+    uint32_t classes = options->classes;
+    uint32_t methods = options->methods;
+    bool x86 = options->cputype == CPU_TYPE_X86_64;
+
+    // the load commands come first and their size decides where everything else starts
+    uint32_t ncmds = 11 + dylibs;
+    uint32_t sizeofcmds = 4 * sizeof(struct segment_command_64) + 6 * sizeof(struct section_64) +
+                          sizeof(struct dyld_info_command) + sizeof(struct symtab_command) + sizeof(struct dysymtab_command) +
+                          sizeof(struct uuid_command) + sizeof(struct entry_point_command) + 2 * sizeof(struct linkedit_data_command);
+
+    for(uint32_t i = 0; i < dylibs; i++)
+        sizeofcmds += gen_dylib_command_size(i);
+
+    uint64_t text_off = gen_align(sizeof(struct mach_header_64) + sizeofcmds, GEN_PAGE);
+    uint64_t text_size = (uint64_t)options->code_pages * GEN_PAGE;
+
+    if(text_size < (uint64_t)symbols * 8)
+        text_size = gen_align((uint64_t)symbols * 8, GEN_PAGE);
+
+    uint32_t stride = (uint32_t)(text_size / symbols) & ~3u;
+
+    // __cstring: class names, one selector per method index shared by every class, one type encoding
+    gen_buffer cstrings = {0};
+    uint32_t *class_names = calloc(classes ? classes : 1, sizeof(uint32_t));
+    uint32_t *method_names = calloc(methods ? methods : 1, sizeof(uint32_t));
+    char name[64];
+
+    if(!class_names || !method_names){
+        free(class_names);
+        free(method_names);
+        return NULL;
+    }
+
+    for(uint32_t i = 0; i < classes; i++){
+        snprintf(name, sizeof(name), MACHO_GEN_CLASS_FORMAT, i);
+        class_names[i] = gen_string(&cstrings, name);
+    }
+
+    for(uint32_t i = 0; i < methods; i++){
+        snprintf(name, sizeof(name), MACHO_GEN_METHOD_FORMAT, i);
+        method_names[i] = gen_string(&cstrings, name);
+    }
+
+    uint32_t method_type = gen_string(&cstrings, "v16@0:8");
+    uint64_t cstring_off = text_off + text_size;
+    uint64_t data_off = gen_align(cstring_off + cstrings.size, GEN_SEGMENT_ALIGN);
+
+    // __DATA: __objc_classlist, __objc_const (class data and method lists), __objc_data (classes), __got and
+    // the selector references relative method lists name their methods through
+    uint32_t method_size = options->relative_methods ? sizeof(struct _objc_2_class_relative_method) : 3 * sizeof(uint64_t);
+    uint64_t method_list_size = gen_align(sizeof(struct _objc_2_class_method_info) + (uint64_t)method_size * methods, sizeof(uint64_t));
+    uint64_t const_off = (uint64_t)classes * sizeof(uint64_t);
+    uint64_t const_size = (uint64_t)classes * 2 * (sizeof(struct _objc_2_class_data) + method_list_size);
+    uint64_t objc_data_off = const_off + const_size;
+    uint64_t objc_data_size = (uint64_t)classes * 2 * sizeof(struct _objc_2_class);
+    uint64_t got_off = objc_data_off + objc_data_size;
+    uint64_t selrefs_off = got_off + (uint64_t)dylibs * sizeof(uint64_t);
+    uint64_t data_size = selrefs_off + (options->relative_methods ? (uint64_t)methods * sizeof(uint64_t) : 0);
+    uint64_t data_segment_size = gen_align(data_size, GEN_SEGMENT_ALIGN);
+    uint64_t link_off = data_off + data_segment_size;
+
+    gen_data data;
+
+    data.data = calloc(data_size, 1);
+    data.address = GEN_BASE + data_off;
+    data.rebases = calloc((size_t)classes * (8 + 6 * (size_t)methods) + methods + 1, sizeof(uint32_t));
+    data.num_rebases = 0;
+
+    if(!data.data || !data.rebases){
+        free(data.data);
+        free(data.rebases);
+        free(class_names);
+        free(method_names);
+        free(cstrings.data);
+        return NULL;
+    }
+
+    for(uint32_t i = 0; i < classes; i++){
+        uint64_t class_off = objc_data_off + (uint64_t)i * 2 * sizeof(struct _objc_2_class);
+        uint64_t metaclass_off = class_off + sizeof(struct _objc_2_class);
+
+        gen_pointer(&data, (uint64_t)i * sizeof(uint64_t), data.address + class_off);
+
+        for(int meta = 0; meta < 2; meta++){
+            uint64_t ro_off = const_off + ((uint64_t)i * 2 + meta) * (sizeof(struct _objc_2_class_data) + method_list_size);
+            uint64_t list_off = ro_off + sizeof(struct _objc_2_class_data);
+            uint64_t cls_off = meta ? metaclass_off : class_off;
+            uint8_t *ro = data.data + ro_off;
+
+            gen_put32(ro + offsetof(struct _objc_2_class_data, flags), meta ? 1 : 0);
+            gen_put32(ro + offsetof(struct _objc_2_class_data, instanceStart), 8);
+            gen_put32(ro + offsetof(struct _objc_2_class_data, instanceSize), 8);
+            gen_pointer(&data, ro_off + offsetof(struct _objc_2_class_data, name), GEN_BASE + cstring_off + class_names[i]);
+
+            if(methods)
+                gen_pointer(&data, ro_off + offsetof(struct _objc_2_class_data, methods), data.address + list_off);
+
+            gen_put32(data.data + list_off, method_size | (options->relative_methods ? 0x80000000 : 0));
+            gen_put32(data.data + list_off + sizeof(uint32_t), methods);
+
+            for(uint32_t m = 0; m < methods; m++){
+                uint64_t entry = list_off + sizeof(struct _objc_2_class_method_info) + (uint64_t)m * method_size;
+                uint32_t function = (uint32_t)(((uint64_t)i * methods + m) % symbols);
+
+                // each field is an offset from its own address, which needs no rebase
+                if(options->relative_methods){
+                    uint64_t address = data.address + entry;
+
+                    gen_put32(data.data + entry, (uint32_t)(data.address + selrefs_off + (uint64_t)m * sizeof(uint64_t) - address));
+                    gen_put32(data.data + entry + 4, (uint32_t)(GEN_BASE + cstring_off + method_type - (address + 4)));
+                    gen_put32(data.data + entry + 8, (uint32_t)(GEN_BASE + text_off + (uint64_t)function * stride - (address + 8)));
+                    continue;
+                }
+
+                gen_pointer(&data, entry, GEN_BASE + cstring_off + method_names[m]);
+                gen_pointer(&data, entry + sizeof(uint64_t), GEN_BASE + cstring_off + method_type);
+                gen_pointer(&data, entry + 2 * sizeof(uint64_t), GEN_BASE + text_off + (uint64_t)function * stride);
+            }
+
+            // a class's isa is its metaclass, the metaclass's would be bound to NSObject's and stays 0 here
+            if(!meta)
+                gen_pointer(&data, cls_off, data.address + metaclass_off);
+
+            gen_pointer(&data, cls_off + offsetof(struct _objc_2_class, data), data.address + ro_off);
+        }
+    }
+
+    for(uint32_t m = 0; options->relative_methods && m < methods; m++)
+        gen_pointer(&data, selrefs_off + (uint64_t)m * sizeof(uint64_t), GEN_BASE + cstring_off + method_names[m]);
+
+    qsort(data.rebases, data.num_rebases, sizeof(uint32_t), gen_compare_offsets);
+
+    // __LINKEDIT: rebases, binds, exports, function starts, symbols, strings and then the signature
+    gen_buffer link = {0};
+    gen_buffer piece = {0};
+    char **names = calloc(symbols, sizeof(char*));
+    uint64_t *offsets = calloc(symbols, sizeof(uint64_t));
+    uint32_t nsyms = symbols + dylibs;
+
+    if(!names || !offsets)
+        link.failed = true;
+
+    for(uint32_t i = 0; i < symbols && !link.failed; i++){
+        snprintf(name, sizeof(name), MACHO_GEN_SYMBOL_FORMAT, i);
+        names[i] = strdup(name);
+        offsets[i] = text_off + (uint64_t)i * stride;
+
+        if(!names[i])
+            link.failed = true;
+    }
+
+    uint64_t rebase_off = link.size;
+
+    gen_rebase_opcodes(&link, data.rebases, data.num_rebases);
+    gen_pad(&link, 8);
+
+    uint64_t rebase_size = link.size - rebase_off;
+    uint64_t bind_off = link.size;
+
+    for(uint32_t i = 0; i < dylibs; i++){
+        if(i + 1 <= BIND_IMMEDIATE_MASK){
+            gen_byte(&link, BIND_OPCODE_SET_DYLIB_ORDINAL_IMM | (i + 1));
+        } else {
+            gen_byte(&link, BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB);
+            gen_uleb(&link, i + 1);
+        }
+
+        snprintf(name, sizeof(name), MACHO_GEN_IMPORT_FORMAT, i);
+        gen_byte(&link, BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM);
+        gen_string(&link, name);
+        gen_byte(&link, BIND_OPCODE_SET_TYPE_IMM | BIND_TYPE_POINTER);
+        gen_byte(&link, BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB | GEN_SEGMENT_DATA);
+        gen_uleb(&link, got_off + (uint64_t)i * sizeof(uint64_t));
+        gen_byte(&link, BIND_OPCODE_DO_BIND);
+    }
+
+    gen_byte(&link, BIND_OPCODE_DONE);
+    gen_pad(&link, 8);
+
+    uint64_t bind_size = link.size - bind_off;
+    uint64_t export_off = link.size;
+
+    if(!link.failed)
+        gen_trie_node(&piece, names, offsets, 0, symbols, 0);
+
+    gen_append(&link, piece.data, piece.size);
+    link.failed |= piece.failed;
+    gen_pad(&link, 8);
+
+    uint64_t export_size = link.size - export_off;
+    uint64_t function_starts_off = link.size;
+
+    for(uint32_t i = 0; i < symbols; i++)
+        gen_uleb(&link, i ? stride : text_off);
+
+    gen_byte(&link, 0);
+    gen_pad(&link, 8);
+
+    uint64_t function_starts_size = link.size - function_starts_off;
+
+    // the defined functions first and then one import per dylib, as the dysymtab says
+    gen_buffer strings = {0};
+
+    gen_string(&strings, " ");
+
+    uint64_t symbols_off = link.size;
+
+    for(uint32_t i = 0; i < nsyms; i++){
+        struct nlist_64 nl;
+
+        memset(&nl, 0, sizeof(nl));
+
+        if(i < symbols){
+            nl.n_un.n_strx = gen_string(&strings, names ? names[i] : "");
+            nl.n_type = N_SECT | N_EXT;
+            nl.n_sect = 1;
+            nl.n_value = GEN_BASE + offsets[i];
+        } else {
+            snprintf(name, sizeof(name), MACHO_GEN_IMPORT_FORMAT, i - symbols);
+            nl.n_un.n_strx = gen_string(&strings, name);
+            nl.n_type = N_UNDF | N_EXT;
+            nl.n_desc = (uint16_t)((i - symbols + 1) << 8); // library ordinal
+        }
+
+        gen_append(&link, &nl, sizeof(nl));
+    }
+
+    gen_pad(&strings, 8);
+
+    uint64_t strings_off = link.size;
+
+    gen_append(&link, strings.data, strings.size);
+    link.failed |= strings.failed;
+
+    // the signature starts off a page boundary, the last code page gets hashed only up to it
+    uint64_t signature_off = gen_align(link_off + link.size, 16);
+
+    if(signature_off % GEN_PAGE == 0)
+        signature_off += 16;
+
+    uint32_t code_pages = (uint32_t)((signature_off + GEN_PAGE - 1) / GEN_PAGE);
+    uint32_t ident_offset = sizeof(struct code_directory);
+    uint32_t hash_offset = ident_offset + sizeof(GEN_IDENTIFIER);
+    uint32_t directory_size = hash_offset + code_pages * MACHO_SHA256_DIGEST_LENGTH;
+    uint32_t directory_offset = sizeof(SuperBlob) + sizeof(BlobIndex);
+    uint32_t signature_size = (uint32_t)gen_align(directory_offset + directory_size, 16);
+    uint64_t total = signature_off + signature_size;
+    uint8_t *image = link.failed || cstrings.failed ? NULL : calloc(total, 1);
+
+    if(image){
+        uint8_t *p = image;
+        struct mach_header_64 header;
+
+        memset(&header, 0, sizeof(header));
+        header.magic = MH_MAGIC_64;
+        header.cputype = options->cputype;
+        header.cpusubtype = x86 ? 3 : 0;
+        header.filetype = MH_EXECUTE;
+        header.ncmds = ncmds;
+        header.sizeofcmds = sizeofcmds;
+        header.flags = MH_DYLDLINK | MH_TWOLEVEL | MH_PIE;
+        memcpy(p, &header, sizeof(header));
+        p += sizeof(header);
+
+        // segments with their sections, in file order
+        struct{
+            const char *name;
+            uint64_t vmaddr, vmsize, fileoff, filesize;
+            vm_prot_t prot;
+            uint32_t nsects;
+        } segments[] = {
+            {"__PAGEZERO", 0, GEN_BASE, 0, 0, 0, 0},
+            {"__TEXT", GEN_BASE, data_off, 0, data_off, 5, 2},
+            {"__DATA", GEN_BASE + data_off, data_segment_size, data_off, data_segment_size, 3, 4},
+            {"__LINKEDIT", GEN_BASE + link_off, gen_align(total - link_off, GEN_SEGMENT_ALIGN), link_off, total - link_off, 1, 0}
+        };
+        struct{
+            const char *segment, *name;
+            uint64_t offset, size;
+            uint32_t align, flags;
+        } sections[] = {
+            {"__TEXT", "__text", text_off, text_size, 2, S_ATTR_PURE_INSTRUCTIONS | S_ATTR_SOME_INSTRUCTIONS},
+            {"__TEXT", "__cstring", cstring_off, cstrings.size, 0, S_CSTRING_LITERALS},
+            {"__DATA", kObjc2ClassList, data_off, const_off, 3, 0},
+            {"__DATA", "__objc_const", data_off + const_off, const_size, 3, 0},
+            {"__DATA", "__objc_data", data_off + objc_data_off, objc_data_size, 3, 0},
+            {"__DATA", "__got", data_off + got_off, data_size - got_off, 3, 0}
+        };
+        uint32_t section = 0;
+
+        for(size_t i = 0; i < sizeof(segments) / sizeof(segments[0]); i++){
+            struct segment_command_64 segment;
+
+            memset(&segment, 0, sizeof(segment));
+            segment.cmd = LC_SEGMENT_64;
+            segment.cmdsize = sizeof(segment) + segments[i].nsects * sizeof(struct section_64);
+            memcpy(segment.segname, segments[i].name, strlen(segments[i].name));
+            segment.vmaddr = segments[i].vmaddr;
+            segment.vmsize = segments[i].vmsize;
+            segment.fileoff = segments[i].fileoff;
+            segment.filesize = segments[i].filesize;
+            segment.maxprot = segments[i].prot;
+            segment.initprot = segments[i].prot;
+            segment.nsects = segments[i].nsects;
+            memcpy(p, &segment, sizeof(segment));
+            p += sizeof(segment);
+
+            for(uint32_t j = 0; j < segments[i].nsects; j++, section++){
+                struct section_64 sect;
+
+                memset(&sect, 0, sizeof(sect));
+                memcpy(sect.sectname, sections[section].name, strlen(sections[section].name));
+                memcpy(sect.segname, sections[section].segment, strlen(sections[section].segment));
+                sect.addr = GEN_BASE + sections[section].offset;
+                sect.size = sections[section].size;
+                sect.offset = (uint32_t)sections[section].offset;
+                sect.align = sections[section].align;
+                sect.flags = sections[section].flags;
+                memcpy(p, &sect, sizeof(sect));
+                p += sizeof(sect);
+            }
+        }
+
+        struct dyld_info_command dyld_info;
+
+        memset(&dyld_info, 0, sizeof(dyld_info));
+        dyld_info.cmd = LC_DYLD_INFO_ONLY;
+        dyld_info.cmdsize = sizeof(dyld_info);
+        dyld_info.rebase_off = (uint32_t)(link_off + rebase_off);
+        dyld_info.rebase_size = (uint32_t)rebase_size;
+        dyld_info.bind_off = (uint32_t)(link_off + bind_off);
+        dyld_info.bind_size = (uint32_t)bind_size;
+        dyld_info.export_off = (uint32_t)(link_off + export_off);
+        dyld_info.export_size = (uint32_t)export_size;
+        memcpy(p, &dyld_info, sizeof(dyld_info));
+        p += sizeof(dyld_info);
+
+        struct symtab_command symtab = {LC_SYMTAB, sizeof(symtab), (uint32_t)(link_off + symbols_off), nsyms,
+                                        (uint32_t)(link_off + strings_off), (uint32_t)strings.size};
+
+        memcpy(p, &symtab, sizeof(symtab));
+        p += sizeof(symtab);
+
+        struct dysymtab_command dysymtab;
+
+        memset(&dysymtab, 0, sizeof(dysymtab));
+        dysymtab.cmd = LC_DYSYMTAB;
+        dysymtab.cmdsize = sizeof(dysymtab);
+        dysymtab.nextdefsym = symbols;
+        dysymtab.iundefsym = symbols;
+        dysymtab.nundefsym = dylibs;
+        memcpy(p, &dysymtab, sizeof(dysymtab));
+        p += sizeof(dysymtab);
+
+        struct uuid_command uuid = {LC_UUID, sizeof(uuid)};
+
+        for(int i = 0; i < 16; i++)
+            uuid.uuid[i] = (uint8_t)(0x4d + i * 17 + symbols * 31 + classes * 7 + options->cputype);
+
+        memcpy(p, &uuid, sizeof(uuid));
+        p += sizeof(uuid);
+
+        for(uint32_t i = 0; i < dylibs; i++){
+            struct dylib_command dylib;
+
+            memset(&dylib, 0, sizeof(dylib));
+            dylib.cmd = LC_LOAD_DYLIB;
+            dylib.cmdsize = gen_dylib_command_size(i);
+            dylib.dylib.name.offset = sizeof(dylib);
+            dylib.dylib.timestamp = 2;
+            dylib.dylib.current_version = 0x10000;
+            dylib.dylib.compatibility_version = 0x10000;
+            gen_dylib_name(i, name, sizeof(name));
+            memcpy(p, &dylib, sizeof(dylib));
+            memcpy(p + sizeof(dylib), name, strlen(name));
+            p += dylib.cmdsize;
+        }
+
+        struct entry_point_command entry_point = {LC_MAIN, sizeof(entry_point), offsets[0], 0};
+
+        memcpy(p, &entry_point, sizeof(entry_point));
+        p += sizeof(entry_point);
+
+        struct linkedit_data_command function_starts = {LC_FUNCTION_STARTS, sizeof(function_starts),
+                                                        (uint32_t)(link_off + function_starts_off), (uint32_t)function_starts_size};
+        struct linkedit_data_command code_signature = {LC_CODE_SIGNATURE, sizeof(code_signature),
+                                                       (uint32_t)signature_off, signature_size};
+
+        memcpy(p, &function_starts, sizeof(function_starts));
+        p += sizeof(function_starts);
+        memcpy(p, &code_signature, sizeof(code_signature));
+
+        gen_text(image + text_off, text_size, stride, symbols, x86);
+        memcpy(image + cstring_off, cstrings.data, cstrings.size);
+        memcpy(image + data_off, data.data, data_size);
+        memcpy(image + link_off, link.data, link.size);
+
+        // an ad-hoc signature: one code directory hashing every page up to the signature with SHA-256
+        uint8_t *signature = image + signature_off;
+        uint8_t *directory = signature + directory_offset;
+
+        gen_put32_big(signature, CSMAGIC_EMBEDDED_SIGNATURE);
+        gen_put32_big(signature + 4, signature_size);
+        gen_put32_big(signature + 8, 1);
+        gen_put32_big(signature + 12, CSSLOT_CODEDIRECTORY);
+        gen_put32_big(signature + 16, directory_offset);
+
+        gen_put32_big(directory + offsetof(struct code_directory, blob.magic), CSMAGIC_CODEDIRECTORY);
+        gen_put32_big(directory + offsetof(struct code_directory, blob.length), directory_size);
+        gen_put32_big(directory + offsetof(struct code_directory, version), 0x20100);
+        gen_put32_big(directory + offsetof(struct code_directory, flags), 0x2); // adhoc
+        gen_put32_big(directory + offsetof(struct code_directory, hashOffset), hash_offset);
+        gen_put32_big(directory + offsetof(struct code_directory, identOffset), ident_offset);
+        gen_put32_big(directory + offsetof(struct code_directory, nCodeSlots), code_pages);
+        gen_put32_big(directory + offsetof(struct code_directory, codeLimit), (uint32_t)signature_off);
+        directory[offsetof(struct code_directory, hashSize)] = MACHO_SHA256_DIGEST_LENGTH;
+        directory[offsetof(struct code_directory, hashType)] = HASH_TYPE_SHA256;
+        directory[offsetof(struct code_directory, pageSize)] = 12;
+        memcpy(directory + ident_offset, GEN_IDENTIFIER, sizeof(GEN_IDENTIFIER));
+
+        for(uint32_t i = 0; i < code_pages; i++){
+            uint64_t start = (uint64_t)i * GEN_PAGE;
+            uint64_t length = signature_off - start < GEN_PAGE ? signature_off - start : GEN_PAGE;
+
+            macho_sha256(image + start, length, directory + hash_offset + i * MACHO_SHA256_DIGEST_LENGTH);
+        }
+
+        *size = total;
+
+        if(counts){
+            counts->load_commands = ncmds;
+            counts->symbols = nsyms;
+            counts->methods = 2 * classes * methods;
+            counts->rebases = data.num_rebases;
+            counts->code_pages = code_pages;
+            counts->size = total;
+        }
+    }
+
+    for(uint32_t i = 0; names && i < symbols; i++)
+        free(names[i]);
+
+    free(names);
+    free(offsets);
+    free(piece.data);
+    free(strings.data);
+    free(link.data);
+    free(data.data);
+    free(data.rebases);
+    free(class_names);
+    free(method_names);
+    free(cstrings.data);
+
+    return image;
+}
+
+uint8_t* macho_gen_fat(const macho_gen_options *slices, uint32_t count, size_t *size, macho_gen_counts *counts){
+    uint8_t **images = calloc(count ? count : 1, sizeof(uint8_t*));
+    size_t *sizes = calloc(count ? count : 1, sizeof(size_t));
+    uint64_t *offsets = calloc(count ? count : 1, sizeof(uint64_t));
+    uint8_t *fat = NULL;
+
+    if(counts)
+        memset(counts, 0, sizeof(macho_gen_counts));
+
+    if(!images || !sizes || !offsets)
+        goto done;
+
+    uint64_t total = gen_align(sizeof(struct fat_header) + (uint64_t)count * sizeof(struct fat_arch), 1 << GEN_FAT_ALIGN);
+
+    for(uint32_t i = 0; i < count; i++){
+        macho_gen_counts slice;
+
+        images[i] = macho_gen_image(&slices[i], &sizes[i], &slice);
+
+        if(!images[i])
+            goto done;
+
+        if(counts){
+            counts->load_commands += slice.load_commands;
+            counts->symbols += slice.symbols;
+            counts->methods += slice.methods;
+            counts->rebases += slice.rebases;
+            counts->code_pages += slice.code_pages;
+        }
+
+        offsets[i] = total;
+        total = gen_align(total + sizes[i], 1 << GEN_FAT_ALIGN);
+    }
+
+    // the last slice isn't padded
+    if(count)
+        total = offsets[count - 1] + sizes[count - 1];
+
+    fat = calloc(total, 1);
+
+    if(!fat)
+        goto done;
+
+    gen_put32_big(fat, FAT_MAGIC);
+    gen_put32_big(fat + 4, count);
+
+    for(uint32_t i = 0; i < count; i++){
+        const struct mach_header_64 *header = (const struct mach_header_64*)images[i];
+        uint8_t *arch = fat + sizeof(struct fat_header) + i * sizeof(struct fat_arch);
+
+        gen_put32_big(arch + offsetof(struct fat_arch, cputype), header->cputype);
+        gen_put32_big(arch + offsetof(struct fat_arch, cpusubtype), header->cpusubtype);
+        gen_put32_big(arch + offsetof(struct fat_arch, offset), (uint32_t)offsets[i]);
+        gen_put32_big(arch + offsetof(struct fat_arch, size), (uint32_t)sizes[i]);
+        gen_put32_big(arch + offsetof(struct fat_arch, align), GEN_FAT_ALIGN);
+        memcpy(fat + offsets[i], images[i], sizes[i]);
+    }
+
+    *size = total;
+
+    if(counts)
+        counts->size = total;
+
+done:
+    for(uint32_t i = 0; images && i < count; i++)
+        free(images[i]);
+
+    free(images);
+    free(sizes);
+    free(offsets);
+
+    return fat;
+}
+
+bool macho_gen_parse_cpu(const char *name, cpu_type_t *cputype){
+    if(strcmp(name, "arm64") == 0)
+        *cputype = CPU_TYPE_ARM64;
+    else if(strcmp(name, "x86_64") == 0)
+        *cputype = CPU_TYPE_X86_64;
+    else
+        return false;
+
+    return true;
+}
+
+bool macho_gen_write(const char *path, const uint8_t *data, size_t size){
+    FILE *file = fopen(path, "wb");
+
+    if(!file)
+        return false;
+
+    bool written = fwrite(data, 1, size, file) == size;
+
+    return fclose(file) == 0 && written;
+}
@@ -0,0 +1,56 @@
+#ifndef __macho_gen_h
+#define __macho_gen_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <mach-o/loader.h>
+
+/*
+ * writes synthetic 64 bit mach-o executables for the benchmarks, so parse speed can be tracked
+ * without shipping Apple binaries around
+ * an image has __PAGEZERO, __TEXT (__text and __cstring), __DATA (objc metadata, selector references and a __got) and __LINKEDIT with
+ * rebase and bind opcodes, an export trie, LC_FUNCTION_STARTS, a symbol table and an ad-hoc code signature
+ * whose SHA-256 page hashes are real, so every page verifies
+ * addresses are the file offset plus 0x100000000, like a linker lays out a small executable
+ */
+
+typedef struct{
+    cpu_type_t cputype;  // CPU_TYPE_ARM64 or CPU_TYPE_X86_64, picks the instructions filling __text
+    uint32_t dylibs;     // LC_LOAD_DYLIB commands (at least 1), the knob for the load command count, each gets one bind
+    uint32_t symbols;    // functions in __text, each in the symbol table, the export trie and LC_FUNCTION_STARTS
+    uint32_t classes;    // objc classes, each with a metaclass
+    uint32_t methods;    // instance methods per class, its metaclass gets as many class methods
+    uint32_t code_pages; // 4K pages of __text at least, __text grows if the functions don't fit
+    bool relative_methods; // relative method lists naming their selectors through __objc_selrefs, like current arm64
+} macho_gen_options;
+
+#define MACHO_GEN_DEFAULT_OPTIONS { .cputype = CPU_TYPE_ARM64, .dylibs = 16, .symbols = 4096, .classes = 256, .methods = 16, .code_pages = 1024 }
+
+#define MACHO_GEN_SYMBOL_FORMAT "_gen_func%07u"
+#define MACHO_GEN_IMPORT_FORMAT "_gen_import%06u"
+#define MACHO_GEN_CLASS_FORMAT  "GenClass%06u"
+#define MACHO_GEN_METHOD_FORMAT "method%06u"
+
+// what an image generated with some options holds, for checking a parse found all of it
+typedef struct{
+    uint32_t load_commands;
+    uint32_t symbols;       // defined and imported
+    uint32_t methods;       // instance and class methods of every class
+    uint32_t rebases;
+    uint32_t code_pages;    // hashed by the code signature, the pages of everything before it
+    size_t size;
+} macho_gen_counts;
+
+// a thin image, malloc'd, NULL if out of memory
+uint8_t* macho_gen_image(const macho_gen_options *options, size_t *size, macho_gen_counts *counts);
+
+// a fat file with one slice per options, slices aligned to 16K, counts are summed over the slices
+uint8_t* macho_gen_fat(const macho_gen_options *slices, uint32_t count, size_t *size, macho_gen_counts *counts);
+
+// parses "arm64" or "x86_64", false for anything else
+bool macho_gen_parse_cpu(const char *name, cpu_type_t *cputype);
+
+bool macho_gen_write(const char *path, const uint8_t *data, size_t size);
+
+#endif
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "macho_gen.h"
+
+/*
+ * writes a synthetic mach-o, see macho_gen.h
+ * usage: macho_gen [--arch=arm64,x86_64] [--dylibs=N] [--symbols=N] [--classes=N] [--methods=N] [--relative] [--pages=N] <output>
+ * more than one architecture makes a fat file with a slice for each
+ */
+
+#define MAX_SLICES 8
+
+static void usage(const char *name){
+    printf("Usage: %s [options] <output>\n", name);
+    printf("\t--arch=ARCHS\t\tarm64 and/or x86_64, more than one makes a fat file (default arm64)\n");
+    printf("\t--dylibs=N\t\tLC_LOAD_DYLIB commands, one bind each\n");
+    printf("\t--symbols=N\t\tfunctions, each in the symbol table, export trie and function starts\n");
+    printf("\t--classes=N\t\tobjc classes\n");
+    printf("\t--methods=N\t\tmethods per class and as many class methods\n");
+    printf("\t--relative\t\trelative method lists, as current arm64 linkers write them\n");
+    printf("\t--pages=N\t\t4K pages of code at least, all of them signed\n");
+}
+
+int main(int argc, const char *argv[]){
+    macho_gen_options options = MACHO_GEN_DEFAULT_OPTIONS;
+    cpu_type_t archs[MAX_SLICES] = {CPU_TYPE_ARM64};
+    uint32_t num_archs = 1;
+    int arg = 1;
+
+    for(; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++){
+        const char *option = argv[arg];
+
+        if(strncmp(option, "--arch=", 7) == 0){
+            char list[256];
+
+            snprintf(list, sizeof(list), "%s", option + 7);
+            num_archs = 0;
+
+            for(char *save = NULL, *name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save)){
+                if(num_archs == MAX_SLICES || !macho_gen_parse_cpu(name, &archs[num_archs])){
+                    printf("Unknown architecture %s\n", name);
+                    return 1;
+                }
+
+                num_archs++;
+            }
+        } else if(strncmp(option, "--dylibs=", 9) == 0){
+            options.dylibs = (uint32_t)strtoul(option + 9, NULL, 10);
+        } else if(strncmp(option, "--symbols=", 10) == 0){
+            options.symbols = (uint32_t)strtoul(option + 10, NULL, 10);
+        } else if(strncmp(option, "--classes=", 10) == 0){
+            options.classes = (uint32_t)strtoul(option + 10, NULL, 10);
+        } else if(strncmp(option, "--methods=", 10) == 0){
+            options.methods = (uint32_t)strtoul(option + 10, NULL, 10);
+        } else if(strcmp(option, "--relative") == 0){
+            options.relative_methods = true;
+        } else if(strncmp(option, "--pages=", 8) == 0){
+            options.code_pages = (uint32_t)strtoul(option + 8, NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(arg >= argc || num_archs == 0){
+        usage(argv[0]);
+        return 1;
+    }
+
+    macho_gen_options slices[MAX_SLICES];
+    macho_gen_counts counts;
+    size_t size = 0;
+    uint8_t *image;
+
+    for(uint32_t i = 0; i < num_archs; i++){
+        slices[i] = options;
+        slices[i].cputype = archs[i];
+    }
+
+    if(num_archs == 1)
+        image = macho_gen_image(&slices[0], &size, &counts);
+    else
+        image = macho_gen_fat(slices, num_archs, &size, &counts);
+
+    if(!image){
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    if(!macho_gen_write(argv[arg], image, size)){
+        printf("Could not write %s\n", argv[arg]);
+        free(image);
+        return 1;
+    }
+
+    printf("%s: %zu bytes, %u slices, %u load commands, %u symbols, %u methods, %u rebases, %u signed pages\n",
+           argv[arg], size, num_archs, counts.load_commands, counts.symbols, counts.methods, counts.rebases, counts.code_pages);
+
+    free(image);
+
+    return 0;
+}
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <capstone/capstone.h>
+#include "mach-o.h"
+#include "macho_gen.h"
+
+/*
+ * end to end parse throughput per stage on a synthetic image from macho_gen
+ * a stage is a set of --only parts parsed through macho_parse_visit with a visitor that only counts, so nothing
+ * gets printed and each number is what asking for that part costs: opening and mapping the file and walking
+ * the load commands included. disassembly is the exception, it needs symbols to look for and goes through
+ * macho_parse with every function asked for and the text written to /dev/null
+ * the first run of every stage is checked against what was generated so a broken parser can't post a great number
+ * usage: parse_bench [--iterations=N] [--fat] [--dylibs=N] [--symbols=N] [--classes=N] [--methods=N] [--relative] [--pages=N] [--keep=PATH]
+ */
+
+typedef struct{
+    uint64_t load_commands;
+    uint64_t symbols;
+    uint64_t methods;
+    uint64_t functions;
+    uint64_t fixups;
+    uint64_t exports;
+    uint64_t events;
+} bench_counts;
+
+typedef enum{
+    ITEM_LOAD_COMMANDS,
+    ITEM_SYMBOLS,
+    ITEM_METHODS,
+    ITEM_PAGES,
+    ITEM_FUNCTIONS,
+    ITEM_FIXUPS,
+    ITEM_EXPORTS,
+    ITEM_EVENTS
+} bench_item;
+
+typedef struct{
+    const char *name;
+    uint32_t parts;
+    bench_item item;
+    const char *unit;
+} bench_stage;
+
+static const bench_stage stages[] = {
+    {"load commands", MACHO_PART_SEGMENTS | MACHO_PART_DYLIBS | MACHO_PART_MAIN | MACHO_PART_DYSYMTAB, ITEM_LOAD_COMMANDS, "commands"},
+    {"symtab", MACHO_PART_SYMTAB, ITEM_SYMBOLS, "symbols"},
+    {"objc", MACHO_PART_OBJC, ITEM_METHODS, "methods"},
+    {"signature", MACHO_PART_SIGNATURE, ITEM_PAGES, "pages"},
+    {"functions", MACHO_PART_FUNCTIONS, ITEM_FUNCTIONS, "functions"},
+    {"fixups", MACHO_PART_BINDINGS, ITEM_FIXUPS, "fixups"},
+    {"exports", MACHO_PART_EXPORTS, ITEM_EXPORTS, "exports"},
+    {"everything", MACHO_PART_ALL, ITEM_EVENTS, "events"}
+};
+
+#define NUM_STAGES (sizeof(stages) / sizeof(stages[0]))
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void count_load_command(void *ctx, const macho_load_command_event *command){
+    ((bench_counts*)ctx)->load_commands++;
+    ((bench_counts*)ctx)->events++;
+}
+
+static void count_symbol(void *ctx, const macho_symbol_event *symbol){
+    ((bench_counts*)ctx)->symbols++;
+    ((bench_counts*)ctx)->events++;
+}
+
+static void count_objc_method(void *ctx, const macho_objc_method_event *method){
+    ((bench_counts*)ctx)->methods++;
+    ((bench_counts*)ctx)->events++;
+}
+
+static void count_function(void *ctx, const macho_function_event *function){
+    ((bench_counts*)ctx)->functions++;
+    ((bench_counts*)ctx)->events++;
+}
+
+static void count_fixup(void *ctx, const macho_fixup_event *fixup){
+    ((bench_counts*)ctx)->fixups++;
+    ((bench_counts*)ctx)->events++;
+}
+
+static void count_export(void *ctx, const macho_export_symbol_event *symbol){
+    ((bench_counts*)ctx)->exports++;
+    ((bench_counts*)ctx)->events++;
+}
+
+// a parse walks a part whether or not anything listens, so the callbacks for everything else just count events
+static void count_segment(void *ctx, const macho_segment_event *segment){ ((bench_counts*)ctx)->events++; }
+static void count_section(void *ctx, const macho_section_event *section){ ((bench_counts*)ctx)->events++; }
+static void count_dylib(void *ctx, const macho_dylib_event *dylib){ ((bench_counts*)ctx)->events++; }
+static void count_objc_class(void *ctx, const macho_objc_class_event *objc_class){ ((bench_counts*)ctx)->events++; }
+static void count_signature_blob(void *ctx, const macho_signature_blob_event *blob){ ((bench_counts*)ctx)->events++; }
+
+// runs one stage iterations times, false if the file couldn't be parsed
+static bool run_stage(const char *path, const bench_stage *stage, uint32_t iterations, bench_counts *counts, double *seconds){
+    macho_options options = MACHO_DEFAULT_OPTIONS;
+    bench_counts scratch;
+    macho_visitor visitor = {
+        .load_command = count_load_command,
+        .segment = count_segment,
+        .section = count_section,
+        .dylib = count_dylib,
+        .symbol = count_symbol,
+        .objc_class = count_objc_class,
+        .objc_method = count_objc_method,
+        .function = count_function,
+        .fixup = count_fixup,
+        .export_symbol = count_export,
+        .signature_blob = count_signature_blob
+    };
+
+    options.parts = stage->parts;
+    options.verify_threads = 1;
+    memset(counts, 0, sizeof(bench_counts));
+
+    double start = now();
+
+    for(uint32_t i = 0; i < iterations; i++){
+        FILE *file = fopen(path, "rb");
+
+        // only the first run is counted, the rest would count the same
+        memset(&scratch, 0, sizeof(scratch));
+        visitor.ctx = i == 0 ? (void*)counts : (void*)&scratch;
+
+        bool parsed = file && macho_parse_visit(file, path, &options, &visitor);
+
+        if(file)
+            fclose(file);
+
+        if(!parsed)
+            return false;
+    }
+
+    *seconds = (now() - start) / iterations;
+
+    return true;
+}
+
+// symtab lookups of every function and their disassembly, printed to /dev/null, false without a disassembler
+static bool run_disassembly(const char *path, uint32_t symbols, uint32_t iterations, double *seconds){
+    csh handle;
+
+    if(cs_open(CS_ARCH_ARM64, CS_MODE_ARM, &handle) != CS_ERR_OK)
+        return false;
+
+    cs_close(&handle);
+
+    char **names = calloc(symbols, sizeof(char*));
+    symbol_table *table = NULL;
+    FILE *out = fopen("/dev/null", "w");
+    bool ran = false;
+
+    for(uint32_t i = 0; names && i < symbols; i++){
+        char name[64];
+
+        snprintf(name, sizeof(name), MACHO_GEN_SYMBOL_FORMAT, i);
+        names[i] = strdup(name);
+    }
+
+    if(names)
+        table = macho_symbol_table_create((const char *const*)names, symbols);
+
+    if(table && out){
+        macho_options options = MACHO_DEFAULT_OPTIONS;
+
+        options.parts = MACHO_PART_SYMTAB;
+        options.slice_threads = 1;
+
+        double start = now();
+
+        for(uint32_t i = 0; i < iterations; i++){
+            FILE *file = fopen(path, "rb");
+
+            if(!file)
+                break;
+
+            macho_parse(file, (char*)path, table, &options, out);
+            fclose(file);
+        }
+
+        *seconds = (now() - start) / iterations;
+        ran = true;
+    }
+
+    for(uint32_t i = 0; names && i < symbols; i++)
+        free(names[i]);
+
+    free(names);
+    macho_symbol_table_free(table);
+
+    if(out)
+        fclose(out);
+
+    return ran;
+}
+
+static uint64_t stage_items(const bench_stage *stage, const bench_counts *counts, const macho_gen_counts *generated){
+    switch(stage->item){
+        case ITEM_LOAD_COMMANDS: return counts->load_commands;
+        case ITEM_SYMBOLS: return counts->symbols;
+        case ITEM_METHODS: return counts->methods;
+        case ITEM_PAGES: return generated->code_pages;
+        case ITEM_FUNCTIONS: return counts->functions;
+        case ITEM_FIXUPS: return counts->fixups;
+        case ITEM_EXPORTS: return counts->exports;
+        case ITEM_EVENTS: return counts->events;
+    }
+
+    return 0;
+}
+
+// what the stage should have found in the generated file, 0 when there's nothing to check against
+static uint64_t stage_expected(const bench_stage *stage, const macho_gen_counts *generated, uint32_t functions, uint32_t binds){
+    switch(stage->item){
+        case ITEM_LOAD_COMMANDS: return generated->load_commands;
+        case ITEM_SYMBOLS: return generated->symbols;
+        case ITEM_METHODS: return generated->methods;
+        case ITEM_FUNCTIONS: return functions;
+        case ITEM_FIXUPS: return generated->rebases + binds;
+        case ITEM_EXPORTS: return functions;
+        default: return 0;
+    }
+}
+
+int main(int argc, const char *argv[]){
+    macho_gen_options options = MACHO_GEN_DEFAULT_OPTIONS;
+    uint32_t iterations = 20;
+    bool fat = false;
+    const char *keep = NULL;
+
+    for(int arg = 1; arg < argc; arg++){
+        const char *option = argv[arg];
+
+        if(strncmp(option, "--iterations=", 13) == 0)
+            iterations = (uint32_t)strtoul(option + 13, NULL, 10);
+        else if(strcmp(option, "--fat") == 0)
+            fat = true;
+        else if(strncmp(option, "--dylibs=", 9) == 0)
+            options.dylibs = (uint32_t)strtoul(option + 9, NULL, 10);
+        else if(strncmp(option, "--symbols=", 10) == 0)
+            options.symbols = (uint32_t)strtoul(option + 10, NULL, 10);
+        else if(strncmp(option, "--classes=", 10) == 0)
+            options.classes = (uint32_t)strtoul(option + 10, NULL, 10);
+        else if(strncmp(option, "--methods=", 10) == 0)
+            options.methods = (uint32_t)strtoul(option + 10, NULL, 10);
+        else if(strcmp(option, "--relative") == 0)
+            options.relative_methods = true;
+        else if(strncmp(option, "--pages=", 8) == 0)
+            options.code_pages = (uint32_t)strtoul(option + 8, NULL, 10);
+        else if(strncmp(option, "--keep=", 7) == 0)
+            keep = option + 7;
+        else {
+            printf("Usage: %s [--iterations=N] [--fat] [--dylibs=N] [--symbols=N] [--classes=N] [--methods=N] [--relative] [--pages=N] [--keep=PATH]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if(!iterations)
+        iterations = 1;
+
+    // the generator gives every image at least one dylib and one function
+    if(!options.dylibs)
+        options.dylibs = 1;
+
+    if(!options.symbols)
+        options.symbols = 1;
+
+    macho_gen_options slices[2] = {options, options};
+    uint32_t num_slices = fat ? 2 : 1;
+    macho_gen_counts generated;
+    size_t size = 0;
+    uint8_t *image;
+
+    slices[1].cputype = CPU_TYPE_X86_64;
+
+    if(fat)
+        image = macho_gen_fat(slices, num_slices, &size, &generated);
+    else
+        image = macho_gen_image(&slices[0], &size, &generated);
+
+    if(!image){
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    char temporary[] = "/tmp/parse_bench.XXXXXX";
+    const char *path = keep;
+
+    if(!path){
+        int fd = mkstemp(temporary);
+
+        if(fd < 0){
+            printf("Could not create a temporary file\n");
+            free(image);
+            return 1;
+        }
+
+        close(fd);
+        path = temporary;
+    }
+
+    bool written = macho_gen_write(path, image, size);
+
+    free(image);
+
+    if(!written){
+        printf("Could not write %s\n", path);
+        return 1;
+    }
+
+    printf("%s image of %.1f MiB: %u load commands, %u symbols, %u methods, %u rebases, %u signed pages, %u iterations\n",
+           fat ? "fat" : "thin", size / 1048576.0, generated.load_commands, generated.symbols, generated.methods,
+           generated.rebases, generated.code_pages, iterations);
+
+    int failures = 0;
+
+    for(size_t i = 0; i < NUM_STAGES; i++){
+        const bench_stage *stage = &stages[i];
+        bench_counts counts;
+        double seconds;
+
+        if(!run_stage(path, stage, iterations, &counts, &seconds)){
+            printf("%-14s could not be parsed\n", stage->name);
+            failures++;
+            continue;
+        }
+
+        uint64_t items = stage_items(stage, &counts, &generated);
+        uint64_t expected = stage_expected(stage, &generated, options.symbols * num_slices, options.dylibs * num_slices);
+        bool match = !expected || items == expected;
+
+        printf("%-14s %9.3f ms %9.1f MiB/s %12.0f %s/s%s\n",
+               stage->name,
+               seconds * 1e3,
+               size / 1048576.0 / seconds,
+               items / seconds,
+               stage->unit,
+               match ? "" : "  MISMATCH");
+
+        if(!match)
+            failures++;
+    }
+
+    double seconds = 0;
+
+    if(run_disassembly(path, options.symbols, iterations, &seconds))
+        printf("%-14s %9.3f ms %9.1f MiB/s %12.0f functions/s\n",
+               "disassembly", seconds * 1e3, size / 1048576.0 / seconds, options.symbols * num_slices / seconds);
+    else
+        printf("%-14s skipped, built without capstone\n", "disassembly");
+
+    if(!keep)
+        unlink(path);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sha.h"
+
+/*
+ * compares the single stream and multi-buffer code page hashing paths
+ * usage: sha_bench [pages] [page size]
+ */
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void hex(const uint8_t *digest, size_t size, char *out){
+    for(size_t i = 0; i < size; i++)
+        sprintf(out + 2 * i, "%02x", digest[i]);
+}
+
+// known answers for "abc" so a broken engine can't report a great number
+static int self_test(void){
+    const char *abc = "abc";
+    const char *sha1_abc = "a9993e364706816aba3e25717850c26c9cd0d89d";
+    const char *sha256_abc = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+    int failures = 0;
+
+    for(int engine = MACHO_SHA_ENGINE_SCALAR; engine <= MACHO_SHA_ENGINE_SHANI; engine++){
+        if(!macho_sha_engine_supported(engine))
+            continue;
+
+        const uint8_t *data[1] = {(const uint8_t*)abc};
+        uint8_t digest[MACHO_SHA256_DIGEST_LENGTH];
+        uint8_t *out[1] = {digest};
+        char text[2 * MACHO_SHA256_DIGEST_LENGTH + 1];
+
+        macho_sha1_multi_with(engine, data, 3, out, 1);
+        hex(digest, MACHO_SHA1_DIGEST_LENGTH, text);
+
+        if(strcmp(text, sha1_abc) != 0){
+            printf("%s: SHA-1 self test failed (%s)\n", macho_sha_engine_name(engine), text);
+            failures++;
+        }
+
+        macho_sha256_multi_with(engine, data, 3, out, 1);
+        hex(digest, MACHO_SHA256_DIGEST_LENGTH, text);
+
+        if(strcmp(text, sha256_abc) != 0){
+            printf("%s: SHA-256 self test failed (%s)\n", macho_sha_engine_name(engine), text);
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+int main(int argc, const char *argv[]){
+    uint32_t pages = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 16384;
+    size_t page_size = argc > 2 ? strtoul(argv[2], NULL, 10) : 4096;
+
+    if(self_test())
+        return 1;
+
+    uint8_t *image = malloc(pages * page_size);
+    const uint8_t **data = malloc(pages * sizeof(uint8_t*));
+    uint8_t **digests = malloc(pages * sizeof(uint8_t*));
+    uint8_t *reference = malloc(pages * MACHO_SHA256_DIGEST_LENGTH);
+    uint8_t *results = malloc(pages * MACHO_SHA256_DIGEST_LENGTH);
+
+    if(!image || !data || !digests || !reference || !results){
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    srand(1);
+
+    for(size_t i = 0; i < pages * page_size; i++)
+        image[i] = (uint8_t)rand();
+
+    for(uint32_t i = 0; i < pages; i++)
+        data[i] = image + i * page_size;
+
+    printf("%u pages of %zu bytes (%.1f MiB), multi-buffer default: %s\n",
+           pages, page_size, pages * page_size / 1048576.0, macho_sha_engine_name(macho_sha_multi_engine()));
+
+    int failures = 0;
+
+    for(int sha256 = 0; sha256 <= 1; sha256++){
+        size_t digest_size = sha256 ? MACHO_SHA256_DIGEST_LENGTH : MACHO_SHA1_DIGEST_LENGTH;
+
+        for(int engine = MACHO_SHA_ENGINE_SCALAR; engine <= MACHO_SHA_ENGINE_SHANI; engine++){
+            if(!macho_sha_engine_supported(engine))
+                continue;
+
+            uint8_t *out = engine == MACHO_SHA_ENGINE_SCALAR ? reference : results;
+
+            for(uint32_t i = 0; i < pages; i++)
+                digests[i] = out + i * digest_size;
+
+            double start = now();
+
+            if(sha256)
+                macho_sha256_multi_with(engine, data, page_size, digests, pages);
+            else
+                macho_sha1_multi_with(engine, data, page_size, digests, pages);
+
+            double seconds = now() - start;
+            bool match = engine == MACHO_SHA_ENGINE_SCALAR || memcmp(reference, results, pages * digest_size) == 0;
+
+            printf("%-8s %-8s %9.1f MiB/s %10.0f pages/s%s\n",
+                   sha256 ? "SHA-256" : "SHA-1",
+                   macho_sha_engine_name(engine),
+                   pages * page_size / 1048576.0 / seconds,
+                   pages / seconds,
+                   match ? "" : "  MISMATCH");
+
+            if(!match)
+                failures++;
+        }
+    }
+
+    free(image);
+    free(data);
+    free(digests);
+    free(reference);
+    free(results);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "arena.h"
+
+// standard blocks a thread keeps around for its next image, enough for a large one without pinning much memory
+#define MACHO_ARENA_CACHED_BLOCKS 16
+
+// the header is a multiple of the alignment so the data right after it is aligned like malloc's
+struct macho_arena_block{
+    macho_arena_block *next;
+    size_t size; // bytes of data, more than MACHO_ARENA_BLOCK_CAPACITY for a dedicated block
+    size_t used;
+    size_t pad;
+};
+
+#define MACHO_ARENA_BLOCK_CAPACITY (MACHO_ARENA_BLOCK_SIZE - sizeof(macho_arena_block))
+
+typedef struct{
+    macho_arena_block *blocks;
+    uint32_t count;
+} macho_arena_cache;
+
+static pthread_key_t arena_cache_key;
+static pthread_once_t arena_cache_once = PTHREAD_ONCE_INIT;
+static bool arena_cache_ready;
+
+// blocks cached by a thread are freed when it exits
+static void macho_arena_cache_free(void *ctx){
+    macho_arena_cache *cache = ctx;
+    
+    while(cache->blocks){
+        macho_arena_block *next = cache->blocks->next;
+        free(cache->blocks);
+        cache->blocks = next;
+    }
+    
+    free(cache);
+}
+
+static void macho_arena_cache_init(void){
+    arena_cache_ready = pthread_key_create(&arena_cache_key, macho_arena_cache_free) == 0;
+}
+
+// the calling thread's cache, NULL if it can't have one
+static macho_arena_cache* macho_arena_get_cache(bool create){
+    pthread_once(&arena_cache_once, macho_arena_cache_init);
+    
+    if(!arena_cache_ready)
+        return NULL;
+    
+    macho_arena_cache *cache = pthread_getspecific(arena_cache_key);
+    
+    if(!cache && create){
+        cache = calloc(1, sizeof(macho_arena_cache));
+        
+        if(cache && pthread_setspecific(arena_cache_key, cache) != 0){
+            free(cache);
+            cache = NULL;
+        }
+    }
+    
+    return cache;
+}
+
+static inline uint8_t* macho_arena_data(macho_arena_block *block){
+    return (uint8_t*)(block + 1);
+}
+
+static inline size_t macho_arena_align(size_t size){
+    return (size + MACHO_ARENA_ALIGNMENT - 1) & ~(size_t)(MACHO_ARENA_ALIGNMENT - 1);
+}
+
+static macho_arena_block* macho_arena_new_block(size_t size){
+    macho_arena_block *block = NULL;
+    
+    if(size <= MACHO_ARENA_BLOCK_CAPACITY){
+        macho_arena_cache *cache = macho_arena_get_cache(false);
+        size = MACHO_ARENA_BLOCK_CAPACITY;
+        
+        if(cache && cache->blocks){
+            block = cache->blocks;
+            cache->blocks = block->next;
+            cache->count--;
+        } else {
+            block = malloc(MACHO_ARENA_BLOCK_SIZE);
+        }
+    } else {
+        block = malloc(sizeof(macho_arena_block) + size);
+    }
+    
+    if(!block)
+        return NULL;
+    
+    block->size = size;
+    block->used = 0;
+    
+    return block;
+}
+
+void* macho_arena_alloc(macho_arena *arena, size_t size){
+    // every allocation takes some room so the last one is always told apart from the next
+    if(size > SIZE_MAX - sizeof(macho_arena_block) - MACHO_ARENA_ALIGNMENT)
+        return NULL;
+    
+    size = size ? macho_arena_align(size) : MACHO_ARENA_ALIGNMENT;
+    
+    macho_arena_block *block = arena->blocks;
+    
+    // a block that's too full to take this is left as it is, only the newest one is bumped
+    if(!block || block->size - block->used < size){
+        block = macho_arena_new_block(size);
+        
+        if(!block)
+            return NULL;
+        
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    
+    void *ptr = macho_arena_data(block) + block->used;
+    
+    block->used += size;
+    arena->allocated += size;
+    arena->last = ptr;
+    
+    return ptr;
+}
+
+void* macho_arena_calloc(macho_arena *arena, size_t count, size_t size){
+    if(size && count > SIZE_MAX / size)
+        return NULL;
+    
+    void *ptr = macho_arena_alloc(arena, count * size);
+    
+    if(ptr)
+        memset(ptr, 0, count * size);
+    
+    return ptr;
+}
+
+void* macho_arena_realloc(macho_arena *arena, void *ptr, size_t old_size, size_t size){
+    if(!ptr)
+        return macho_arena_alloc(arena, size);
+    
+    if(size <= old_size)
+        return ptr;
+    
+    if(size > SIZE_MAX - sizeof(macho_arena_block) - MACHO_ARENA_ALIGNMENT)
+        return NULL;
+    
+    macho_arena_block *block = arena->blocks;
+    
+    // the last allocation is at the end of the newest block, growing it is just bumping further
+    if(ptr == arena->last && block){
+        size_t offset = (uint8_t*)ptr - macho_arena_data(block);
+        size_t aligned = macho_arena_align(size);
+        
+        if(block->size - offset >= aligned){
+            arena->allocated += offset + aligned - block->used;
+            block->used = offset + aligned;
+            return ptr;
+        }
+        
+        // a dedicated block holds nothing else, so it can move as a whole
+        if(block->size > MACHO_ARENA_BLOCK_CAPACITY){
+            macho_arena_block *grown = realloc(block, sizeof(macho_arena_block) + aligned);
+            
+            if(!grown)
+                return NULL;
+            
+            arena->allocated += aligned - grown->used;
+            grown->size = grown->used = aligned;
+            arena->blocks = grown;
+            arena->last = macho_arena_data(grown);
+            
+            return arena->last;
+        }
+    }
+    
+    void *grown = macho_arena_alloc(arena, size);
+    
+    if(grown)
+        memcpy(grown, ptr, old_size);
+    
+    return grown;
+}
+
+char* macho_arena_strdup(macho_arena *arena, const char *string){
+    size_t length = strlen(string) + 1;
+    char *copy = macho_arena_alloc(arena, length);
+    
+    if(copy)
+        memcpy(copy, string, length);
+    
+    return copy;
+}
+
+void macho_arena_reset(macho_arena *arena){
+    macho_arena_cache *cache = arena->blocks ? macho_arena_get_cache(true) : NULL;
+    
+    while(arena->blocks){
+        macho_arena_block *block = arena->blocks;
+        arena->blocks = block->next;
+        
+        if(cache && block->size == MACHO_ARENA_BLOCK_CAPACITY && cache->count < MACHO_ARENA_CACHED_BLOCKS){
+            block->next = cache->blocks;
+            cache->blocks = block;
+            cache->count++;
+        } else {
+            free(block);
+        }
+    }
+    
+    arena->last = NULL;
+    arena->allocated = 0;
+}
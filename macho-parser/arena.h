@@ -0,0 +1,45 @@
+#ifndef __arena_h
+#define __arena_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * bump allocator for everything parsed out of one image: load command indexes, segments, symbol indexes,
+ * fixups, function starts and the code signature scratch all come out of it and go away together
+ * when the image is released, so nothing parse time has to be freed piece by piece
+ * allocations are carved out of 64K blocks, anything bigger gets a block of its own
+ * reset hands the standard blocks to a small cache per thread, the next image parsed on that thread
+ * takes them back without going through malloc, which keeps a long scan flat and its workers off the malloc locks
+ * an arena belongs to one image and is used by one thread at a time, like the rest of macho_file
+ */
+
+#define MACHO_ARENA_BLOCK_SIZE (64 * 1024)
+#define MACHO_ARENA_ALIGNMENT 16
+
+typedef struct macho_arena_block macho_arena_block;
+
+// a zeroed arena is a valid empty one
+typedef struct{
+    macho_arena_block *blocks; // newest first, allocations are bumped out of the first one
+    void *last;                // the most recent allocation, the only one that can grow in place
+    size_t allocated;          // bytes handed out since the last reset
+} macho_arena;
+
+// size bytes aligned to MACHO_ARENA_ALIGNMENT, NULL if out of memory
+void* macho_arena_alloc(macho_arena *arena, size_t size);
+
+// count * size zeroed bytes, NULL if out of memory or the size overflows
+void* macho_arena_calloc(macho_arena *arena, size_t count, size_t size);
+
+// grows ptr (old_size bytes, NULL for a new allocation) to size, in place when it's the last allocation
+// the old bytes are left where they were otherwise, NULL if out of memory with ptr untouched
+void* macho_arena_realloc(macho_arena *arena, void *ptr, size_t old_size, size_t size);
+
+char* macho_arena_strdup(macho_arena *arena, const char *string);
+
+// frees everything allocated from the arena at once, the arena can be used again right away
+void macho_arena_reset(macho_arena *arena);
+
+#endif
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "thread_pool.h"
+#include "batch_io.h"
+
+#if defined(__linux__) && !defined(MACHO_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define MACHO_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef MACHO_HAVE_IO_URING
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+// reads in flight at once, one submission queue worth
+#define MACHO_BATCH_RING_ENTRIES 64
+
+typedef struct{
+    macho_batch_request *requests;
+    int *fds;
+} batch_job;
+
+static void macho_batch_open(void *ctx, uint32_t index){
+    batch_job *job = ctx;
+    
+    job->fds[index] = open(job->requests[index].path, O_RDONLY | O_CLOEXEC);
+    
+    if(job->fds[index] < 0)
+        job->requests[index].result = -errno;
+}
+
+static void macho_batch_pread(void *ctx, uint32_t index){
+    batch_job *job = ctx;
+    macho_batch_request *request = &job->requests[index];
+    int fd = open(request->path, O_RDONLY | O_CLOEXEC);
+    
+    if(fd < 0){
+        request->result = -errno;
+        return;
+    }
+    
+    ssize_t length = pread(fd, request->buffer, request->size, (off_t)request->offset);
+    
+    request->result = length < 0 ? -errno : length;
+    close(fd);
+}
+
+#ifdef MACHO_HAVE_IO_URING
+
+// the parts of the three shared mappings of a ring that are used, set up the way the kernel describes them in the params
+typedef struct{
+    int fd;
+    uint32_t entries;
+    _Atomic uint32_t *sq_head;
+    _Atomic uint32_t *sq_tail;
+    uint32_t sq_mask;
+    uint32_t *sq_array;
+    struct io_uring_sqe *sqes;
+    _Atomic uint32_t *cq_head;
+    _Atomic uint32_t *cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+} batch_ring;
+
+static void macho_batch_ring_close(batch_ring *ring){
+    if(ring->sqes)
+        munmap(ring->sqes, ring->entries * sizeof(struct io_uring_sqe));
+    
+    if(ring->cq_map && ring->cq_map != ring->sq_map)
+        munmap(ring->cq_map, ring->cq_map_size);
+    
+    if(ring->sq_map)
+        munmap(ring->sq_map, ring->sq_map_size);
+    
+    close(ring->fd);
+}
+
+static bool macho_batch_ring_open(batch_ring *ring, uint32_t entries){
+    struct io_uring_params params;
+    
+    memset(ring, 0, sizeof(batch_ring));
+    memset(&params, 0, sizeof(params));
+    
+    // seccomp filters and io_uring_disabled make this fail with ENOSYS or EPERM, the pool takes over then
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    
+    if(ring->fd < 0)
+        return false;
+    
+    ring->entries = params.sq_entries;
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    
+    // newer kernels put both rings in one mapping
+    if(params.features & IORING_FEAT_SINGLE_MMAP){
+        if(ring->cq_map_size > ring->sq_map_size)
+            ring->sq_map_size = ring->cq_map_size;
+        
+        ring->cq_map_size = ring->sq_map_size;
+    }
+    
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    
+    if(ring->sq_map == MAP_FAILED){
+        ring->sq_map = NULL;
+        macho_batch_ring_close(ring);
+        return false;
+    }
+    
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->cq_map = ring->sq_map;
+    else
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    
+    if(ring->cq_map == MAP_FAILED){
+        ring->cq_map = NULL;
+        macho_batch_ring_close(ring);
+        return false;
+    }
+    
+    ring->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    
+    if(ring->sqes == MAP_FAILED){
+        ring->sqes = NULL;
+        macho_batch_ring_close(ring);
+        return false;
+    }
+    
+    uint8_t *sq = ring->sq_map;
+    uint8_t *cq = ring->cq_map;
+    
+    ring->sq_head = (_Atomic uint32_t*)(sq + params.sq_off.head);
+    ring->sq_tail = (_Atomic uint32_t*)(sq + params.sq_off.tail);
+    ring->sq_mask = *(uint32_t*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (uint32_t*)(sq + params.sq_off.array);
+    ring->cq_head = (_Atomic uint32_t*)(cq + params.cq_off.head);
+    ring->cq_tail = (_Atomic uint32_t*)(cq + params.cq_off.tail);
+    ring->cq_mask = *(uint32_t*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    
+    return true;
+}
+
+// submits the reads of requests [begin, end) and waits for all of them, false if the ring itself failed
+static bool macho_batch_ring_submit(batch_ring *ring, batch_job *job, uint32_t begin, uint32_t end){
+    uint32_t tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    uint32_t submitted = 0;
+    
+    for(uint32_t i = begin; i < end; i++){
+        macho_batch_request *request = &job->requests[i];
+        
+        if(job->fds[i] < 0)
+            continue;
+        
+        uint32_t slot = tail & ring->sq_mask;
+        struct io_uring_sqe *sqe = &ring->sqes[slot];
+        
+        memset(sqe, 0, sizeof(struct io_uring_sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = job->fds[i];
+        sqe->addr = (uint64_t)(uintptr_t)request->buffer;
+        sqe->len = request->size;
+        sqe->off = request->offset;
+        sqe->user_data = i;
+        
+        ring->sq_array[slot] = slot;
+        tail++;
+        submitted++;
+    }
+    
+    atomic_store_explicit(ring->sq_tail, tail, memory_order_release);
+    
+    uint32_t completed = 0;
+    
+    while(completed < submitted){
+        // whatever the kernel hasn't consumed yet, all of it the first time and nothing after unless a call got interrupted
+        uint32_t to_submit = tail - atomic_load_explicit(ring->sq_head, memory_order_acquire);
+        
+        if(syscall(__NR_io_uring_enter, ring->fd, to_submit, submitted - completed, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+            return false;
+        
+        uint32_t head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+        uint32_t cq_tail = atomic_load_explicit(ring->cq_tail, memory_order_acquire);
+        
+        for(; head != cq_tail; head++, completed++){
+            struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+            
+            job->requests[cqe->user_data].result = cqe->res;
+        }
+        
+        atomic_store_explicit(ring->cq_head, head, memory_order_release);
+    }
+    
+    return true;
+}
+
+static bool macho_batch_read_ring(batch_job *job, uint32_t count, uint32_t threads){
+    batch_ring ring;
+    
+    if(!macho_batch_ring_open(&ring, MACHO_BATCH_RING_ENTRIES))
+        return false;
+    
+    job->fds = malloc((count ? count : 1) * sizeof(int));
+    
+    if(!job->fds){
+        macho_batch_ring_close(&ring);
+        return false;
+    }
+    
+    // an open can block on a directory lookup as long as a read does, the ring only does the reads
+    macho_parallel_for(threads, count, macho_batch_open, job);
+    
+    bool ok = true;
+    
+    for(uint32_t begin = 0; ok && begin < count; begin += ring.entries){
+        uint32_t end = count - begin < ring.entries ? count : begin + ring.entries;
+        ok = macho_batch_ring_submit(&ring, job, begin, end);
+    }
+    
+    for(uint32_t i = 0; i < count; i++){
+        // kernels older than IORING_OP_READ reject it, those requests are read again below like everything after a ring failure
+        if(job->fds[i] >= 0 && (!ok || job->requests[i].result == -EINVAL)){
+            ssize_t length = pread(job->fds[i], job->requests[i].buffer, job->requests[i].size, (off_t)job->requests[i].offset);
+            job->requests[i].result = length < 0 ? -errno : length;
+        }
+        
+        if(job->fds[i] >= 0)
+            close(job->fds[i]);
+    }
+    
+    free(job->fds);
+    job->fds = NULL;
+    macho_batch_ring_close(&ring);
+    
+    return true;
+}
+
+bool macho_batch_io_uring_available(void){
+    batch_ring ring;
+    
+    if(!macho_batch_ring_open(&ring, 1))
+        return false;
+    
+    macho_batch_ring_close(&ring);
+    
+    return true;
+}
+
+#else
+
+bool macho_batch_io_uring_available(void){
+    return false;
+}
+
+#endif
+
+void macho_batch_read(macho_batch_request *requests, uint32_t count, uint32_t threads){
+    batch_job job;
+    
+    job.requests = requests;
+    job.fds = NULL;
+    
+    for(uint32_t i = 0; i < count; i++)
+        requests[i].result = 0;
+
+#ifdef MACHO_HAVE_IO_URING
+    if(macho_batch_read_ring(&job, count, threads))
+        return;
+#endif
+    
+    macho_parallel_for_batch(threads, count, 1, macho_batch_pread, &job);
+}
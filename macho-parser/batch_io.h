@@ -0,0 +1,28 @@
+#ifndef __batch_io_h
+#define __batch_io_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * reads small pieces of many files at once, so scanning a tree waits on the disk (or the network) once per batch
+ * instead of once per file. on linux the reads go through an io_uring when the kernel has one to give,
+ * everywhere else, and when it doesn't, they're preads spread over a thread pool
+ * build with MACHO_NO_IO_URING to always use the pool
+ */
+
+typedef struct{
+    const char *path;
+    uint64_t offset;
+    uint32_t size;
+    uint8_t *buffer;  // size bytes, filled by macho_batch_read
+    int64_t result;   // bytes read, or -errno if the file couldn't be opened or read
+} macho_batch_request;
+
+// runs every request, threads is the size of the pool that opens the files (and reads them without io_uring), 0 uses every cpu
+void macho_batch_read(macho_batch_request *requests, uint32_t count, uint32_t threads);
+
+// whether macho_batch_read can use an io_uring here
+bool macho_batch_io_uring_available(void);
+
+#endif
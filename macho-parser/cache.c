@@ -0,0 +1,905 @@
+#include <mach-o/swap.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mach-o.h"
+#include "objc.h"
+#include "sha.h"
+#include "cache.h"
+
+#define MACHO_CACHE_MAX_SLICES 64
+
+#ifdef __APPLE__
+#define macho_mtime_nsec(st) ((st).st_mtimespec.tv_nsec)
+#else
+#define macho_mtime_nsec(st) ((st).st_mtim.tv_nsec)
+#endif
+
+// growable byte buffer the cache is assembled in before it hits the disk
+typedef struct{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    bool failed; // an append ran out of memory, the cache is incomplete
+} macho_cache_writer;
+
+// appends size bytes at the next 8 byte boundary and returns where they went
+static uint64_t macho_cache_append(macho_cache_writer *writer, const void *data, size_t size){
+    size_t offset = (writer->size + 7) & ~(size_t)7;
+    
+    if(offset + size > writer->capacity){
+        size_t capacity = writer->capacity ? writer->capacity : 0x10000;
+        
+        while(offset + size > capacity)
+            capacity *= 2;
+        
+        uint8_t *grown = realloc(writer->data, capacity);
+        
+        if(!grown){
+            writer->failed = true;
+            return 0;
+        }
+        
+        writer->data = grown;
+        writer->capacity = capacity;
+    }
+    
+    memset(writer->data + writer->size, 0, offset - writer->size);
+    
+    // no data reserves zeroed space that gets filled in later
+    if(data)
+        memcpy(writer->data + offset, data, size);
+    else
+        memset(writer->data + offset, 0, size);
+    
+    writer->size = offset + size;
+    
+    return offset;
+}
+
+// deduplicated string pool of one slice
+typedef struct{
+    char *data;
+    uint32_t size;
+    uint32_t capacity;
+    macho_hash_table offsets; // string -> offset + 1, keys point into the image
+} macho_cache_strings;
+
+static uint32_t macho_cache_intern(macho_cache_strings *strings, const char *string){
+    macho_hash_entry *entry = macho_hash_insert(&strings->offsets, string, NULL);
+    
+    if(entry && entry->value)
+        return (uint32_t)((uintptr_t)entry->value - 1);
+    
+    uint32_t length = (uint32_t)strlen(string) + 1;
+    
+    if(strings->size + length > strings->capacity){
+        uint32_t capacity = strings->capacity ? strings->capacity : 0x1000;
+        
+        while(strings->size + length > capacity)
+            capacity *= 2;
+        
+        char *grown = realloc(strings->data, capacity);
+        
+        if(!grown)
+            return 0;
+        
+        strings->data = grown;
+        strings->capacity = capacity;
+    }
+    
+    uint32_t offset = strings->size;
+    
+    memcpy(strings->data + offset, string, length);
+    strings->size += length;
+    
+    if(entry)
+        entry->value = (void*)((uintptr_t)offset + 1);
+    
+    return offset;
+}
+
+typedef struct{
+    const char *classname;
+    const char *methodname;
+    uint64_t imp;
+    bool metaclass;
+} macho_cache_objc_entry;
+
+typedef struct{
+    macho_cache_objc_entry *entries;
+    size_t count;
+    size_t capacity;
+} macho_cache_objc;
+
+static void macho_cache_visit_method(void *ctx, const char *classname, const char *methodname, uint64_t imp, bool metaclass){
+    macho_cache_objc *objc = ctx;
+    
+    if(objc->count == objc->capacity){
+        size_t capacity = objc->capacity ? objc->capacity * 2 : 256;
+        macho_cache_objc_entry *grown = realloc(objc->entries, capacity * sizeof(macho_cache_objc_entry));
+        
+        if(!grown)
+            return;
+        
+        objc->entries = grown;
+        objc->capacity = capacity;
+    }
+    
+    objc->entries[objc->count++] = (macho_cache_objc_entry){ classname, methodname, imp, metaclass };
+}
+
+static int macho_cache_objc_compare(const void *a, const void *b){
+    const macho_cache_objc_entry *lhs = a;
+    const macho_cache_objc_entry *rhs = b;
+    
+    int order = strcmp(lhs->classname, rhs->classname);
+    
+    if(order)
+        return order;
+    
+    // the NULL entry that announces the class sorts first
+    if(!lhs->methodname || !rhs->methodname)
+        return (lhs->methodname != NULL) - (rhs->methodname != NULL);
+    
+    return strcmp(lhs->methodname, rhs->methodname);
+}
+
+typedef struct{
+    const char *name;
+    uint32_t index;
+} macho_cache_named;
+
+static int macho_cache_named_compare(const void *a, const void *b){
+    return strcmp(((const macho_cache_named*)a)->name, ((const macho_cache_named*)b)->name);
+}
+
+// the load commands of the slice at headeroff, NULL when it isn't a native endian image
+static uint8_t* macho_cache_load_commands(macho_file *macho, uint64_t headeroff, struct mach_header *header, uint64_t *end){
+    if(headeroff + sizeof(struct mach_header_64) > macho->size)
+        return NULL;
+    
+    macho_read(macho, headeroff, header, sizeof(struct mach_header));
+    
+    if(header->magic != MH_MAGIC && header->magic != MH_MAGIC_64)
+        return NULL;
+    
+    uint64_t offset = headeroff + (header->magic == MH_MAGIC_64 ? sizeof(struct mach_header_64) : sizeof(struct mach_header));
+    
+    *end = offset + header->sizeofcmds;
+    
+    return macho_get_range(macho, offset, header->sizeofcmds);
+}
+
+// fills in what identifies a slice: cpu, uuid and cdhash. only reads the load commands and the code directory
+static void macho_cache_identity(macho_file *macho, uint64_t headeroff, macho_cache_slice *slice){
+    struct mach_header header;
+    uint64_t end;
+    
+    memset(slice, 0, sizeof(macho_cache_slice));
+    slice->headeroff = headeroff;
+    
+    uint8_t *commands = macho_cache_load_commands(macho, headeroff, &header, &end);
+    
+    if(!commands)
+        return;
+    
+    slice->cputype = header.cputype;
+    
+    uint64_t offset = (uint64_t)(commands - (uint8_t*)macho->buffer);
+    
+    for(uint32_t i = 0; i < header.ncmds && offset + sizeof(struct load_command) <= end; i++){
+        struct load_command load_cmd;
+        macho_read(macho, offset, &load_cmd, sizeof(struct load_command));
+        
+        if(load_cmd.cmdsize < sizeof(struct load_command) || offset + load_cmd.cmdsize > end)
+            break;
+        
+        if(load_cmd.cmd == LC_UUID && load_cmd.cmdsize >= sizeof(struct uuid_command)){
+            struct uuid_command uuid;
+            macho_read(macho, offset, &uuid, sizeof(struct uuid_command));
+            memcpy(slice->uuid, uuid.uuid, sizeof(slice->uuid));
+            slice->flags |= MACHO_CACHE_SLICE_HAS_UUID;
+        } else if(load_cmd.cmd == LC_CODE_SIGNATURE && load_cmd.cmdsize >= sizeof(struct linkedit_data_command)){
+            struct linkedit_data_command linkedit;
+            macho_read(macho, offset, &linkedit, sizeof(struct linkedit_data_command));
+            
+            uint64_t begin = headeroff + linkedit.dataoff;
+            
+            if(begin + sizeof(SuperBlob) > macho->size || linkedit.datasize < sizeof(SuperBlob))
+                goto next;
+            
+            SuperBlob superblob;
+            macho_read(macho, begin, &superblob, sizeof(SuperBlob));
+            uint32_t count = swap32(superblob.count);
+            
+            for(uint32_t j = 0; j < count && sizeof(SuperBlob) + (j + 1) * sizeof(BlobIndex) <= linkedit.datasize; j++){
+                BlobIndex index;
+                macho_read(macho, begin + sizeof(SuperBlob) + j * sizeof(BlobIndex), &index, sizeof(BlobIndex));
+                
+                if(swap32(index.type) != CSSLOT_CODEDIRECTORY)
+                    continue;
+                
+                uint64_t blob = begin + swap32(index.offset);
+                
+                if(blob + sizeof(struct code_directory) > macho->size)
+                    break;
+                
+                struct code_directory directory;
+                macho_read(macho, blob, &directory, sizeof(struct code_directory));
+                
+                uint32_t length = swap32(directory.blob.length);
+                
+                if(swap32(directory.blob.magic) != CSMAGIC_CODEDIRECTORY || blob + length > macho->size)
+                    break;
+                
+                uint8_t digest[MACHO_SHA256_DIGEST_LENGTH];
+                
+                if(directory.hashType == HASH_TYPE_SHA256)
+                    macho_sha256(macho_get_range(macho, blob, length), length, digest);
+                else
+                    macho_sha1(macho_get_range(macho, blob, length), length, digest);
+                
+                memcpy(slice->cdhash, digest, sizeof(slice->cdhash));
+                slice->flags |= MACHO_CACHE_SLICE_HAS_CDHASH;
+                break;
+            }
+        }
+    
+    next:
+        offset += load_cmd.cmdsize;
+    }
+}
+
+// header offsets of every thin image in the file
+static uint32_t macho_cache_slices(macho_file *macho, uint64_t *headeroffs){
+    uint32_t magic;
+    
+    if(macho->size < sizeof(uint32_t))
+        return 0;
+    
+    macho_read(macho, 0, &magic, sizeof(uint32_t));
+    
+    if(magic != FAT_MAGIC && magic != FAT_CIGAM){
+        headeroffs[0] = 0;
+        return 1;
+    }
+    
+    struct fat_header header;
+    
+    if(macho->size < sizeof(struct fat_header))
+        return 0;
+    
+    macho_read(macho, 0, &header, sizeof(struct fat_header));
+    
+    uint32_t nfat = magic == FAT_CIGAM ? swap32(header.nfat_arch) : header.nfat_arch;
+    uint32_t count = 0;
+    
+    for(uint32_t i = 0; i < nfat && count < MACHO_CACHE_MAX_SLICES; i++){
+        uint64_t offset = sizeof(struct fat_header) + (uint64_t)i * sizeof(struct fat_arch);
+        struct fat_arch arch;
+        
+        if(offset + sizeof(struct fat_arch) > macho->size)
+            break;
+        
+        macho_read(macho, offset, &arch, sizeof(struct fat_arch));
+        headeroffs[count++] = magic == FAT_CIGAM ? swap32(arch.offset) : arch.offset;
+    }
+    
+    return count;
+}
+
+// collects the symbols, segments and objc classes of one slice and appends them to writer
+static bool macho_cache_build_slice(macho_file *macho, macho_cache_writer *writer, macho_cache_slice *slice){
+    struct mach_header header;
+    uint64_t end;
+    
+    uint8_t *commands = macho_cache_load_commands(macho, slice->headeroff, &header, &end);
+    
+    // byte swapped slices only keep their identity
+    if(!commands)
+        return true;
+    
+    macho_cache_strings strings = { NULL, 0, 0 };
+    macho_cache_objc objc = { NULL, 0, 0 };
+    macho_symbol_index index = { NULL, 0, NULL, 0 };
+    bool success = false;
+    
+    macho_hash_init(&strings.offsets, 0);
+    // offset 0 is the empty string so a zeroed name is always valid
+    macho_cache_intern(&strings, "");
+    
+    uint64_t offset = (uint64_t)(commands - (uint8_t*)macho->buffer);
+    
+    // the objc walk reads its pointers through the chained fixups of the slice being cached,
+    // and the segments cached are the ones the segment map was built from
+    macho_load_segments(macho, slice->headeroff);
+    
+    for(uint32_t i = 0; i < header.ncmds && offset + sizeof(struct load_command) <= end; i++){
+        struct load_command load_cmd;
+        macho_read(macho, offset, &load_cmd, sizeof(struct load_command));
+        
+        if(load_cmd.cmdsize < sizeof(struct load_command) || offset + load_cmd.cmdsize > end)
+            break;
+        
+        if(load_cmd.cmd == LC_SEGMENT_64){
+            struct segment_command_64 segment;
+            macho_read(macho, offset, &segment, sizeof(struct segment_command_64));
+            
+            uint64_t sect_offset = offset + sizeof(struct segment_command_64);
+            
+            for(uint32_t j = 0; j < segment.nsects && sect_offset + sizeof(struct section_64) <= offset + load_cmd.cmdsize; j++){
+                struct section_64 section;
+                macho_read(macho, sect_offset, &section, sizeof(struct section_64));
+                
+                if(strncmp(section.sectname, kObjc2ClassList, sizeof(section.sectname)) == 0)
+                    macho_visit_objc_64(macho, section.addr, slice->headeroff + section.offset, section.size, macho_cache_visit_method, &objc);
+                
+                sect_offset += sizeof(struct section_64);
+            }
+        } else if(load_cmd.cmd == LC_SYMTAB && !index.symbols){
+            struct symtab_command symtab;
+            macho_read(macho, offset, &symtab, sizeof(struct symtab_command));
+            
+            if(!macho_symbol_index_build(macho, &index, slice->headeroff, symtab.symoff, symtab.nsyms, symtab.stroff, symtab.strsize))
+                goto done;
+        }
+        
+        offset += load_cmd.cmdsize;
+    }
+    
+    // symbols, with their names moved from the image's string table into the pool
+    macho_cache_named *named = malloc((index.count ? index.count : 1) * sizeof(macho_cache_named));
+    uint32_t *by_name = malloc((index.count ? index.count : 1) * sizeof(uint32_t));
+    
+    if(!named || !by_name){
+        free(named);
+        free(by_name);
+        goto done;
+    }
+    
+    for(uint32_t i = 0; i < index.count; i++){
+        named[i].name = macho_symbol_index_name(&index, &index.symbols[i]);
+        named[i].index = i;
+        index.symbols[i].name = macho_cache_intern(&strings, named[i].name);
+    }
+    
+    qsort(named, index.count, sizeof(macho_cache_named), macho_cache_named_compare);
+    
+    for(uint32_t i = 0; i < index.count; i++)
+        by_name[i] = named[i].index;
+    
+    free(named);
+    
+    slice->num_symbols = index.count;
+    slice->symbols = macho_cache_append(writer, index.symbols, index.count * sizeof(macho_symbol));
+    slice->symbols_by_name = macho_cache_append(writer, by_name, index.count * sizeof(uint32_t));
+    
+    free(by_name);
+    
+    slice->num_segments = macho->segment_map.count;
+    slice->segments = macho_cache_append(writer, macho->segment_map.segments, macho->segment_map.count * sizeof(macho_segment));
+    
+    // a class and its metaclass share a name, their entries end up next to each other and merge into one class
+    qsort(objc.entries, objc.count, sizeof(macho_cache_objc_entry), macho_cache_objc_compare);
+    
+    macho_cache_class *classes = calloc(objc.count ? objc.count : 1, sizeof(macho_cache_class));
+    macho_cache_method *methods = calloc(objc.count ? objc.count : 1, sizeof(macho_cache_method));
+    
+    if(!classes || !methods){
+        free(classes);
+        free(methods);
+        goto done;
+    }
+    
+    for(size_t i = 0; i < objc.count; i++){
+        macho_cache_objc_entry *entry = &objc.entries[i];
+        
+        if(!slice->num_classes || strcmp(entry->classname, strings.data + classes[slice->num_classes - 1].name) != 0){
+            macho_cache_class *class = &classes[slice->num_classes++];
+            
+            class->name = macho_cache_intern(&strings, entry->classname);
+            class->first_method = slice->num_methods;
+        }
+        
+        if(!entry->methodname)
+            continue;
+        
+        macho_cache_method *method = &methods[slice->num_methods++];
+        
+        method->imp = entry->imp;
+        method->name = macho_cache_intern(&strings, entry->methodname);
+        method->metaclass = entry->metaclass;
+        
+        classes[slice->num_classes - 1].num_methods++;
+    }
+    
+    slice->classes = macho_cache_append(writer, classes, slice->num_classes * sizeof(macho_cache_class));
+    slice->methods = macho_cache_append(writer, methods, slice->num_methods * sizeof(macho_cache_method));
+    
+    free(classes);
+    free(methods);
+    
+    uint64_t *function_starts;
+    
+    slice->num_function_starts = macho_load_function_starts(macho, &function_starts);
+    slice->function_starts = macho_cache_append(writer, function_starts, slice->num_function_starts * sizeof(uint64_t));
+    
+    slice->strsize = strings.size;
+    slice->strings = macho_cache_append(writer, strings.data, strings.size);
+    
+    success = !writer->failed;
+
+done:
+    macho_release_image(macho);
+    macho_hash_free(&strings.offsets);
+    free(strings.data);
+    free(objc.entries);
+    
+    return success;
+}
+
+char* macho_cache_path(const char *dir, const char *path){
+    char resolved[PATH_MAX];
+    
+    if(!realpath(path, resolved))
+        return NULL;
+    
+    const char *name = strrchr(resolved, '/');
+    name = name ? name + 1 : resolved;
+    
+    // the basename keeps the directory readable, the hash of the full path keeps same named files apart
+    size_t size = strlen(dir) + strlen(name) + 32;
+    char *cache_path = malloc(size);
+    
+    if(cache_path)
+        snprintf(cache_path, size, "%s/%s-%016llx.mpcache", dir, name, (unsigned long long)macho_hash_string(resolved));
+    
+    return cache_path;
+}
+
+static bool macho_cache_stat(macho_file *macho, struct stat *st){
+    return macho->file && fstat(fileno(macho->file), st) == 0 && S_ISREG(st->st_mode);
+}
+
+bool macho_cache_build(macho_file *macho, const char *cache_path){
+    struct stat st;
+    uint64_t headeroffs[MACHO_CACHE_MAX_SLICES];
+    
+    if(!macho_cache_stat(macho, &st))
+        return false;
+    
+    uint32_t nslices = macho_cache_slices(macho, headeroffs);
+    
+    macho_cache_writer writer = { NULL, 0, 0, false };
+    macho_cache_header header = {
+        .magic = MACHO_CACHE_MAGIC,
+        .version = MACHO_CACHE_VERSION,
+        .nslices = nslices,
+        .file_size = (uint64_t)st.st_size,
+        .mtime_sec = (int64_t)st.st_mtime,
+        .mtime_nsec = (int64_t)macho_mtime_nsec(st)
+    };
+    macho_cache_slice slices[MACHO_CACHE_MAX_SLICES];
+    
+    macho_cache_append(&writer, &header, sizeof(macho_cache_header));
+    uint64_t slices_offset = macho_cache_append(&writer, NULL, nslices * sizeof(macho_cache_slice));
+    
+    for(uint32_t i = 0; i < nslices; i++){
+        macho_cache_identity(macho, headeroffs[i], &slices[i]);
+        
+        if(!macho_cache_build_slice(macho, &writer, &slices[i])){
+            free(writer.data);
+            return false;
+        }
+    }
+    
+    if(writer.failed){
+        free(writer.data);
+        return false;
+    }
+    
+    memcpy(writer.data + slices_offset, slices, nslices * sizeof(macho_cache_slice));
+    
+    // written next to the final name and renamed over it so readers never see half a cache
+    size_t tmp_size = strlen(cache_path) + 8;
+    char *tmp_path = malloc(tmp_size);
+    bool success = false;
+    
+    if(tmp_path){
+        snprintf(tmp_path, tmp_size, "%s.XXXXXX", cache_path);
+        
+        int fd = mkstemp(tmp_path);
+        
+        if(fd >= 0){
+            size_t written = 0;
+            
+            while(written < writer.size){
+                ssize_t n = write(fd, writer.data + written, writer.size - written);
+                
+                if(n <= 0)
+                    break;
+                
+                written += (size_t)n;
+            }
+            
+            success = close(fd) == 0 && written == writer.size && rename(tmp_path, cache_path) == 0;
+            
+            if(!success)
+                unlink(tmp_path);
+        }
+        
+        free(tmp_path);
+    }
+    
+    free(writer.data);
+    
+    return success;
+}
+
+static bool macho_cache_table_valid(const macho_cache *cache, uint64_t offset, uint64_t count, size_t size){
+    return offset <= cache->size && count <= (cache->size - offset) / size;
+}
+
+static bool macho_cache_slice_valid(const macho_cache *cache, const macho_cache_slice *slice){
+    if(!macho_cache_table_valid(cache, slice->symbols, slice->num_symbols, sizeof(macho_symbol)) ||
+       !macho_cache_table_valid(cache, slice->symbols_by_name, slice->num_symbols, sizeof(uint32_t)) ||
+       !macho_cache_table_valid(cache, slice->segments, slice->num_segments, sizeof(macho_segment)) ||
+       !macho_cache_table_valid(cache, slice->classes, slice->num_classes, sizeof(macho_cache_class)) ||
+       !macho_cache_table_valid(cache, slice->methods, slice->num_methods, sizeof(macho_cache_method)) ||
+       !macho_cache_table_valid(cache, slice->function_starts, slice->num_function_starts, sizeof(uint64_t)) ||
+       slice->num_function_starts > UINT32_MAX ||
+       !macho_cache_table_valid(cache, slice->strings, slice->strsize, 1))
+        return false;
+    
+    // every name has to be a terminated string inside the pool
+    return slice->strsize == 0 || cache->map[slice->strings + slice->strsize - 1] == '\0';
+}
+
+bool macho_cache_open(macho_cache *cache, const char *cache_path, macho_file *macho){
+    struct stat image_st, st;
+    
+    memset(cache, 0, sizeof(macho_cache));
+    
+    if(!macho_cache_stat(macho, &image_st))
+        return false;
+    
+    int fd = open(cache_path, O_RDONLY);
+    
+    if(fd < 0)
+        return false;
+    
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(macho_cache_header)){
+        close(fd);
+        return false;
+    }
+    
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    
+    if(map == MAP_FAILED)
+        return false;
+    
+    cache->map = map;
+    cache->size = (size_t)st.st_size;
+    cache->header = map;
+    cache->slices = (const macho_cache_slice*)(cache->map + sizeof(macho_cache_header));
+    
+    const macho_cache_header *header = cache->header;
+    
+    if(header->magic != MACHO_CACHE_MAGIC ||
+       header->version != MACHO_CACHE_VERSION ||
+       header->nslices > MACHO_CACHE_MAX_SLICES ||
+       !macho_cache_table_valid(cache, sizeof(macho_cache_header), header->nslices, sizeof(macho_cache_slice)) ||
+       header->file_size != (uint64_t)image_st.st_size ||
+       header->mtime_sec != (int64_t)image_st.st_mtime ||
+       header->mtime_nsec != (int64_t)macho_mtime_nsec(image_st))
+        goto stale;
+    
+    // size and mtime can survive a copy or a rebuild, the uuid and cdhash of every slice can't
+    uint64_t headeroffs[MACHO_CACHE_MAX_SLICES];
+    
+    if(macho_cache_slices(macho, headeroffs) != header->nslices)
+        goto stale;
+    
+    for(uint32_t i = 0; i < header->nslices; i++){
+        const macho_cache_slice *cached = &cache->slices[i];
+        macho_cache_slice slice;
+        
+        macho_cache_identity(macho, headeroffs[i], &slice);
+        
+        if(cached->cputype != slice.cputype ||
+           cached->headeroff != slice.headeroff ||
+           cached->flags != slice.flags ||
+           memcmp(cached->uuid, slice.uuid, sizeof(slice.uuid)) != 0 ||
+           memcmp(cached->cdhash, slice.cdhash, sizeof(slice.cdhash)) != 0 ||
+           !macho_cache_slice_valid(cache, cached))
+            goto stale;
+    }
+    
+    return true;
+
+stale:
+    macho_cache_close(cache);
+    return false;
+}
+
+void macho_cache_close(macho_cache *cache){
+    if(cache->map)
+        munmap(cache->map, cache->size);
+    
+    memset(cache, 0, sizeof(macho_cache));
+}
+
+macho_symbol_index macho_cache_symbol_index(const macho_cache *cache, const macho_cache_slice *slice){
+    macho_symbol_index index;
+    
+    index.symbols = (macho_symbol*)(cache->map + slice->symbols);
+    index.count = slice->num_symbols;
+    index.strtab = (const char*)cache->map + slice->strings;
+    index.strsize = (uint32_t)slice->strsize;
+    
+    return index;
+}
+
+const char* macho_cache_string(const macho_cache *cache, const macho_cache_slice *slice, uint32_t offset){
+    return offset < slice->strsize ? (const char*)cache->map + slice->strings + offset : "";
+}
+
+const macho_symbol* macho_cache_find_symbol(const macho_cache *cache, const macho_cache_slice *slice, const char *name){
+    const macho_symbol *symbols = (const macho_symbol*)(cache->map + slice->symbols);
+    const uint32_t *by_name = (const uint32_t*)(cache->map + slice->symbols_by_name);
+    uint32_t lo = 0;
+    uint32_t hi = slice->num_symbols;
+    
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        
+        if(by_name[mid] >= slice->num_symbols)
+            return NULL;
+        
+        const macho_symbol *symbol = &symbols[by_name[mid]];
+        int order = strcmp(macho_cache_string(cache, slice, symbol->name), name);
+        
+        if(order == 0)
+            return symbol;
+        
+        if(order < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    return NULL;
+}
+
+const macho_segment* macho_cache_find_segment(const macho_cache *cache, const macho_cache_slice *slice, uint64_t address){
+    const macho_segment *segments = (const macho_segment*)(cache->map + slice->segments);
+    
+    // a handful of segments per image, a scan is as fast as anything else
+    for(uint32_t i = 0; i < slice->num_segments; i++){
+        if(address >= segments[i].vmaddr && address - segments[i].vmaddr < segments[i].vmsize)
+            return &segments[i];
+    }
+    
+    return NULL;
+}
+
+const macho_cache_class* macho_cache_find_class(const macho_cache *cache, const macho_cache_slice *slice, const char *name){
+    const macho_cache_class *classes = (const macho_cache_class*)(cache->map + slice->classes);
+    uint32_t lo = 0;
+    uint32_t hi = slice->num_classes;
+    
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        int order = strcmp(macho_cache_string(cache, slice, classes[mid].name), name);
+        
+        if(order == 0)
+            return &classes[mid];
+        
+        if(order < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    return NULL;
+}
+
+const macho_cache_method* macho_cache_find_method(const macho_cache *cache, const macho_cache_slice *slice, const macho_cache_class *class, const char *name){
+    const macho_cache_method *methods = (const macho_cache_method*)(cache->map + slice->methods);
+    uint32_t lo = class->first_method;
+    uint32_t hi = class->first_method + class->num_methods;
+    
+    if(hi > slice->num_methods || lo > hi)
+        return NULL;
+    
+    // lower bound so an instance and class method with the same name both stay reachable from the first
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        
+        if(strcmp(macho_cache_string(cache, slice, methods[mid].name), name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    if(lo < class->first_method + class->num_methods && strcmp(macho_cache_string(cache, slice, methods[lo].name), name) == 0)
+        return &methods[lo];
+    
+    return NULL;
+}
+
+static const char* macho_cache_cpu_name(int32_t cputype){
+    for(int i = 0; i < NUM_CPUS; i++){
+        if(cpu_type_names[i].cputype == cputype)
+            return cpu_type_names[i].cpu_name;
+    }
+    
+    return "unknown";
+}
+
+static void macho_cache_query_slice(macho_file *macho, const macho_cache *cache, const macho_cache_slice *slice){
+    symbol_table *table = macho->symboltable;
+    
+    // the disassembler translates through the live segments and picks its architecture from these flags,
+    // both normally set up while parsing the header
+    macho_load_segments(macho, slice->headeroff);
+    
+    macho->is64bit = slice->cputype == CPU_TYPE_X86_64 || slice->cputype == CPU_TYPE_ARM64;
+    macho->x86 = slice->cputype == CPU_TYPE_X86_64 || slice->cputype == CPU_TYPE_I386;
+    macho->arm = slice->cputype == CPU_TYPE_ARM64 || slice->cputype == CPU_TYPE_ARM;
+    
+    // functions end where the cached symbols and function starts say, the image's symbol table isn't touched
+    macho_symbol_index symbols = macho_cache_symbol_index(cache, slice);
+    macho_set_function_bounds(macho, &symbols, (const uint64_t*)(cache->map + slice->function_starts), (uint32_t)slice->num_function_starts);
+    
+    macho_print(macho, "CPU - %s\n", macho_cache_cpu_name(slice->cputype));
+    
+    macho_emit(macho, image, .cpu = macho_cache_cpu_name(slice->cputype), .cputype = slice->cputype, .offset = slice->headeroff);
+    
+    if(slice->flags & MACHO_CACHE_SLICE_HAS_UUID){
+        macho_print(macho, "UUID - ");
+        
+        for(int i = 0; i < 16; i++)
+            macho_print(macho, "%02X%s", slice->uuid[i], (i == 3 || i == 5 || i == 7 || i == 9) ? "-" : "");
+        
+        macho_print(macho, "\n");
+    }
+    
+    macho_print(macho, "\t%u symbols, %u segments, %u classes, %u methods\n",
+            slice->num_symbols, slice->num_segments, slice->num_classes, slice->num_methods);
+    
+    for(uint32_t i = 0; table && i < table->num_symbols; i++){
+        const char *name = table->symbols[i];
+        const macho_symbol *symbol = macho_cache_find_symbol(cache, slice, name);
+        
+        if(symbol){
+            const macho_segment *segment = macho_cache_find_segment(cache, slice, symbol->address);
+            
+            macho_print(macho, "\t\tSymbol \"%s\" value: 0x%llx size: 0x%x segment: %.16s\n",
+                    name, (unsigned long long)symbol->address, symbol->size, segment ? segment->segname : "?");
+            
+            char segname[17];
+            
+            snprintf(segname, sizeof(segname), "%.16s", segment ? segment->segname : "?");
+            macho_emit(macho, symbol, .name = name, .value = symbol->address, .size = symbol->size, .segment = segname);
+            
+            macho_disassemble_code(macho, symbol->address);
+            continue;
+        }
+        
+        // CLASSNAME-METHOD, split the same way the symbol table does
+        const char *separator = strchr(name, '-');
+        
+        if(separator && separator != name && separator[1] && !strchr(separator + 1, '-')){
+            char classname[256];
+            size_t length = (size_t)(separator - name);
+            
+            if(length < sizeof(classname)){
+                memcpy(classname, name, length);
+                classname[length] = '\0';
+                
+                const macho_cache_class *class = macho_cache_find_class(cache, slice, classname);
+                const macho_cache_method *method = class ? macho_cache_find_method(cache, slice, class, separator + 1) : NULL;
+                
+                if(method){
+                    macho_print(macho, "\t\tMethod %c[%s %s] imp: 0x%08llx\n",
+                            method->metaclass ? '+' : '-', classname, separator + 1, (unsigned long long)method->imp);
+                    
+                    macho_emit(macho, objc_method, .classname = classname, .name = separator + 1,
+                               .imp = method->imp, .metaclass = method->metaclass);
+                    
+                    macho_disassemble_code(macho, method->imp);
+                    continue;
+                }
+            }
+        }
+        
+        macho_print(macho, "\t\tSymbol \"%s\" not found\n", name);
+    }
+    
+    size_t count = macho->options.num_lookup_addresses;
+    
+    if(!count)
+        return;
+    
+    // released with the image by the caller, like the segments loaded above
+    const macho_symbol **results = macho_arena_alloc(&macho->arena, count * sizeof(macho_symbol*));
+    
+    if(!results)
+        return;
+    
+    macho_symbol_index index = macho_cache_symbol_index(cache, slice);
+    macho_symbol_index_lookup_batch(&index, macho->options.lookup_addresses, results, count);
+    macho_count(macho, MACHO_COUNTER_LOOKUPS, count);
+    
+    macho_print(macho, "\tLookups (%u indexed symbols)\n", index.count);
+    
+    for(size_t i = 0; i < count; i++){
+        uint64_t address = macho->options.lookup_addresses[i];
+        const macho_segment *segment = macho_cache_find_segment(cache, slice, address);
+        
+        char segname[17];
+        
+        snprintf(segname, sizeof(segname), "%.16s", segment ? segment->segname : "?");
+        
+        if(results[i])
+            macho_emit(macho, lookup, .address = address, .symbol = macho_symbol_index_name(&index, results[i]),
+                       .offset = address - results[i]->address, .segment = segname);
+        else
+            macho_emit(macho, lookup, .address = address);
+        
+        
+        if(results[i])
+            macho_print(macho, "\t\t0x%llx %s+0x%llx (%.16s)\n", (unsigned long long)address,
+                    macho_symbol_index_name(&index, results[i]), (unsigned long long)(address - results[i]->address),
+                    segment ? segment->segname : "?");
+        else
+            macho_print(macho, "\t\t0x%llx ???\n", (unsigned long long)address);
+    }
+}
+
+void macho_cache_query(macho_file *macho, const char *cache_dir){
+    char *cache_path = macho_cache_path(cache_dir, macho->path);
+    macho_cache cache;
+    macho_phase phase = macho_stats_enter(macho->stats, MACHO_PHASE_CACHE);
+    bool warm = cache_path && macho_cache_open(&cache, cache_path, macho);
+    bool ready = warm || (cache_path && macho_cache_build(macho, cache_path) && macho_cache_open(&cache, cache_path, macho));
+    
+    macho_stats_leave(macho->stats, phase);
+    
+    if(!ready){
+        // nothing to cache (a pipe) or nowhere to put it, parse the image the usual way
+        macho_print(macho, "Cache unavailable for %s\n", macho->path);
+        free(cache_path);
+        macho_parse_image(macho);
+        return;
+    }
+    
+    macho_print(macho, "Cache %s %s\n", warm ? "hit" : "built", cache_path);
+    
+    for(uint32_t i = 0; i < cache.header->nslices; i++){
+        // --arch picks slices the same way an uncached parse does
+        if(!macho_arch_selected(macho, cache.slices[i].cputype)){
+            if(cache.header->nslices == 1)
+                macho_print(macho, "Architecture not selected, skipping\n");
+            
+            continue;
+        }
+        
+        if(cache.header->nslices > 1)
+            macho_print(macho, "\nImage %u\n\n", i + 1);
+        
+        macho_cache_query_slice(macho, &cache, &cache.slices[i]);
+        macho_release_image(macho);
+    }
+    
+    macho_cache_close(&cache);
+    free(cache_path);
+}
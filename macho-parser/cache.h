@@ -0,0 +1,106 @@
+#ifndef __cache_h
+#define __cache_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "parser.h"
+#include "symindex.h"
+
+/*
+ * sidecar cache of everything a query needs from an image, so warm runs don't walk the mach-o again
+ * the file is mmap'd and used in place, every table is 8 byte aligned and referenced by its offset from the start
+ *
+ *  macho_cache_header
+ *  macho_cache_slice[nslices]   one per thin image, in fat arch order
+ *  per slice: macho_symbol[]    sorted by address, names point into the slice's string pool
+ *             uint32_t[]        the same symbols sorted by name, as indexes into the array above
+ *             macho_segment[]
+ *             macho_cache_class[] sorted by name
+ *             macho_cache_method[] grouped by class, sorted by name within a class
+ *             uint64_t[]        LC_FUNCTION_STARTS decoded to addresses, ascending
+ *             string pool
+ */
+
+#define MACHO_CACHE_MAGIC   0x6568636163706dULL // "mpcache"
+#define MACHO_CACHE_VERSION 3
+
+typedef struct{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t nslices;
+    // identity of the file the cache was built from
+    uint64_t file_size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+} macho_cache_header;
+
+typedef struct{
+    int32_t cputype;
+    uint32_t flags;
+    uint64_t headeroff;
+    uint8_t uuid[16];
+    uint8_t cdhash[20]; // first 20 bytes of the code directory hash, zero when unsigned
+    uint32_t reserved;
+    uint64_t symbols;
+    uint64_t symbols_by_name;
+    uint32_t num_symbols;
+    uint32_t num_segments;
+    uint64_t segments;
+    uint64_t classes;
+    uint32_t num_classes;
+    uint32_t num_methods;
+    uint64_t methods;
+    uint64_t strings;
+    uint64_t strsize;
+    // with the symbols they bound disassembly on a hit, so the image's own tables are never read
+    uint64_t function_starts;
+    uint64_t num_function_starts;
+} macho_cache_slice;
+
+#define MACHO_CACHE_SLICE_HAS_UUID   0x1
+#define MACHO_CACHE_SLICE_HAS_CDHASH 0x2
+
+typedef struct{
+    uint32_t name;
+    uint32_t first_method;
+    uint32_t num_methods;
+    uint32_t reserved;
+} macho_cache_class;
+
+typedef struct{
+    uint64_t imp;
+    uint32_t name;
+    uint32_t metaclass;
+} macho_cache_method;
+
+typedef struct{
+    uint8_t *map;
+    size_t size;
+    const macho_cache_header *header;
+    const macho_cache_slice *slices;
+} macho_cache;
+
+// where the cache of path lives inside dir, the caller frees the result
+char* macho_cache_path(const char *dir, const char *path);
+
+// maps cache_path and checks it still describes the image, false if it's missing, stale or malformed
+bool macho_cache_open(macho_cache *cache, const char *cache_path, macho_file *macho);
+void macho_cache_close(macho_cache *cache);
+
+// parses the image once and writes its cache to cache_path, replacing any previous one atomically
+bool macho_cache_build(macho_file *macho, const char *cache_path);
+
+// views straight into the mapped cache, nothing is copied
+macho_symbol_index macho_cache_symbol_index(const macho_cache *cache, const macho_cache_slice *slice);
+const char* macho_cache_string(const macho_cache *cache, const macho_cache_slice *slice, uint32_t offset);
+const macho_symbol* macho_cache_find_symbol(const macho_cache *cache, const macho_cache_slice *slice, const char *name);
+const macho_segment* macho_cache_find_segment(const macho_cache *cache, const macho_cache_slice *slice, uint64_t address);
+const macho_cache_class* macho_cache_find_class(const macho_cache *cache, const macho_cache_slice *slice, const char *name);
+const macho_cache_method* macho_cache_find_method(const macho_cache *cache, const macho_cache_slice *slice, const macho_cache_class *class, const char *name);
+
+// answers the symbol, CLASSNAME-METHOD and --lookup queries of macho from the cache in cache_dir
+// building the cache first when there isn't a valid one yet
+void macho_cache_query(macho_file *macho, const char *cache_dir);
+
+#endif
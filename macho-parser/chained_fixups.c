@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chained_fixups.h"
+#include "mach-o.h"
+
+typedef struct{
+    macho_file *macho;
+    macho_chained_fixups *fixups;
+    uint32_t capacity;
+    uint64_t base; // vmaddr of the mach header, what offset style targets are relative to
+} macho_chain_walker;
+
+static bool macho_chained_fixups_append(macho_chain_walker *walker, const macho_chained_fixup *fixup){
+    macho_chained_fixups *fixups = walker->fixups;
+    
+    if(fixups->count == walker->capacity){
+        uint32_t capacity = walker->capacity ? walker->capacity * 2 : 256;
+        macho_chained_fixup *grown = macho_arena_realloc(&walker->macho->arena, fixups->fixups,
+                                                         walker->capacity * sizeof(macho_chained_fixup),
+                                                         capacity * sizeof(macho_chained_fixup));
+        
+        if(!grown)
+            return false;
+        
+        fixups->fixups = grown;
+        walker->capacity = capacity;
+    }
+    
+    fixups->fixups[fixups->count++] = *fixup;
+    
+    return true;
+}
+
+// decodes one link, returns the distance to the next one in bytes (0 at the end of the chain)
+// or UINT32_MAX when the format isn't supported
+static uint32_t macho_decode_chained_pointer(macho_chain_walker *walker, uint16_t format, uint32_t max_valid_pointer, uint64_t raw, macho_chained_fixup *fixup){
+    uint64_t base = walker->base;
+    
+    fixup->import = MACHO_CHAINED_REBASE;
+    fixup->flags = 0;
+    fixup->high8 = 0;
+    
+    switch(format){
+        case DYLD_CHAINED_PTR_ARM64E:
+        case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+        case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+            ;
+            bool auth = raw >> 63;
+            bool bind = (raw >> 62) & 1;
+            
+            if(auth)
+                fixup->flags |= MACHO_CHAINED_AUTH;
+            
+            if(bind){
+                fixup->flags |= MACHO_CHAINED_BIND;
+                fixup->import = (uint32_t)(raw & (format == DYLD_CHAINED_PTR_ARM64E_USERLAND24 ? 0xffffff : 0xffff));
+                
+                // plain binds carry a signed 19 bit addend, signed ones have the key and diversity there instead
+                if(!auth)
+                    fixup->target = (uint64_t)(((int64_t)(raw << 13)) >> 45);
+                else
+                    fixup->target = 0;
+            } else if(auth){
+                // signed rebases are always an offset from the image
+                fixup->target = base + (raw & 0xffffffff);
+            } else {
+                fixup->high8 = (uint8_t)(raw >> 43);
+                fixup->target = raw & 0x7ffffffffffULL;
+                
+                if(format != DYLD_CHAINED_PTR_ARM64E)
+                    fixup->target += base;
+            }
+            
+            return (uint32_t)((raw >> 51) & 0x7ff) * 8;
+        case DYLD_CHAINED_PTR_64:
+        case DYLD_CHAINED_PTR_64_OFFSET:
+            if(raw >> 63){
+                fixup->flags |= MACHO_CHAINED_BIND;
+                fixup->import = (uint32_t)(raw & 0xffffff);
+                fixup->target = (raw >> 24) & 0xff;
+            } else {
+                fixup->high8 = (uint8_t)(raw >> 36);
+                fixup->target = raw & 0xfffffffffULL;
+                
+                if(format == DYLD_CHAINED_PTR_64_OFFSET)
+                    fixup->target += base;
+            }
+            
+            return (uint32_t)((raw >> 51) & 0xfff) * 4;
+        case DYLD_CHAINED_PTR_32:
+            if((raw >> 31) & 1){
+                fixup->flags |= MACHO_CHAINED_BIND;
+                fixup->import = (uint32_t)(raw & 0xfffff);
+                fixup->target = (raw >> 20) & 0x3f;
+            } else {
+                fixup->target = raw & 0x3ffffff;
+                
+                // values past max_valid_pointer are plain integers stored with a bias, not pointers
+                if(fixup->target > max_valid_pointer)
+                    fixup->target -= (0x4000000 + max_valid_pointer) / 2;
+            }
+            
+            return (uint32_t)((raw >> 26) & 0x1f) * 4;
+        default:
+            return UINT32_MAX;
+    }
+}
+
+// follows one chain from the pointer at file offset location, which lives at address
+static bool macho_walk_chain(macho_chain_walker *walker, const struct dyld_chained_starts_in_segment *starts, uint16_t segment, uint64_t location, uint64_t address, uint64_t limit){
+    macho_file *macho = walker->macho;
+    size_t pointer_size = starts->pointer_format == DYLD_CHAINED_PTR_32 ? 4 : 8;
+    
+    for(;;){
+        macho_chained_fixup fixup;
+        uint64_t raw = 0;
+        
+        if(location + pointer_size > limit)
+            return false;
+        
+        macho_read(macho, location, &raw, pointer_size);
+        
+        uint32_t next = macho_decode_chained_pointer(walker, starts->pointer_format, starts->max_valid_pointer, raw, &fixup);
+        
+        if(next == UINT32_MAX)
+            return false;
+        
+        fixup.address = address;
+        fixup.segment = segment;
+        
+        if(!macho_chained_fixups_append(walker, &fixup))
+            return false;
+        
+        if(!next)
+            return true;
+        
+        location += next;
+        address += next;
+    }
+}
+
+static int macho_chained_fixup_compare(const void *a, const void *b){
+    uint64_t x = ((const macho_chained_fixup*)a)->address;
+    uint64_t y = ((const macho_chained_fixup*)b)->address;
+    
+    return x < y ? -1 : x > y;
+}
+
+static bool macho_chained_imports_build(macho_file *macho, const uint8_t *data, size_t size, const struct dyld_chained_fixups_header *header, macho_chained_fixups *fixups){
+    static const size_t import_sizes[] = {0, 4, 8, 16};
+    
+    if(!header->imports_count)
+        return true;
+    
+    if(header->imports_format < DYLD_CHAINED_IMPORT || header->imports_format > DYLD_CHAINED_IMPORT_ADDEND64 || header->symbols_format != 0)
+        return false;
+    
+    size_t entry_size = import_sizes[header->imports_format];
+    
+    if((uint64_t)header->imports_offset + (uint64_t)header->imports_count * entry_size > size || header->symbols_offset >= size)
+        return false;
+    
+    fixups->imports = macho_arena_calloc(&macho->arena, header->imports_count, sizeof(macho_chained_import));
+    
+    if(!fixups->imports)
+        return false;
+    
+    const char *symbols = (const char*)data + header->symbols_offset;
+    size_t symbols_size = size - header->symbols_offset;
+    
+    for(uint32_t i = 0; i < header->imports_count; i++){
+        const uint8_t *entry = data + header->imports_offset + i * entry_size;
+        macho_chained_import *import = &fixups->imports[i];
+        uint64_t name_offset;
+        
+        if(header->imports_format == DYLD_CHAINED_IMPORT_ADDEND64){
+            uint64_t value;
+            memcpy(&value, entry, sizeof(uint64_t));
+            memcpy(&import->addend, entry + 8, sizeof(int64_t));
+            
+            uint16_t ordinal = value & 0xffff;
+            import->ordinal = ordinal > 0xfff0 ? (int16_t)ordinal : ordinal;
+            import->weak = (value >> 16) & 1;
+            name_offset = value >> 32;
+        } else {
+            uint32_t value;
+            memcpy(&value, entry, sizeof(uint32_t));
+            
+            if(header->imports_format == DYLD_CHAINED_IMPORT_ADDEND){
+                int32_t addend;
+                memcpy(&addend, entry + 4, sizeof(int32_t));
+                import->addend = addend;
+            }
+            
+            // ordinals above 0xf0 are the negative BIND_SPECIAL_DYLIB_ ones
+            uint8_t ordinal = value & 0xff;
+            import->ordinal = ordinal > 0xf0 ? (int8_t)ordinal : ordinal;
+            import->weak = (value >> 8) & 1;
+            name_offset = value >> 9;
+        }
+        
+        if(name_offset >= symbols_size || !memchr(symbols + name_offset, '\0', symbols_size - name_offset))
+            return false;
+        
+        import->name = symbols + name_offset;
+        fixups->num_imports++;
+    }
+    
+    return true;
+}
+
+bool macho_chained_fixups_build(macho_file *macho, const uint8_t *data, size_t size, macho_chained_fixups *fixups){
+    struct dyld_chained_fixups_header header;
+    const macho_segment *text = macho_header_segment(macho);
+    macho_chain_walker walker = { .macho = macho, .fixups = fixups, .capacity = 0, .base = text ? text->vmaddr : 0 };
+    bool valid = true;
+    
+    memset(fixups, 0, sizeof(macho_chained_fixups));
+    
+    if(size < sizeof(struct dyld_chained_fixups_header))
+        return false;
+    
+    memcpy(&header, data, sizeof(struct dyld_chained_fixups_header));
+    
+    if(!macho_chained_imports_build(macho, data, size, &header, fixups))
+        return false;
+    
+    uint32_t seg_count;
+    
+    if((uint64_t)header.starts_offset + sizeof(uint32_t) > size)
+        return false;
+    
+    memcpy(&seg_count, data + header.starts_offset, sizeof(uint32_t));
+    
+    if((uint64_t)header.starts_offset + sizeof(uint32_t) * (1 + (uint64_t)seg_count) > size)
+        return false;
+    
+    for(uint32_t i = 0; i < seg_count && i < macho->segment_map.count && valid; i++){
+        uint32_t seg_info_offset;
+        memcpy(&seg_info_offset, data + header.starts_offset + sizeof(uint32_t) * (1 + i), sizeof(uint32_t));
+        
+        if(!seg_info_offset)
+            continue;
+        
+        uint64_t starts_offset = (uint64_t)header.starts_offset + seg_info_offset;
+        
+        if(starts_offset + offsetof(struct dyld_chained_starts_in_segment, page_start) > size){
+            valid = false;
+            break;
+        }
+        
+        // the page starts are 2 byte aligned inside the payload, copy the fixed part out and read them one by one
+        struct dyld_chained_starts_in_segment starts;
+        memcpy(&starts, data + starts_offset, offsetof(struct dyld_chained_starts_in_segment, page_start));
+        
+        const uint8_t *page_starts = data + starts_offset + offsetof(struct dyld_chained_starts_in_segment, page_start);
+        uint64_t num_starts = (size - starts_offset - offsetof(struct dyld_chained_starts_in_segment, page_start)) / sizeof(uint16_t);
+        
+        if(starts.page_count > num_starts){
+            valid = false;
+            break;
+        }
+        
+        const macho_segment *segment = &macho->segment_map.segments[i];
+        uint64_t fileoff = macho->fileoff_base + segment->fileoff;
+        uint64_t limit = fileoff + segment->filesize < macho->size ? fileoff + segment->filesize : macho->size;
+        
+        for(uint16_t page = 0; page < starts.page_count && valid; page++){
+            uint16_t start;
+            memcpy(&start, page_starts + page * sizeof(uint16_t), sizeof(uint16_t));
+            
+            if(start == DYLD_CHAINED_PTR_START_NONE)
+                continue;
+            
+            uint64_t page_offset = (uint64_t)page * starts.page_size;
+            
+            if(!(start & DYLD_CHAINED_PTR_START_MULTI)){
+                valid = macho_walk_chain(&walker, &starts, (uint16_t)i, fileoff + page_offset + start, segment->vmaddr + page_offset + start, limit);
+                continue;
+            }
+            
+            // 32 bit formats can start several chains on one page, listed after the page starts
+            for(uint64_t index = start & ~DYLD_CHAINED_PTR_START_MULTI; valid; index++){
+                uint16_t chain;
+                
+                if(index >= num_starts){
+                    valid = false;
+                    break;
+                }
+                
+                memcpy(&chain, page_starts + index * sizeof(uint16_t), sizeof(uint16_t));
+                
+                uint16_t chain_offset = chain & ~DYLD_CHAINED_PTR_START_LAST;
+                valid = macho_walk_chain(&walker, &starts, (uint16_t)i, fileoff + page_offset + chain_offset, segment->vmaddr + page_offset + chain_offset, limit);
+                
+                if(chain & DYLD_CHAINED_PTR_START_LAST)
+                    break;
+            }
+        }
+    }
+    
+    // segments are almost always in address order so this is just a check
+    for(uint32_t i = 1; i < fixups->count; i++){
+        if(fixups->fixups[i - 1].address > fixups->fixups[i].address){
+            qsort(fixups->fixups, fixups->count, sizeof(macho_chained_fixup), macho_chained_fixup_compare);
+            break;
+        }
+    }
+    
+    return valid;
+}
+
+const macho_chained_fixup* macho_chained_fixups_find(const macho_chained_fixups *fixups, uint64_t address){
+    uint32_t lo = 0;
+    uint32_t hi = fixups->count;
+    
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        
+        if(fixups->fixups[mid].address < address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    return lo < fixups->count && fixups->fixups[lo].address == address ? &fixups->fixups[lo] : NULL;
+}
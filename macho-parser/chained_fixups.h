@@ -0,0 +1,119 @@
+#ifndef __chained_fixups_h
+#define __chained_fixups_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "parser.h"
+
+#if defined(__has_include)
+#if __has_include(<mach-o/fixup-chains.h>)
+#include <mach-o/fixup-chains.h>
+#define MACHO_HAVE_FIXUP_CHAINS_H 1
+#endif
+#endif
+
+#ifndef MACHO_HAVE_FIXUP_CHAINS_H
+
+// the parts of <mach-o/fixup-chains.h> used here, for SDKs older than chained fixups
+
+struct dyld_chained_fixups_header{
+    uint32_t fixups_version;
+    uint32_t starts_offset;  // dyld_chained_starts_in_image
+    uint32_t imports_offset;
+    uint32_t symbols_offset;
+    uint32_t imports_count;
+    uint32_t imports_format; // DYLD_CHAINED_IMPORT_
+    uint32_t symbols_format; // 0 is uncompressed
+};
+
+struct dyld_chained_starts_in_image{
+    uint32_t seg_count;
+    uint32_t seg_info_offset[1]; // seg_count of them, 0 for a segment without fixups
+};
+
+struct dyld_chained_starts_in_segment{
+    uint32_t size;
+    uint16_t page_size;
+    uint16_t pointer_format;    // DYLD_CHAINED_PTR_
+    uint64_t segment_offset;    // vm offset of the segment from the mach header
+    uint32_t max_valid_pointer; // 32 bit formats only, larger values are not pointers
+    uint16_t page_count;
+    uint16_t page_start[1];     // page_count of them
+};
+
+enum{
+    DYLD_CHAINED_PTR_START_NONE  = 0xFFFF,
+    DYLD_CHAINED_PTR_START_MULTI = 0x8000,
+    DYLD_CHAINED_PTR_START_LAST  = 0x8000
+};
+
+enum{
+    DYLD_CHAINED_PTR_ARM64E            = 1,
+    DYLD_CHAINED_PTR_64                = 2,
+    DYLD_CHAINED_PTR_32                = 3,
+    DYLD_CHAINED_PTR_32_CACHE          = 4,
+    DYLD_CHAINED_PTR_32_FIRMWARE       = 5,
+    DYLD_CHAINED_PTR_64_OFFSET         = 6,
+    DYLD_CHAINED_PTR_ARM64E_KERNEL     = 7,
+    DYLD_CHAINED_PTR_64_KERNEL_CACHE   = 8,
+    DYLD_CHAINED_PTR_ARM64E_USERLAND   = 9,
+    DYLD_CHAINED_PTR_ARM64E_FIRMWARE   = 10,
+    DYLD_CHAINED_PTR_X86_64_KERNEL_CACHE = 11,
+    DYLD_CHAINED_PTR_ARM64E_USERLAND24 = 12
+};
+
+enum{
+    DYLD_CHAINED_IMPORT          = 1,
+    DYLD_CHAINED_IMPORT_ADDEND   = 2,
+    DYLD_CHAINED_IMPORT_ADDEND64 = 3
+};
+
+#endif
+
+/*
+ * LC_DYLD_CHAINED_FIXUPS stores every pointer of an image as a link in a per page chain, the pointer bits
+ * hold the next link, the target and (on arm64e) authentication data instead of a plain address
+ * every chain is walked once up front into a table sorted by location, after that resolving a pointer
+ * is a binary search of that table rather than a walk from the start of its page
+ */
+
+#define MACHO_CHAINED_REBASE UINT32_MAX
+
+enum{
+    MACHO_CHAINED_BIND = 1 << 0,
+    MACHO_CHAINED_AUTH = 1 << 1  // arm64e signed pointer
+};
+
+typedef struct{
+    uint64_t address; // where the pointer lives
+    uint64_t target;  // untagged address a rebase points to, the addend of a bind
+    uint32_t import;  // index into imports for a bind, MACHO_CHAINED_REBASE otherwise
+    uint8_t flags;    // MACHO_CHAINED_
+    uint8_t high8;    // top byte tag of a rebase, dropped from target
+    uint16_t segment; // index into macho->segments
+} macho_chained_fixup;
+
+typedef struct{
+    const char *name;
+    int32_t ordinal;
+    int64_t addend;
+    bool weak;
+} macho_chained_import;
+
+typedef struct{
+    macho_chained_fixup *fixups; // sorted by address
+    uint32_t count;
+    macho_chained_import *imports;
+    uint32_t num_imports;
+} macho_chained_fixups;
+
+// decodes the LC_DYLD_CHAINED_FIXUPS payload of the current image, data is size bytes inside the mapped file
+// false if it's malformed or uses a pointer format this doesn't know, what was decoded up to then is kept
+// the fixups and imports come from the image's arena and go away with it
+bool macho_chained_fixups_build(macho_file *macho, const uint8_t *data, size_t size, macho_chained_fixups *fixups);
+
+// the fixup of the pointer stored at address, NULL if there is none. O(log n)
+const macho_chained_fixup* macho_chained_fixups_find(const macho_chained_fixups *fixups, uint64_t address);
+
+#endif
@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dyld_info.h"
+#include "leb128.h"
+
+// resolves segment + offset against the segment map and hands the fixup over
+// a fixup outside its segment means the stream is corrupt, which also bounds the repeat counts
+static inline bool macho_emit_fixup(macho_file *macho, macho_fixup *fixup, uint32_t segment, uint64_t offset, macho_fixup_visitor visitor, void *ctx, bool *stop){
+    if(segment >= macho->segment_map.count || offset >= macho->segment_map.segments[segment].vmsize)
+        return false;
+    
+    fixup->segment = (uint8_t)segment;
+    fixup->address = macho->segment_map.segments[segment].vmaddr + offset;
+    
+    if(!visitor(ctx, fixup))
+        *stop = true;
+    
+    return true;
+}
+
+// moves offset by delta, false if that leaves the segment. ld64 moves backwards with a delta that wraps,
+// so a wrapping delta is fine as long as it lands inside the segment
+static inline bool macho_advance_fixup(macho_file *macho, uint32_t segment, uint64_t *offset, uint64_t delta){
+    if(segment >= macho->segment_map.count || *offset + delta > macho->segment_map.segments[segment].vmsize)
+        return false;
+    
+    *offset += delta;
+    
+    return true;
+}
+
+// whether count fixups skip + pointer_size bytes apart from offset all land in the segment, checked before
+// a repeat loop so a corrupt count or a skip that wraps can neither spin nor grow the fixup table until memory runs out
+static inline bool macho_fixup_run_fits(macho_file *macho, uint32_t segment, uint64_t offset, uint64_t count, uint64_t skip, uint64_t pointer_size){
+    if(!count)
+        return true;
+    
+    if(segment >= macho->segment_map.count)
+        return false;
+    
+    uint64_t size = macho->segment_map.segments[segment].vmsize;
+    
+    if(offset >= size || skip > size)
+        return false;
+    
+    return count - 1 <= (size - offset - 1) / (skip + pointer_size);
+}
+
+bool macho_walk_rebase_opcodes(macho_file *macho, const uint8_t *opcodes, size_t size, macho_fixup_visitor visitor, void *ctx){
+    const uint8_t *p = opcodes;
+    const uint8_t *end = opcodes + size;
+    uint64_t pointer_size = macho->is64bit ? 8 : 4;
+    uint32_t segment = 0;
+    uint64_t offset = 0;
+    uint64_t count, skip;
+    bool stop = false;
+    macho_fixup fixup = { .kind = MACHO_FIXUP_REBASE, .type = REBASE_TYPE_POINTER };
+    
+    while(p < end && !stop){
+        // the stream came from one macho_get_range, the window follows it opcode by opcode
+        macho_window_use(macho, p, 1);
+        
+        uint8_t immediate = *p & REBASE_IMMEDIATE_MASK;
+        uint8_t opcode = *p & REBASE_OPCODE_MASK;
+        p++;
+        
+        switch(opcode){
+            case REBASE_OPCODE_DONE:
+                return true;
+            case REBASE_OPCODE_SET_TYPE_IMM:
+                fixup.type = immediate;
+                break;
+            case REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+                segment = immediate;
+                
+                if(!macho_read_uleb128(&p, end, &offset))
+                    return false;
+                break;
+            case REBASE_OPCODE_ADD_ADDR_ULEB:
+                if(!macho_read_uleb128(&p, end, &skip) || !macho_advance_fixup(macho, segment, &offset, skip))
+                    return false;
+                break;
+            case REBASE_OPCODE_ADD_ADDR_IMM_SCALED:
+                offset += immediate * pointer_size;
+                break;
+            case REBASE_OPCODE_DO_REBASE_IMM_TIMES:
+                for(uint32_t i = 0; i < immediate && !stop; i++){
+                    if(!macho_emit_fixup(macho, &fixup, segment, offset, visitor, ctx, &stop))
+                        return false;
+                    
+                    offset += pointer_size;
+                }
+                break;
+            case REBASE_OPCODE_DO_REBASE_ULEB_TIMES:
+                if(!macho_read_uleb128(&p, end, &count) || !macho_fixup_run_fits(macho, segment, offset, count, 0, pointer_size))
+                    return false;
+                
+                for(uint64_t i = 0; i < count && !stop; i++){
+                    if(!macho_emit_fixup(macho, &fixup, segment, offset, visitor, ctx, &stop))
+                        return false;
+                    
+                    offset += pointer_size;
+                }
+                break;
+            case REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB:
+                if(!macho_read_uleb128(&p, end, &skip) || !macho_emit_fixup(macho, &fixup, segment, offset, visitor, ctx, &stop) ||
+                   !macho_advance_fixup(macho, segment, &offset, skip + pointer_size))
+                    return false;
+                break;
+            case REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB:
+                if(!macho_read_uleb128(&p, end, &count) || !macho_read_uleb128(&p, end, &skip) ||
+                   !macho_fixup_run_fits(macho, segment, offset, count, skip, pointer_size))
+                    return false;
+                
+                for(uint64_t i = 0; i < count && !stop; i++){
+                    if(!macho_emit_fixup(macho, &fixup, segment, offset, visitor, ctx, &stop))
+                        return false;
+                    
+                    offset += skip + pointer_size;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+    
+    return true;
+}
+
+bool macho_walk_bind_opcodes(macho_file *macho, uint8_t kind, const uint8_t *opcodes, size_t size, macho_fixup_visitor visitor, void *ctx){
+    const uint8_t *p = opcodes;
+    const uint8_t *end = opcodes + size;
+    uint64_t pointer_size = macho->is64bit ? 8 : 4;
+    uint32_t segment = 0;
+    uint64_t offset = 0;
+    uint64_t value, count, skip;
+    bool stop = false;
+    macho_fixup fixup = { .kind = kind, .type = BIND_TYPE_POINTER };
+    
+    while(p < end && !stop){
+        // the stream came from one macho_get_range, the window follows it opcode by opcode
+        macho_window_use(macho, p, 1);
+        
+        uint8_t immediate = *p & BIND_IMMEDIATE_MASK;
+        uint8_t opcode = *p & BIND_OPCODE_MASK;
+        p++;
+        
+        switch(opcode){
+            case BIND_OPCODE_DONE:
+                // the lazy stream is a run of independent entries each ended by DONE
+                if(kind != MACHO_FIXUP_LAZY_BIND)
+                    return true;
+                break;
+            case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
+                fixup.ordinal = immediate;
+                break;
+            case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+                if(!macho_read_uleb128(&p, end, &value))
+                    return false;
+                
+                fixup.ordinal = (int32_t)value;
+                break;
+            case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
+                // the immediate is the low nibble of a small negative number
+                fixup.ordinal = immediate ? (int8_t)(BIND_OPCODE_MASK | immediate) : 0;
+                break;
+            case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
+                ;
+                const uint8_t *terminator = memchr(p, '\0', (size_t)(end - p));
+                
+                if(!terminator)
+                    return false;
+                
+                fixup.symbol = (const char*)p;
+                fixup.flags = immediate;
+                p = terminator + 1;
+                break;
+            case BIND_OPCODE_SET_TYPE_IMM:
+                fixup.type = immediate;
+                break;
+            case BIND_OPCODE_SET_ADDEND_SLEB:
+                if(!macho_read_sleb128(&p, end, &fixup.addend))
+                    return false;
+                break;
+            case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+                segment = immediate;
+                
+                if(!macho_read_uleb128(&p, end, &offset))
+                    return false;
+                break;
+            case BIND_OPCODE_ADD_ADDR_ULEB:
+                if(!macho_read_uleb128(&p, end, &skip) || !macho_advance_fixup(macho, segment, &offset, skip))
+                    return false;
+                break;
+            case BIND_OPCODE_DO_BIND:
+                if(!macho_emit_fixup(macho, &fixup, segment, offset, visitor, ctx, &stop))
+                    return false;
+                
+                offset += pointer_size;
+                break;
+            case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
+                if(!macho_read_uleb128(&p, end, &skip) || !macho_emit_fixup(macho, &fixup, segment, offset, visitor, ctx, &stop) ||
+                   !macho_advance_fixup(macho, segment, &offset, skip + pointer_size))
+                    return false;
+                break;
+            case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
+                if(!macho_emit_fixup(macho, &fixup, segment, offset, visitor, ctx, &stop))
+                    return false;
+                
+                offset += immediate * pointer_size + pointer_size;
+                break;
+            case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
+                if(!macho_read_uleb128(&p, end, &count) || !macho_read_uleb128(&p, end, &skip) ||
+                   !macho_fixup_run_fits(macho, segment, offset, count, skip, pointer_size))
+                    return false;
+                
+                for(uint64_t i = 0; i < count && !stop; i++){
+                    if(!macho_emit_fixup(macho, &fixup, segment, offset, visitor, ctx, &stop))
+                        return false;
+                    
+                    offset += skip + pointer_size;
+                }
+                break;
+            default:
+                // BIND_OPCODE_THREADED binds are resolved through the pointer chains in __DATA, not handled here
+                return false;
+        }
+    }
+    
+    return true;
+}
+
+// the opcodes of one stream, NULL if it's empty or runs off the end of the file
+static const uint8_t* macho_dyld_info_stream(macho_file *macho, uint32_t offset, uint32_t size){
+    uint64_t start = macho->fileoff_base + offset;
+    
+    return size ? (const uint8_t*)macho_get_range(macho, start, size) : NULL;
+}
+
+bool macho_walk_dyld_info(macho_file *macho, const struct dyld_info_command *info, uint32_t kinds, macho_fixup_visitor visitor, void *ctx){
+    const struct{
+        uint8_t kind;
+        uint32_t offset;
+        uint32_t size;
+    } streams[] = {
+        {MACHO_FIXUP_REBASE,    info->rebase_off,    info->rebase_size},
+        {MACHO_FIXUP_BIND,      info->bind_off,      info->bind_size},
+        {MACHO_FIXUP_WEAK_BIND, info->weak_bind_off, info->weak_bind_size},
+        {MACHO_FIXUP_LAZY_BIND, info->lazy_bind_off, info->lazy_bind_size}
+    };
+    bool valid = true;
+    
+    for(size_t i = 0; i < sizeof(streams) / sizeof(streams[0]); i++){
+        if(!(kinds & streams[i].kind))
+            continue;
+        
+        const uint8_t *opcodes = macho_dyld_info_stream(macho, streams[i].offset, streams[i].size);
+        
+        if(!opcodes){
+            valid &= streams[i].size == 0;
+            continue;
+        }
+        
+        if(streams[i].kind == MACHO_FIXUP_REBASE)
+            valid &= macho_walk_rebase_opcodes(macho, opcodes, streams[i].size, visitor, ctx);
+        else
+            valid &= macho_walk_bind_opcodes(macho, streams[i].kind, opcodes, streams[i].size, visitor, ctx);
+    }
+    
+    return valid;
+}
+
+typedef struct{
+    macho_arena *arena;
+    macho_fixup_table *table;
+    bool failed;
+} macho_fixup_table_builder;
+
+static bool macho_fixup_table_append(void *ctx, const macho_fixup *fixup){
+    macho_fixup_table_builder *builder = ctx;
+    macho_fixup_table *table = builder->table;
+    
+    if(table->count == table->capacity){
+        size_t capacity = table->capacity ? table->capacity * 2 : 64;
+        macho_fixup *grown = macho_arena_realloc(builder->arena, table->fixups,
+                                                 table->capacity * sizeof(macho_fixup),
+                                                 capacity * sizeof(macho_fixup));
+        
+        if(!grown){
+            builder->failed = true;
+            return false;
+        }
+        
+        table->fixups = grown;
+        table->capacity = capacity;
+    }
+    
+    table->fixups[table->count++] = *fixup;
+    
+    return true;
+}
+
+bool macho_fixup_table_build(macho_file *macho, const struct dyld_info_command *info, uint32_t kinds, macho_fixup_table *table){
+    memset(table, 0, sizeof(macho_fixup_table));
+    
+    // most fixups take a byte or two of opcodes, so the stream sizes are a good first guess
+    size_t guess = 0;
+    
+    if(kinds & MACHO_FIXUP_REBASE)
+        guess += info->rebase_size;
+    if(kinds & MACHO_FIXUP_BIND)
+        guess += info->bind_size / 2;
+    if(kinds & MACHO_FIXUP_WEAK_BIND)
+        guess += info->weak_bind_size / 2;
+    if(kinds & MACHO_FIXUP_LAZY_BIND)
+        guess += info->lazy_bind_size / 8;
+    
+    if(guess){
+        table->fixups = macho_arena_alloc(&macho->arena, guess * sizeof(macho_fixup));
+        table->capacity = table->fixups ? guess : 0;
+    }
+    
+    macho_fixup_table_builder builder = { .arena = &macho->arena, .table = table, .failed = false };
+    bool valid = macho_walk_dyld_info(macho, info, kinds, macho_fixup_table_append, &builder);
+    
+    return valid && !builder.failed;
+}
+
+const char* macho_fixup_kind_name(uint8_t kind){
+    switch(kind){
+        case MACHO_FIXUP_REBASE:
+            return "rebase";
+        case MACHO_FIXUP_BIND:
+            return "bind";
+        case MACHO_FIXUP_WEAK_BIND:
+            return "weak bind";
+        case MACHO_FIXUP_LAZY_BIND:
+            return "lazy bind";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef __dyld_info_h
+#define __dyld_info_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <mach-o/loader.h>
+#include "parser.h"
+
+/*
+ * LC_DYLD_INFO describes the fixups of an image as four opcode streams (rebase, bind, weak bind, lazy bind)
+ * each stream is interpreted in a single pass and every fixup it produces is handed to a visitor as it's decoded
+ * nothing is allocated while walking, symbol names point straight into the image
+ */
+
+enum{
+    MACHO_FIXUP_REBASE    = 1 << 0,
+    MACHO_FIXUP_BIND      = 1 << 1,
+    MACHO_FIXUP_WEAK_BIND = 1 << 2,
+    MACHO_FIXUP_LAZY_BIND = 1 << 3,
+    MACHO_FIXUP_ALL       = 0xf
+};
+
+typedef struct{
+    uint64_t address;   // virtual address of the pointer being fixed up
+    int64_t addend;
+    const char *symbol; // NULL for rebases, otherwise inside the mapped image
+    int32_t ordinal;    // dylib ordinal of a bind, 0 is the image itself and negative values are BIND_SPECIAL_DYLIB_
+    uint8_t kind;       // one MACHO_FIXUP_ flag
+    uint8_t type;       // REBASE_TYPE_ / BIND_TYPE_
+    uint8_t flags;      // BIND_SYMBOL_FLAGS_
+    uint8_t segment;    // index into macho->segments
+} macho_fixup;
+
+// called for every fixup in stream order, returning false stops the walk
+typedef bool (*macho_fixup_visitor)(void *ctx, const macho_fixup *fixup);
+
+// walks one opcode stream of the current image, false if it's malformed or uses opcodes this doesn't understand
+bool macho_walk_rebase_opcodes(macho_file *macho, const uint8_t *opcodes, size_t size, macho_fixup_visitor visitor, void *ctx);
+bool macho_walk_bind_opcodes(macho_file *macho, uint8_t kind, const uint8_t *opcodes, size_t size, macho_fixup_visitor visitor, void *ctx);
+
+// walks the streams of info (already in host order) selected by kinds, in rebase, bind, weak, lazy order
+bool macho_walk_dyld_info(macho_file *macho, const struct dyld_info_command *info, uint32_t kinds, macho_fixup_visitor visitor, void *ctx);
+
+// every fixup of an image in one flat array, grown geometrically so there is no allocation per fixup
+typedef struct{
+    macho_fixup *fixups;
+    size_t count;
+    size_t capacity;
+} macho_fixup_table;
+
+// the table comes from the image's arena and goes away when the image is released
+bool macho_fixup_table_build(macho_file *macho, const struct dyld_info_command *info, uint32_t kinds, macho_fixup_table *table);
+
+const char* macho_fixup_kind_name(uint8_t kind);
+
+#endif
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "export_trie.h"
+#include "leb128.h"
+
+// no real trie is anywhere near this deep, it only stops cycles in a corrupt one
+#define MACHO_EXPORT_TRIE_MAX_DEPTH 512
+
+// decodes the terminal info of a node that spans [p, end), false if it's malformed
+static bool macho_export_trie_terminal(const macho_export_trie *trie, const uint8_t *p, const uint8_t *end, macho_export *export){
+    uint64_t offset;
+    
+    memset(export, 0, sizeof(macho_export));
+    
+    if(!macho_read_uleb128(&p, end, &export->flags))
+        return false;
+    
+    if(export->flags & EXPORT_SYMBOL_FLAGS_REEXPORT){
+        if(!macho_read_uleb128(&p, end, &export->other))
+            return false;
+        
+        const uint8_t *terminator = memchr(p, '\0', (size_t)(end - p));
+        
+        if(!terminator)
+            return false;
+        
+        export->import_name = terminator != p ? (const char*)p : NULL;
+        
+        return true;
+    }
+    
+    if(!macho_read_uleb128(&p, end, &offset))
+        return false;
+    
+    bool absolute = (export->flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE;
+    export->address = absolute ? offset : trie->base + offset;
+    
+    if(export->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER){
+        if(!macho_read_uleb128(&p, end, &offset))
+            return false;
+        
+        export->other = trie->base + offset;
+    }
+    
+    return true;
+}
+
+bool macho_export_trie_lookup(const macho_export_trie *trie, const char *name, macho_export *export){
+    const uint8_t *end = trie->data + trie->size;
+    uint64_t node = 0;
+    
+    for(uint32_t depth = 0; trie->size && depth < MACHO_EXPORT_TRIE_MAX_DEPTH; depth++){
+        const uint8_t *p = trie->data + node;
+        uint64_t terminal_size;
+        
+        if(trie->macho)
+            macho_window_use(trie->macho, p, 1);
+        
+        if(!macho_read_uleb128(&p, end, &terminal_size) || terminal_size > (uint64_t)(end - p))
+            return false;
+        
+        if(!*name)
+            return terminal_size && macho_export_trie_terminal(trie, p, p + terminal_size, export);
+        
+        p += terminal_size;
+        
+        if(p >= end)
+            return false;
+        
+        uint8_t children = *p++;
+        bool followed = false;
+        
+        // edges out of a node never share a first character, so at most one of them can match
+        for(uint8_t i = 0; i < children && !followed; i++){
+            size_t matched = 0;
+            
+            while(p < end && *p && name[matched] == (char)*p){
+                matched++;
+                p++;
+            }
+            
+            bool whole_edge = p < end && *p == '\0';
+            
+            // skip the rest of a mismatching edge
+            while(p < end && *p)
+                p++;
+            
+            if(p++ >= end || !macho_read_uleb128(&p, end, &node))
+                return false;
+            
+            if(whole_edge && matched){
+                name += matched;
+                followed = true;
+            }
+        }
+        
+        if(!followed || node >= trie->size)
+            return false;
+    }
+    
+    return false;
+}
+
+typedef struct{
+    const macho_export_trie *trie;
+    macho_export_visitor visitor;
+    void *ctx;
+    char *name;
+    size_t capacity;
+    bool stop;
+} macho_export_walker;
+
+static bool macho_export_trie_walk_node(macho_export_walker *walker, uint64_t node, size_t length, uint32_t depth){
+    const macho_export_trie *trie = walker->trie;
+    const uint8_t *end = trie->data + trie->size;
+    uint64_t terminal_size;
+    
+    if(node >= trie->size || depth >= MACHO_EXPORT_TRIE_MAX_DEPTH)
+        return false;
+    
+    const uint8_t *p = trie->data + node;
+    
+    if(trie->macho)
+        macho_window_use(trie->macho, p, 1);
+    
+    if(!macho_read_uleb128(&p, end, &terminal_size) || terminal_size > (uint64_t)(end - p))
+        return false;
+    
+    if(terminal_size){
+        macho_export export;
+        
+        if(!macho_export_trie_terminal(trie, p, p + terminal_size, &export))
+            return false;
+        
+        walker->name[length] = '\0';
+        
+        if(!walker->visitor(walker->ctx, walker->name, &export)){
+            walker->stop = true;
+            return true;
+        }
+    }
+    
+    p += terminal_size;
+    
+    if(p >= end)
+        return false;
+    
+    uint8_t children = *p++;
+    
+    for(uint8_t i = 0; i < children && !walker->stop; i++){
+        const uint8_t *terminator = memchr(p, '\0', (size_t)(end - p));
+        uint64_t child;
+        
+        if(!terminator)
+            return false;
+        
+        size_t edge_length = (size_t)(terminator - p);
+        
+        // the buffer holds the name down to this node, it only grows for unusually long names
+        if(length + edge_length + 1 > walker->capacity){
+            size_t capacity = (length + edge_length + 1) * 2;
+            char *grown = realloc(walker->name, capacity);
+            
+            if(!grown)
+                return false;
+            
+            walker->name = grown;
+            walker->capacity = capacity;
+        }
+        
+        memcpy(walker->name + length, p, edge_length);
+        p = terminator + 1;
+        
+        if(!macho_read_uleb128(&p, end, &child) || !macho_export_trie_walk_node(walker, child, length + edge_length, depth + 1))
+            return false;
+    }
+    
+    return true;
+}
+
+bool macho_export_trie_walk(const macho_export_trie *trie, macho_export_visitor visitor, void *ctx){
+    macho_export_walker walker = { .trie = trie, .visitor = visitor, .ctx = ctx, .capacity = 256, .stop = false };
+    
+    if(!trie->size)
+        return true;
+    
+    walker.name = malloc(walker.capacity);
+    
+    if(!walker.name)
+        return false;
+    
+    bool valid = macho_export_trie_walk_node(&walker, 0, 0, 0);
+    
+    free(walker.name);
+    
+    return valid;
+}
@@ -0,0 +1,40 @@
+#ifndef __export_trie_h
+#define __export_trie_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <mach-o/loader.h>
+#include "parser.h"
+
+/*
+ * the export trie of an image (LC_DYLD_INFO export_off or LC_DYLD_EXPORTS_TRIE) read in place
+ * a lookup follows one edge per matching prefix of the name, so it costs O(length of the name) no matter
+ * how many symbols the image exports, and nothing is copied out of the mapped file
+ */
+
+typedef struct{
+    const uint8_t *data;
+    size_t size;
+    uint64_t base; // address of the mach header, export offsets are relative to it
+    macho_file *macho; // image the trie was read from, walks keep its window on the node they're at
+} macho_export_trie;
+
+typedef struct{
+    uint64_t address;        // resolved address, the stub for a resolver, 0 for a re-export
+    uint64_t flags;          // EXPORT_SYMBOL_FLAGS_
+    uint64_t other;          // resolver address, or the dylib ordinal of a re-export
+    const char *import_name; // name in that dylib for a re-export, NULL when it's the same name
+} macho_export;
+
+// whether name is exported, filling in *export when it is
+bool macho_export_trie_lookup(const macho_export_trie *trie, const char *name, macho_export *export);
+
+// called for every export in trie order, name is only valid during the call, returning false stops the walk
+typedef bool (*macho_export_visitor)(void *ctx, const char *name, const macho_export *export);
+
+// walks every export depth first, building each name in one reused buffer instead of materializing them all
+// false if the trie is malformed
+bool macho_export_trie_walk(const macho_export_trie *trie, macho_export_visitor visitor, void *ctx);
+
+#endif
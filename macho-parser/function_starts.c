@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "function_starts.h"
+#include "leb128.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MACHO_FUNCTION_STARTS_SSE2 1
+#endif
+
+uint32_t macho_decode_function_starts_scalar(const uint8_t *data, size_t size, uint64_t base, uint64_t *starts, uint32_t max){
+    const uint8_t *p = data;
+    const uint8_t *end = data + size;
+    uint64_t address = base;
+    uint32_t count = 0;
+    
+    while(p < end && count < max){
+        uint64_t delta;
+        
+        if(!macho_read_uleb128(&p, end, &delta) || delta == 0)
+            break;
+        
+        address += delta;
+        starts[count++] = address;
+    }
+    
+    return count;
+}
+
+#ifdef MACHO_FUNCTION_STARTS_SSE2
+
+// keeps the low length bytes of a little endian word
+static const uint64_t macho_uleb_masks[9] = {
+    0, 0xff, 0xffff, 0xffffff, 0xffffffff, 0xffffffffffULL, 0xffffffffffffULL, 0xffffffffffffffULL, 0xffffffffffffffffULL
+};
+
+// packs the 7 bit groups of a varint of up to 8 bytes without a loop or a branch per byte
+static inline uint64_t macho_uleb_pack(uint64_t word){
+    return  (word        & 0x000000000000007fULL) |
+           ((word >> 1)  & 0x0000000000003f80ULL) |
+           ((word >> 2)  & 0x00000000001fc000ULL) |
+           ((word >> 3)  & 0x000000000fe00000ULL) |
+           ((word >> 4)  & 0x00000007f0000000ULL) |
+           ((word >> 5)  & 0x000003f800000000ULL) |
+           ((word >> 6)  & 0x0001fc0000000000ULL) |
+           ((word >> 7)  & 0x00fe000000000000ULL);
+}
+
+/*
+ * works on 16 byte blocks: one movemask gives the continuation bit of every byte, so the ends of all
+ * varints in the block are known without looking at the bytes one by one
+ * each varint is then pulled out with one unaligned 8 byte load, masked to its length and packed,
+ * which keeps the mix of 1, 2 and 3 byte deltas free of data dependent branches
+ * a block with no continuation bits at all (16 one byte deltas) is just a running sum
+ */
+static uint32_t macho_decode_function_starts_sse2(const uint8_t *data, size_t size, uint64_t base, uint64_t *starts, uint32_t max){
+    uint64_t address = base;
+    uint32_t count = 0;
+    size_t i = 0;
+    
+    // the 8 byte loads may reach 8 bytes past the block
+    while(i + 16 + 8 <= size && count + 16 <= max){
+        __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+        uint32_t continued = (uint32_t)_mm_movemask_epi8(block);
+        uint32_t zero = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_setzero_si128()));
+        
+        if(continued == 0 && zero == 0){
+            for(uint32_t k = 0; k < 16; k++){
+                address += data[i + k];
+                starts[count + k] = address;
+            }
+            
+            count += 16;
+            i += 16;
+            continue;
+        }
+        
+        // every clear continuation bit ends a varint, consume the ones that end inside this block
+        uint32_t ends = ~continued & 0xffff;
+        uint32_t begin = 0;
+        
+        if(!ends)
+            break; // a varint longer than the block, the scalar loop below handles it
+        
+        while(ends){
+            uint32_t end = (uint32_t)__builtin_ctz(ends);
+            uint32_t length = end - begin + 1;
+            uint64_t delta;
+            
+            if(length > 8)
+                break;
+            
+            memcpy(&delta, data + i + begin, sizeof(uint64_t));
+            delta = macho_uleb_pack(delta & macho_uleb_masks[length]);
+            
+            // a zero delta terminates the list
+            if(delta == 0)
+                return count;
+            
+            address += delta;
+            starts[count++] = address;
+            
+            begin = end + 1;
+            ends &= ends - 1;
+        }
+        
+        if(begin == 0)
+            break;
+        
+        i += begin;
+    }
+    
+    // the tail and anything the block loop couldn't take
+    return count + macho_decode_function_starts_scalar(data + i, size - i, address, starts + count, max - count);
+}
+
+#endif
+
+uint32_t macho_decode_function_starts(const uint8_t *data, size_t size, uint64_t base, uint64_t *starts, uint32_t max){
+#ifdef MACHO_FUNCTION_STARTS_SSE2
+    return macho_decode_function_starts_sse2(data, size, base, starts, max);
+#else
+    return macho_decode_function_starts_scalar(data, size, base, starts, max);
+#endif
+}
+
+uint64_t macho_function_start_before(const uint64_t *starts, uint32_t count, uint64_t address){
+    uint32_t lo = 0;
+    uint32_t hi = count;
+    
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        
+        if(starts[mid] <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    return lo ? starts[lo - 1] : 0;
+}
+
+const char* macho_function_starts_decoder_name(void){
+#ifdef MACHO_FUNCTION_STARTS_SSE2
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,22 @@
+#ifndef __function_starts_h
+#define __function_starts_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// LC_FUNCTION_STARTS is a list of ULEB128 deltas, the first from the start of __TEXT, ended by a 0
+// decodes it into absolute addresses in ascending order and returns how many there were
+// a list of size bytes never holds more than size starts, so that many entries always fit
+uint32_t macho_decode_function_starts(const uint8_t *data, size_t size, uint64_t base, uint64_t *starts, uint32_t max);
+
+// the portable byte at a time decoder the vectorized one falls back to, exposed for the benchmark
+uint32_t macho_decode_function_starts_scalar(const uint8_t *data, size_t size, uint64_t base, uint64_t *starts, uint32_t max);
+
+// the highest start at or below address, 0 if address comes before every function
+uint64_t macho_function_start_before(const uint64_t *starts, uint32_t count, uint64_t address);
+
+// which decoder macho_decode_function_starts uses on this build
+const char* macho_function_starts_decoder_name(void);
+
+#endif
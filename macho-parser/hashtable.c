@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hashtable.h"
+
+#define MACHO_HASH_MIN_CAPACITY 16
+
+// FNV-1a, short symbol names don't need anything stronger
+uint64_t macho_hash_string(const char *key){
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    
+    for(const unsigned char *s = (const unsigned char*)key; *s; s++){
+        hash ^= *s;
+        hash *= 0x100000001b3ULL;
+    }
+    
+    return hash;
+}
+
+static bool macho_hash_resize(macho_hash_table *table, uint32_t capacity){
+    macho_hash_entry *entries = calloc(capacity, sizeof(macho_hash_entry));
+    
+    if(!entries)
+        return false;
+    
+    for(uint32_t i = 0; i < table->capacity; i++){
+        macho_hash_entry *entry = &table->entries[i];
+        
+        if(!entry->key)
+            continue;
+        
+        uint32_t slot = (uint32_t)entry->hash & (capacity - 1);
+        
+        while(entries[slot].key)
+            slot = (slot + 1) & (capacity - 1);
+        
+        entries[slot] = *entry;
+    }
+    
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+    
+    return true;
+}
+
+void macho_hash_init(macho_hash_table *table, uint32_t expected){
+    table->entries = NULL;
+    table->capacity = 0;
+    table->count = 0;
+    
+    if(expected){
+        uint32_t capacity = MACHO_HASH_MIN_CAPACITY;
+        
+        // keep the load factor under one half so probe sequences stay short
+        while(capacity < expected * 2)
+            capacity <<= 1;
+        
+        macho_hash_resize(table, capacity);
+    }
+}
+
+void macho_hash_free(macho_hash_table *table){
+    free(table->entries);
+    table->entries = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+macho_hash_entry* macho_hash_lookup(const macho_hash_table *table, const char *key){
+    if(!table->count)
+        return NULL;
+    
+    uint64_t hash = macho_hash_string(key);
+    uint32_t slot = (uint32_t)hash & (table->capacity - 1);
+    
+    while(table->entries[slot].key){
+        macho_hash_entry *entry = &table->entries[slot];
+        
+        if(entry->hash == hash && strcmp(entry->key, key) == 0)
+            return entry;
+        
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    
+    return NULL;
+}
+
+macho_hash_entry* macho_hash_insert(macho_hash_table *table, const char *key, void *value){
+    macho_hash_entry *entry = macho_hash_lookup(table, key);
+    
+    if(entry)
+        return entry;
+    
+    if((table->count + 1) * 2 > table->capacity &&
+       !macho_hash_resize(table, table->capacity ? table->capacity * 2 : MACHO_HASH_MIN_CAPACITY))
+        return NULL;
+    
+    uint64_t hash = macho_hash_string(key);
+    uint32_t slot = (uint32_t)hash & (table->capacity - 1);
+    
+    while(table->entries[slot].key)
+        slot = (slot + 1) & (table->capacity - 1);
+    
+    entry = &table->entries[slot];
+    entry->key = key;
+    entry->hash = hash;
+    entry->value = value;
+    
+    table->count++;
+    
+    return entry;
+}
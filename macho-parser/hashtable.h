@@ -0,0 +1,33 @@
+#ifndef __hashtable_h
+#define __hashtable_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// open addressed string -> pointer map, keys aren't copied so they have to outlive the table
+
+typedef struct{
+    const char *key;
+    uint64_t hash;
+    void *value;
+} macho_hash_entry;
+
+typedef struct{
+    macho_hash_entry *entries;
+    uint32_t capacity; // always a power of two, 0 until the first insert
+    uint32_t count;
+} macho_hash_table;
+
+uint64_t macho_hash_string(const char *key);
+
+void macho_hash_init(macho_hash_table *table, uint32_t expected);
+void macho_hash_free(macho_hash_table *table);
+
+// returns the entry for key, inserting it with value if it wasn't there yet
+macho_hash_entry* macho_hash_insert(macho_hash_table *table, const char *key, void *value);
+
+// NULL when key isn't in the table
+macho_hash_entry* macho_hash_lookup(const macho_hash_table *table, const char *key);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef __leb128_h
+#define __leb128_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// bounds checked LEB128 readers shared by the linkedit decoders, they advance *p past the value
+// and return false if it runs into end
+
+static inline bool macho_read_uleb128(const uint8_t **p, const uint8_t *end, uint64_t *value){
+    uint64_t result = 0;
+    uint32_t shift = 0;
+    uint8_t byte;
+    
+    do{
+        if(*p >= end)
+            return false;
+        
+        byte = *(*p)++;
+        
+        if(shift < 64)
+            result |= (uint64_t)(byte & 0x7f) << shift;
+        
+        shift += 7;
+    } while(byte & 0x80);
+    
+    *value = result;
+    
+    return true;
+}
+
+static inline bool macho_read_sleb128(const uint8_t **p, const uint8_t *end, int64_t *value){
+    uint64_t result = 0;
+    uint32_t shift = 0;
+    uint8_t byte;
+    
+    do{
+        if(*p >= end)
+            return false;
+        
+        byte = *(*p)++;
+        
+        if(shift < 64)
+            result |= (uint64_t)(byte & 0x7f) << shift;
+        
+        shift += 7;
+    } while(byte & 0x80);
+    
+    // sign extend from the last group
+    if(shift < 64 && (byte & 0x40))
+        result |= ~(uint64_t)0 << shift;
+    
+    *value = (int64_t)result;
+    
+    return true;
+}
+
+#endif
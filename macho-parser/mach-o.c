@@ -3,32 +3,39 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <string.h>
 #include <assert.h>
-#include <CommonCrypto/CommonDigest.h>
+#include <time.h>
 #include "mach-o.h"
 #include "objc.h"
+#include "thread_pool.h"
+#include "sha.h"
+#include "symindex.h"
+#include "cache.h"
+#include "function_starts.h"
+#include "dyld_info.h"
+#include "export_trie.h"
+#include "chained_fixups.h"
+#include "shared_cache.h"
 
 #include <capstone/capstone.h>
 
-/* todo list, don't manually load each byte needed onto the heap, just use universal buffer */
-
-macho_file *gmacho_file = NULL;
+#define min(a,b) \
+    ({ __typeof__ (a) _a = (a); \
+    __typeof__ (b) _b = (b); \
+    _a < _b ? _a : _b; })
 
 typedef struct fat_arch fat_arch_t;
 typedef struct fat_header fat_header_t;
 typedef struct mach_header mach_header_t;
 
-macho_file* get_macho()
-{
-    return gmacho_file;
-}
-
-uint32_t macho_get_magic(uint32_t offset){
-    FILE *mach = gmacho_file->file;
+uint32_t macho_get_magic(macho_file *macho, uint64_t offset){
+    if((uint64_t)offset + sizeof(uint32_t) > macho->size)
+        return 0;
+    
     uint32_t magic;
-    fseek(mach, offset, SEEK_SET);
-    fread(&magic, sizeof(uint32_t), 1, mach);
+    macho_read(macho, offset, &magic, sizeof(uint32_t));
     return magic;
 }
 
@@ -52,88 +59,562 @@ bool macho_swapped(uint32_t magic){
     return magic == MH_CIGAM || magic == MH_CIGAM_64 || magic == FAT_CIGAM;
 }
 
-fat_arch_t macho_get_fat_arch(uint32_t offset){
-    FILE *mach = gmacho_file->file;
+fat_arch_t macho_get_fat_arch(macho_file *macho, uint64_t offset){
     fat_arch_t arch;
-    fseek(mach, offset, SEEK_SET);
-    fread(&arch, sizeof(fat_arch_t), 1, mach);
+    memset(&arch, 0, sizeof(fat_arch_t));
+    
+    if((uint64_t)offset + sizeof(fat_arch_t) <= macho->size)
+        macho_read(macho, offset, &arch, sizeof(fat_arch_t));
+    
     return arch;
 }
 
-fat_header_t macho_get_fat_header(uint32_t offset){
-    FILE *mach = gmacho_file->file;
+fat_header_t macho_get_fat_header(macho_file *macho, uint64_t offset){
     fat_header_t header;
-    fseek(mach, offset, SEEK_SET);
-    fread(&header, sizeof(fat_header_t), 1, mach);
+    memset(&header, 0, sizeof(fat_header_t));
+    
+    if((uint64_t)offset + sizeof(fat_header_t) <= macho->size)
+        macho_read(macho, offset, &header, sizeof(fat_header_t));
+    
     return header;
 }
 
-mach_header_t macho_get_header(uint32_t offset){
-    FILE *mach = gmacho_file->file;
+mach_header_t macho_get_header(macho_file *macho, uint64_t offset){
     mach_header_t header;
-    fseek(mach, offset, SEEK_SET);
-    fread(&header, sizeof(mach_header_t), 1, mach);
+    memset(&header, 0, sizeof(mach_header_t));
+    
+    if((uint64_t)offset + sizeof(mach_header_t) <= macho->size)
+        macho_read(macho, offset, &header, sizeof(mach_header_t));
+    
     return header;
 }
 
-void macho_disassemble_code(mach_vm_address_t offset)
-{
+// a function with nothing around it to bound it (stripped, no LC_FUNCTION_STARTS) is decoded this far
+#define MACHO_UNBOUNDED_FUNCTION_SIZE 0x100
+
+// per image disassembly state, set up on the first disassembly and reused for every function after it
+typedef struct{
     csh handle;
+    cs_arch arch;
+    cs_mode mode;
     cs_insn *insn;
-    size_t count;
-    const uint8_t *code_buffer;
+    macho_symbol_index symbols;
+    const uint64_t *function_starts;
+    uint32_t num_function_starts;
+} macho_disassembler;
+
+bool macho_load_segments(macho_file *macho, uint64_t headeroff){
+    uint32_t magic = macho_get_magic(macho, headeroff);
+    bool swap = macho_swapped(magic);
+    
+    macho_release_image(macho);
+    macho->headeroff = headeroff;
+    macho->fileoff_base = macho->shared_cache ? 0 : headeroff;
+    
+    if(!macho_valid(magic) || macho_fat(magic))
+        return false;
+    
+    mach_header_t header = macho_get_header(macho, headeroff);
+    swap(mach_header,&header,swap);
+    
+    macho_load_command_index index;
+    uint32_t size_header = macho_64bit(magic) ? sizeof(struct mach_header_64) : sizeof(struct mach_header);
+    
+    if(!macho_load_command_index_build(macho, &index, swap, headeroff + size_header, header.ncmds))
+        return false;
+    
+    macho_segment *segments = macho_arena_calloc(&macho->arena, index.count ? index.count : 1, sizeof(macho_segment));
+    uint32_t count = 0;
+    
+    for(uint32_t i = 0; segments && i < index.count; i++){
+        macho_load_command_entry *entry = &index.commands[i];
+        macho_segment *segment = &segments[count];
+        
+        if(entry->cmd == LC_SEGMENT_64 && entry->size >= sizeof(struct segment_command_64)){
+            struct segment_command_64 segment_command;
+            macho_read(macho, entry->offset, &segment_command, sizeof(struct segment_command_64));
+            swap(segment_command_64,&segment_command,swap);
+            
+            memcpy(segment->segname, segment_command.segname, sizeof(segment->segname));
+            segment->vmaddr = segment_command.vmaddr;
+            segment->vmsize = segment_command.vmsize;
+            segment->fileoff = segment_command.fileoff;
+            segment->filesize = segment_command.filesize;
+            count++;
+        } else if(entry->cmd == LC_SEGMENT && entry->size >= sizeof(struct segment_command)){
+            struct segment_command segment_command;
+            macho_read(macho, entry->offset, &segment_command, sizeof(struct segment_command));
+            swap(segment_command,&segment_command,swap);
+            
+            memcpy(segment->segname, segment_command.segname, sizeof(segment->segname));
+            segment->vmaddr = segment_command.vmaddr;
+            segment->vmsize = segment_command.vmsize;
+            segment->fileoff = segment_command.fileoff;
+            segment->filesize = segment_command.filesize;
+            count++;
+        }
+    }
+    
+    return segments && macho_segment_map_build(&macho->segment_map, &macho->arena, segments, count);
+}
+
+void macho_release_image(macho_file *macho){
+    macho_disassembler *disassembler = macho->disassembler;
+    
+    if(disassembler){
+        if(disassembler->insn)
+            cs_free(disassembler->insn, 1);
+        
+        if(disassembler->handle)
+            cs_close(&disassembler->handle);
+    }
+    
+    // capstone keeps its own allocations, everything else parsed out of the image is in the arena
+    macho_arena_reset(&macho->arena);
+    memset(&macho->segment_map, 0, sizeof(macho_segment_map));
+    macho->disassembler = NULL;
+    macho->chained_fixups = NULL;
+}
+
+const macho_segment* macho_find_segment(macho_file *macho, uint64_t address){
+    return macho_segment_map_find(&macho->segment_map, address);
+}
+
+const void* macho_address_bytes(macho_file *macho, uint64_t address, size_t size){
+    uint64_t offset;
+    
+    // inside a shared cache pointers lead into other images too, the cache mappings cover those
+    if(macho_segment_map_to_offset(&macho->segment_map, address, &offset))
+        offset += macho->fileoff_base;
+    else if(!macho->shared_cache || !macho_shared_cache_address_to_offset(macho->shared_cache, address, &offset))
+        return NULL;
+    
+    if(offset > macho->size || size > macho->size - offset)
+        return NULL;
+    
+    macho_window_use(macho, macho->buffer + offset, size);
+    
+    return (const uint8_t*)macho->buffer + offset;
+}
+
+bool macho_offset_to_address(macho_file *macho, uint64_t offset, uint64_t *address){
+    return offset >= macho->fileoff_base && macho_segment_map_to_address(&macho->segment_map, offset - macho->fileoff_base, address);
+}
+
+const macho_segment* macho_header_segment(macho_file *macho){
+    for(uint32_t i = 0; i < macho->segment_map.count; i++){
+        if(macho->fileoff_base + macho->segment_map.segments[i].fileoff == macho->headeroff && macho->segment_map.segments[i].filesize)
+            return &macho->segment_map.segments[i];
+    }
+    
+    return NULL;
+}
+
+uint32_t macho_load_function_starts(macho_file *macho, uint64_t **starts){
+    uint32_t magic = macho_get_magic(macho, macho->headeroff);
+    bool swap = macho_swapped(magic);
+    uint32_t count = 0;
+    
+    *starts = NULL;
+    
+    mach_header_t header = macho_get_header(macho, macho->headeroff);
+    swap(mach_header,&header,swap);
+    
+    macho_load_command_index index;
+    uint32_t size_header = macho_64bit(magic) ? sizeof(struct mach_header_64) : sizeof(struct mach_header);
+    
+    if(!macho_load_command_index_build(macho, &index, swap, macho->headeroff + size_header, header.ncmds))
+        return 0;
+    
+    const macho_load_command_entry *entry = macho_find_load_command(&index, LC_FUNCTION_STARTS, NULL);
+    
+    if(entry && entry->size >= sizeof(struct linkedit_data_command)){
+        struct linkedit_data_command linkedit;
+        macho_read(macho, entry->offset, &linkedit, sizeof(struct linkedit_data_command));
+        swap(linkedit_data_command,&linkedit,swap);
+        
+        uint64_t dataoff = macho->fileoff_base + linkedit.dataoff;
+        
+        // the deltas start at the segment that maps the header, __TEXT
+        const macho_segment *text = macho_header_segment(macho);
+        
+        if(text && linkedit.datasize && dataoff + linkedit.datasize <= macho->size){
+            *starts = macho_arena_alloc(&macho->arena, linkedit.datasize * sizeof(uint64_t));
+            
+            if(*starts)
+                count = macho_decode_function_starts(macho_get_bytes(macho, dataoff),
+                                                     linkedit.datasize,
+                                                     text->vmaddr,
+                                                     *starts,
+                                                     linkedit.datasize);
+            
+            // decoded in one go, a windowed mapping can let go of it right away
+            macho_window_drop(macho, dataoff, linkedit.datasize);
+        }
+    }
+    
+    return count;
+}
+
+// the LC_DYLD_CHAINED_FIXUPS payload of the current image, NULL if it has none
+static const uint8_t* macho_chained_fixups_data(macho_file *macho, const macho_load_command_index *index, bool swap, uint32_t *size){
+    const macho_load_command_entry *entry = macho_find_load_command(index, LC_DYLD_CHAINED_FIXUPS, NULL);
+    
+    if(!entry || entry->size < sizeof(struct linkedit_data_command))
+        return NULL;
+    
+    struct linkedit_data_command linkedit;
+    macho_read(macho, entry->offset, &linkedit, sizeof(struct linkedit_data_command));
+    swap(linkedit_data_command,&linkedit,swap);
+    
+    uint64_t dataoff = macho->fileoff_base + linkedit.dataoff;
+    
+    *size = linkedit.datasize;
+    
+    return linkedit.datasize ? (const uint8_t*)macho_get_range(macho, dataoff, linkedit.datasize) : NULL;
+}
+
+// every chain of the image is decoded the first time one of its pointers is read
+static macho_chained_fixups* macho_load_chained_fixups(macho_file *macho){
+    if(macho->chained_fixups)
+        return macho->chained_fixups;
+    
+    macho_chained_fixups *fixups = macho_arena_calloc(&macho->arena, 1, sizeof(macho_chained_fixups));
+    
+    if(!fixups)
+        return NULL;
+    
+    macho->chained_fixups = fixups;
+    
+    uint32_t magic = macho_get_magic(macho, macho->headeroff);
+    bool swap = macho_swapped(magic);
+    
+    // the chains are read in host order
+    if(swap)
+        return fixups;
+    
+    mach_header_t header = macho_get_header(macho, macho->headeroff);
+    macho_load_command_index index;
+    uint32_t size_header = macho_64bit(magic) ? sizeof(struct mach_header_64) : sizeof(struct mach_header);
+    uint32_t size;
+    
+    if(!macho_load_command_index_build(macho, &index, swap, macho->headeroff + size_header, header.ncmds))
+        return fixups;
+    
+    const uint8_t *data = macho_chained_fixups_data(macho, &index, swap, &size);
+    
+    if(data)
+        macho_chained_fixups_build(macho, data, size, fixups);
+    
+    return fixups;
+}
+
+uint64_t macho_resolve_pointer(macho_file *macho, uint64_t address, uint64_t raw){
+    if(macho->shared_cache)
+        return macho_shared_cache_resolve_pointer(macho->shared_cache, address, raw);
+    
+    macho_chained_fixups *fixups = macho_load_chained_fixups(macho);
+    
+    if(!fixups || !fixups->count)
+        return raw;
+    
+    const macho_chained_fixup *fixup = macho_chained_fixups_find(fixups, address);
+    
+    if(!fixup)
+        return raw;
+    
+    return fixup->import == MACHO_CHAINED_REBASE ? fixup->target : 0;
+}
+
+// trie of the current image at offset from its header, false if it's empty or out of bounds
+static bool macho_export_trie_at(macho_file *macho, uint32_t offset, uint32_t size, macho_export_trie *trie){
+    uint64_t start = macho->fileoff_base + offset;
+    const macho_segment *text = macho_header_segment(macho);
+    
+    memset(trie, 0, sizeof(macho_export_trie));
+    
+    trie->data = size ? macho_get_range(macho, start, size) : NULL;
+    
+    if(!trie->data)
+        return false;
+    
+    trie->size = size;
+    trie->base = text ? text->vmaddr : 0;
+    trie->macho = macho;
+    
+    return true;
+}
+
+bool macho_load_export_trie(macho_file *macho, macho_export_trie *trie){
+    uint32_t magic = macho_get_magic(macho, macho->headeroff);
+    bool swap = macho_swapped(magic);
+    bool found = false;
+    
+    memset(trie, 0, sizeof(macho_export_trie));
+    
+    mach_header_t header = macho_get_header(macho, macho->headeroff);
+    swap(mach_header,&header,swap);
+    
+    macho_load_command_index index;
+    uint32_t size_header = macho_64bit(magic) ? sizeof(struct mach_header_64) : sizeof(struct mach_header);
+    
+    if(!macho_load_command_index_build(macho, &index, swap, macho->headeroff + size_header, header.ncmds))
+        return false;
+    
+    const macho_load_command_entry *entry = macho_find_load_command(&index, LC_DYLD_EXPORTS_TRIE, NULL);
+    
+    if(entry && entry->size >= sizeof(struct linkedit_data_command)){
+        struct linkedit_data_command linkedit;
+        macho_read(macho, entry->offset, &linkedit, sizeof(struct linkedit_data_command));
+        swap(linkedit_data_command,&linkedit,swap);
+        
+        found = macho_export_trie_at(macho, linkedit.dataoff, linkedit.datasize, trie);
+    }
+    
+    // images from before chained fixups keep the trie in LC_DYLD_INFO
+    if(!entry){
+        entry = macho_find_load_command(&index, LC_DYLD_INFO_ONLY, NULL);
+        
+        if(!entry)
+            entry = macho_find_load_command(&index, LC_DYLD_INFO, NULL);
+        
+        if(entry && entry->size >= sizeof(struct dyld_info_command)){
+            struct dyld_info_command dyld_info;
+            macho_read(macho, entry->offset, &dyld_info, sizeof(struct dyld_info_command));
+            swap(dyld_info_command,&dyld_info,swap);
+            
+            found = macho_export_trie_at(macho, dyld_info.export_off, dyld_info.export_size, trie);
+        }
+    }
+    
+    return found;
+}
+
+// symbols and function starts of the image, only read when the first function gets disassembled
+static void macho_load_function_bounds(macho_file *macho, macho_disassembler *disassembler){
+    uint32_t magic = macho_get_magic(macho, macho->headeroff);
+    bool swap = macho_swapped(magic);
     
-    if(offset > gmacho_file->size)
-        offset -= 0x100000000;
+    // the symbol index reads the nlists in host order
+    if(swap)
+        return;
+    
+    mach_header_t header = macho_get_header(macho, macho->headeroff);
+    macho_load_command_index index;
+    uint32_t size_header = macho_64bit(magic) ? sizeof(struct mach_header_64) : sizeof(struct mach_header);
     
-    if(offset > gmacho_file->size)
+    if(!macho_load_command_index_build(macho, &index, swap, macho->headeroff + size_header, header.ncmds))
         return;
     
-    code_buffer = (const uint8_t*)(gmacho_file->buffer + offset);
+    const macho_load_command_entry *symtab = macho_find_load_command(&index, LC_SYMTAB, NULL);
     
-    if ( gmacho_file->x86 && gmacho_file->is64bit ){
-        if (cs_open(CS_ARCH_X86, CS_MODE_64, &handle) != CS_ERR_OK)
-            return;
+    if(symtab && symtab->size >= sizeof(struct symtab_command)){
+        struct symtab_command symtab_command;
+        macho_read(macho, symtab->offset, &symtab_command, sizeof(struct symtab_command));
+        
+        macho_symbol_index_build(macho, &disassembler->symbols, macho->headeroff,
+                                 symtab_command.symoff,
+                                 symtab_command.nsyms,
+                                 symtab_command.stroff,
+                                 symtab_command.strsize);
     }
-    else if ( gmacho_file->arm && gmacho_file->is64bit){
-        if (cs_open(CS_ARCH_ARM64, CS_MODE_ARM, &handle) != CS_ERR_OK)
-            return;
-    } else
+    
+    uint64_t *function_starts;
+    
+    disassembler->num_function_starts = macho_load_function_starts(macho, &function_starts);
+    disassembler->function_starts = function_starts;
+    
+    // symbols run up to the next function start, not just the next symbol
+    macho_symbol_index_bound(&disassembler->symbols, function_starts, disassembler->num_function_starts);
+}
+
+static macho_disassembler* macho_new_disassembler(macho_file *macho){
+    macho_disassembler *disassembler = macho_arena_calloc(&macho->arena, 1, sizeof(macho_disassembler));
+    
+    macho->disassembler = disassembler;
+    
+    return disassembler;
+}
+
+void macho_set_function_bounds(macho_file *macho, const macho_symbol_index *symbols, const uint64_t *starts, uint32_t count){
+    macho_disassembler *disassembler = macho->disassembler ? macho->disassembler : macho_new_disassembler(macho);
+    
+    if(!disassembler)
         return;
-    // we only care about 64 bit binaries that either are arm or x86
-    // capstone does the rest of the work by providing the inline disassembly
+    
+    disassembler->symbols = *symbols;
+    disassembler->function_starts = starts;
+    disassembler->num_function_starts = count;
+}
+
+static macho_disassembler* macho_get_disassembler(macho_file *macho, cs_arch arch, cs_mode mode){
+    macho_disassembler *disassembler = macho->disassembler;
+    
+    if(!disassembler){
+        disassembler = macho_new_disassembler(macho);
+        
+        if(!disassembler)
+            return NULL;
         
+        macho_load_function_bounds(macho, disassembler);
+    }
+    
+    if(disassembler->handle && disassembler->arch != arch){
+        cs_free(disassembler->insn, 1);
+        cs_close(&disassembler->handle);
+        disassembler->insn = NULL;
+        disassembler->handle = 0;
+    }
     
-    count = cs_disasm(handle, code_buffer, 0x100, 0x1000, 0, &insn);
-    if (count > 0) {
-        size_t j;
-        for (j = 0; j < count; j++) {
-            printf("\t\t\t\t\t0x%"PRIx64":\t%s\t\t%s\n", insn[j].address, insn[j].mnemonic,
-                   insn[j].op_str);
+    if(!disassembler->handle){
+        if(cs_open(arch, mode, &disassembler->handle) != CS_ERR_OK){
+            disassembler->handle = 0;
+            return NULL;
         }
         
-        cs_free(insn, count);
+        // instruction details aren't printed, don't pay for them
+        cs_option(disassembler->handle, CS_OPT_DETAIL, CS_OPT_OFF);
+        
+        disassembler->insn = cs_malloc(disassembler->handle);
+        disassembler->arch = arch;
+        disassembler->mode = mode;
+    } else if(disassembler->mode != mode){
+        // arm and thumb functions share one handle
+        cs_option(disassembler->handle, CS_OPT_MODE, mode);
+        disassembler->mode = mode;
+    }
+    
+    return disassembler->insn ? disassembler : NULL;
+}
+
+// where the function at address ends: the next symbol, the next function start or its symbol's section end
+static uint64_t macho_function_end(macho_disassembler *disassembler, uint64_t address){
+    uint64_t end = UINT64_MAX;
+    
+    const macho_symbol *symbol = macho_symbol_index_lookup(&disassembler->symbols, address);
+    
+    if(symbol && symbol->size)
+        end = symbol->address + symbol->size;
+    
+    const macho_symbol *next = macho_symbol_index_next(&disassembler->symbols, address);
+    
+    if(next && next->address < end)
+        end = next->address;
+    
+    // function starts are ascending, the first one above address bounds it
+    uint32_t lo = 0;
+    uint32_t hi = disassembler->num_function_starts;
+    
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        
+        if(disassembler->function_starts[mid] <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    if(lo < disassembler->num_function_starts && disassembler->function_starts[lo] < end)
+        end = disassembler->function_starts[lo];
+    
+    return end;
+}
+
+// disassembles and prints one function, returns how many instructions were decoded
+static size_t macho_disassemble_function(macho_file *macho, mach_vm_address_t address)
+{
+    cs_arch arch;
+    cs_mode mode;
+    
+    if ( macho->x86 ){
+        arch = CS_ARCH_X86;
+        mode = macho->is64bit ? CS_MODE_64 : CS_MODE_32;
+    } else if ( macho->arm && macho->is64bit ){
+        arch = CS_ARCH_ARM64;
+        mode = CS_MODE_ARM;
+    } else if ( macho->arm ){
+        // the low bit of a 32 bit arm symbol marks a thumb function
+        arch = CS_ARCH_ARM;
+        mode = (address & 1) ? CS_MODE_THUMB : CS_MODE_ARM;
+        address &= ~(mach_vm_address_t)1;
     } else
-        printf("ERROR: Failed to disassemble given code!\n");
+        return 0;
+    // capstone does the rest of the work by providing the inline disassembly
+    
+    const macho_segment *segment = macho_find_segment(macho, address);
+    
+    if(!segment || address - segment->vmaddr >= segment->filesize){
+        macho_print(macho, "ERROR: 0x%llx isn't backed by the file!\n", (unsigned long long)address);
+        return 0;
+    }
+    
+    macho_disassembler *disassembler = macho_get_disassembler(macho, arch, mode);
+    
+    if(!disassembler)
+        return 0;
     
-    cs_close(&handle);
+    uint64_t segment_end = segment->vmaddr + segment->filesize;
+    uint64_t end = macho_function_end(disassembler, address);
     
+    if(end == UINT64_MAX)
+        end = address + MACHO_UNBOUNDED_FUNCTION_SIZE;
+    
+    end = min(end, segment_end);
+    
+    uint64_t fileoff = macho->fileoff_base + segment->fileoff + (address - segment->vmaddr);
+    
+    if(fileoff >= macho->size)
+        return 0;
+    
+    const uint8_t *code = (const uint8_t*)macho->buffer + fileoff;
+    size_t code_size = (size_t)min(end - address, (uint64_t)(macho->size - fileoff));
+    uint64_t pc = address;
+    size_t count = 0;
+    
+    // decodes into one reused instruction instead of allocating an array per function
+    while(cs_disasm_iter(disassembler->handle, &code, &code_size, &pc, disassembler->insn)){
+        macho_print(macho, "\t\t\t\t\t0x%"PRIx64":\t%s\t\t%s\n", disassembler->insn->address, disassembler->insn->mnemonic,
+               disassembler->insn->op_str);
+        count++;
+    }
+    
+    if(!count)
+        macho_print(macho, "ERROR: Failed to disassemble given code!\n");
+    
+    return count;
 }
 
+void macho_disassemble_code(macho_file *macho, mach_vm_address_t address){
+    macho_phase phase = macho_stats_enter(macho->stats, MACHO_PHASE_DISASSEMBLY);
+    size_t count = macho_disassemble_function(macho, address);
+    
+    macho_count(macho, MACHO_COUNTER_INSTRUCTIONS, count);
+    macho_stats_leave(macho->stats, phase);
+}
 
 
-void macho_print_symtab(mach_header_t header,
-                        uint32_t headeroff,
+
+void macho_print_symtab(macho_file *macho, mach_header_t header,
+                        uint64_t base,
                         uint32_t symoff,
                         uint32_t nsyms,
                         uint32_t stroff,
                         uint32_t strsize){
+    uint64_t symbols = base + symoff;
+    uint64_t strings = base + stroff;
+    size_t nlist_size = macho_64bit(header.magic) ? sizeof(struct nlist_64) : sizeof(struct nlist);
+    
+    if(!macho_get_range(macho, symbols, (uint64_t)nsyms * nlist_size) || !macho_get_range(macho, strings, strsize)){
+        macho_print(macho, "\t\tSymbol table is outside the file\n");
+        return;
+    }
+    
+    macho_count(macho, MACHO_COUNTER_SYMBOLS, nsyms);
+    
+    // every entry and name goes through the accessors so a windowed mapping slides along the table
     if(macho_64bit(header.magic)){
-        struct nlist_64 *symtab = macho_get_bytes(symoff + headeroff);
-        
-        char *strtab = macho_get_bytes(stroff + headeroff);
         for(int i=0; i<nsyms; i++){
-            struct nlist_64* nl = &symtab[i];
+            struct nlist_64* nl = macho_get_bytes(macho, symbols + i * nlist_size);
             
             if(nl->n_type & N_STAB) {
                 continue;
@@ -141,7 +622,10 @@ void macho_print_symtab(mach_header_t header,
             
             bool found = false;
             const char* type = NULL;
-            const char* symname = &strtab[nl->n_un.n_strx];
+            const char* symname = nl->n_un.n_strx < strsize ? macho_read_string(macho, strings + nl->n_un.n_strx) : NULL;
+            
+            if(!symname)
+                symname = "";
             
             switch(nl->n_type & N_TYPE) {
                 case N_UNDF: type = "N_UNDF"; break;
@@ -150,41 +634,27 @@ void macho_print_symtab(mach_header_t header,
                     
                     // this symbol table is provided by the user to disassemble any symbols found
                     // find the symbol here
-                    if(gmacho_file->symboltable)
-                    {
-                        char **symbols = gmacho_file->symboltable->symbols;
-                        uint32_t num_symbols = gmacho_file->symboltable->num_symbols;
-                        
-                        for(int j=0; j<num_symbols; j++)
-                        {
-                            char *symbol = symbols[j];
-                            
-                            if(strcmp(symname,symbol) == 0)
-                            {
-                                found = true;
-                            }
-                        }
-                    }
+                    found = macho_symbol_requested(macho->symboltable, symname);
                     
                     break;
                 case N_PBUD: type = "N_PBUD"; break;
                 case N_INDR: type = "N_INDR"; break;
-                    
+                
                 default:
-                    printf("Invalid symbol type: 0x%x\n", nl->n_type & N_TYPE);
+                    macho_print(macho, "Invalid symbol type: 0x%x\n", nl->n_type & N_TYPE);
                     return;
             }
             
-            printf("\t\tSymbol \"%s\" type: %s value: 0x%llx\n", symname, type, nl->n_value);
+            macho_print(macho, "\t\tSymbol \"%s\" type: %s value: 0x%"PRIx64"\n", symname, type, nl->n_value);
+            
+            macho_emit(macho, symbol, .name = symname, .type = type, .value = nl->n_value);
             
             if(found)
-               macho_disassemble_code(nl->n_value);
+               macho_disassemble_code(macho, nl->n_value);
         }
     } else {
-        struct nlist *symtab = macho_get_bytes(symoff + headeroff);
-        char *strtab = macho_get_bytes(stroff + headeroff);
         for(int i=0; i<nsyms; i++){
-            struct nlist* nl = &symtab[i];
+            struct nlist* nl = macho_get_bytes(macho, symbols + i * nlist_size);
             
             if(nl->n_type & N_STAB) {
                 continue;
@@ -195,8 +665,12 @@ void macho_print_symtab(mach_header_t header,
                 value |= 1;
             }
             
+            bool found = false;
             const char* type = NULL;
-            const char* symname = &strtab[nl->n_un.n_strx];
+            const char* symname = nl->n_un.n_strx < strsize ? macho_read_string(macho, strings + nl->n_un.n_strx) : NULL;
+            
+            if(!symname)
+                symname = "";
             
             switch(nl->n_type & N_TYPE) {
                 case N_UNDF: type = "N_UNDF"; break;
@@ -205,40 +679,75 @@ void macho_print_symtab(mach_header_t header,
                     
                     // this symbol table is provided by the user to disassemble any symbols found
                     // find the symbol here
-                    if(gmacho_file->symboltable)
-                    {
-                        char **symbols = gmacho_file->symboltable->symbols;
-                        uint32_t num_symbols = gmacho_file->symboltable->num_symbols;
-                        
-                        for(int j=0; j<num_symbols; j++)
-                        {
-                            char *symbol = symbols[j];
-                            
-                            if(strcmp(symname,symbol) == 0)
-                            {
-                                
-                            }
-                        }
-                    }
+                    found = macho_symbol_requested(macho->symboltable, symname);
                     
                     break;
                 case N_PBUD: type = "N_PBUD"; break;
                 case N_INDR: type = "N_INDR"; break;
                 default:
-                    printf("Invalid symbol type: 0x%x\n", nl->n_type & N_TYPE);
+                    macho_print(macho, "Invalid symbol type: 0x%x\n", nl->n_type & N_TYPE);
                     return;
             }
             
-            printf("\t\tSymbol \"%s\" type: %s value: 0x%x\n", symname, type, value);
+            macho_print(macho, "\t\tSymbol \"%s\" type: %s value: 0x%x\n", symname, type, value);
+            
+            macho_emit(macho, symbol, .name = symname, .type = type, .value = value);
+            
+            if(found)
+                macho_disassemble_code(macho, value);
         }
     }
 }
 
-void macho_parse_linkedit(mach_vm_address_t addr, uint64_t offset, uint64_t size)
-{
-    // todo list rebasing opcodes, binding info, exports, function starts, data in code, etc
-    // this is something i don't know how to do yet as it is not documented well
-    // might not ever get to this, because it's hard
+// symbolicates the addresses given with --lookup against this image's symbol table
+void macho_print_lookups(macho_file *macho,
+                         uint64_t headeroff,
+                         uint32_t symoff,
+                         uint32_t nsyms,
+                         uint32_t stroff,
+                         uint32_t strsize){
+    macho_symbol_index index;
+    size_t count = macho->options.num_lookup_addresses;
+    const macho_symbol **results = macho_arena_alloc(&macho->arena, count * sizeof(macho_symbol*));
+    
+    if(!results || !macho_symbol_index_build(macho, &index, headeroff, symoff, nsyms, stroff, strsize)){
+        macho_print(macho, "\tFailed to index the symbol table\n");
+        return;
+    }
+    
+    uint64_t *function_starts;
+    uint32_t num_function_starts = macho_load_function_starts(macho, &function_starts);
+    
+    macho_symbol_index_bound(&index, function_starts, num_function_starts);
+    macho_symbol_index_lookup_batch(&index, macho->options.lookup_addresses, results, count);
+    macho_count(macho, MACHO_COUNTER_LOOKUPS, count);
+    
+    macho_print(macho, "\tLookups (%u indexed symbols)\n", index.count);
+    
+    for(size_t i = 0; i < count; i++){
+        uint64_t address = macho->options.lookup_addresses[i];
+        uint64_t function = macho_function_start_before(function_starts, num_function_starts, address);
+        const macho_segment *segment = macho_find_segment(macho, address);
+        
+        // the last function runs to the end of its segment at most
+        if(function && (!segment || segment != macho_find_segment(macho, function)))
+            function = 0;
+        
+        if(results[i])
+            macho_emit(macho, lookup, .address = address, .symbol = macho_symbol_index_name(&index, results[i]),
+                       .offset = address - results[i]->address);
+        else
+            macho_emit(macho, lookup, .address = address, .function = function, .offset = function ? address - function : 0);
+        
+        
+        if(results[i])
+            macho_print(macho, "\t\t0x%"PRIx64" %s+0x%"PRIx64"\n", address, macho_symbol_index_name(&index, results[i]), address - results[i]->address);
+        else if(function)
+            // stripped code still has function starts, name it after the function like a crash report would
+            macho_print(macho, "\t\t0x%"PRIx64" sub_%"PRIx64"+0x%"PRIx64"\n", address, function, address - function);
+        else
+            macho_print(macho, "\t\t0x%"PRIx64" ???\n", address);
+    }
 }
 
 enum
@@ -250,96 +759,160 @@ enum
     BOUND_INFO_PLIST
 };
 
-typedef struct{
-    char *name;
-    uint8_t *data;
-    uint8_t *hash;
-    uint32_t hashSize;
-    bool sha256;
-} special_slot;
-
-static special_slot specialSlots[5] = {{"Entitlements.plist", NULL, NULL },
-                                        {"Application Specific",NULL, NULL},
-                                        { "Resource Directory", NULL, NULL},
-                                        {"Requirements Blob", NULL, NULL},
-                                        {"Bound Info.plist", NULL, NULL}
+static const char *special_slot_names[MACHO_NUM_SPECIAL_SLOTS] = {"Entitlements.plist",
+                                                                 "Application Specific",
+                                                                 "Resource Directory",
+                                                                 "Requirements Blob",
+                                                                 "Bound Info.plist"
 };
 
-#define min(a,b) \
-    ({ __typeof__ (a) _a = (a); \
-    __typeof__ (b) _b = (b); \
-    _a < _b ? _a : _b; })
-
 bool macho_compare_hash(uint8_t *hash1, uint8_t *hash2, uint32_t hashSize)
 {
     return (memcmp(hash1, hash2, hashSize) == 0);
 }
 
-uint8_t* macho_compute_hash(bool sha256, uint8_t *blob, uint32_t size)
+static bool macho_hash_is_zero(const uint8_t *hash, uint32_t hashSize)
 {
-    uint8_t *result;
+    for(uint32_t i = 0; i < hashSize; i++)
+        if(hash[i])
+            return false;
     
+    return true;
+}
+
+// result has room for a SHA-256 digest, a SHA-1 one only fills the front of it
+void macho_compute_hash(bool sha256, uint8_t *blob, uint32_t size, uint8_t *result)
+{
     if(sha256)
-    {
-        result = malloc(CC_SHA256_DIGEST_LENGTH);
-        CC_SHA256(blob, size, result);
-    } else
-    {
-        result = malloc(CC_SHA1_DIGEST_LENGTH);
-        CC_SHA1(blob, size, result);
-    }
-    
-    return result;
+        macho_sha256(blob, size, result);
+    else
+        macho_sha1(blob, size, result);
 }
 
-bool macho_verify_code_slot(bool sha256, char *signature, uint32_t signature_size, uint32_t offset, uint32_t size)
+// takes the page itself rather than its offset, the verification workers share one context and must not slide its window
+bool macho_verify_code_slot(const uint8_t *blob, uint32_t size, bool sha256, char *signature, uint32_t signature_size)
 {
     bool verified = false;
     
-    uint8_t *blob = (uint8_t*)macho_get_bytes(offset);
-    
     if(sha256)
     {
-        unsigned char result[CC_SHA256_DIGEST_LENGTH];
-        CC_SHA256(blob, size, result);
-     
-        verified = (memcmp(result,signature,min(CC_SHA256_DIGEST_LENGTH,signature_size)) == 0);
+        unsigned char result[MACHO_SHA256_DIGEST_LENGTH];
+        macho_sha256(blob, size, result);
         
-        assert(CC_SHA256_DIGEST_LENGTH == signature_size);
+        verified = (memcmp(result,signature,min(MACHO_SHA256_DIGEST_LENGTH,signature_size)) == 0);
+        
+        assert(MACHO_SHA256_DIGEST_LENGTH == signature_size);
     } else {
-        unsigned char result[CC_SHA1_DIGEST_LENGTH];
-        CC_SHA1(blob, size, result);
+        unsigned char result[MACHO_SHA1_DIGEST_LENGTH];
+        macho_sha1(blob, size, result);
         
-        verified = (memcmp(result,signature,min(CC_SHA1_DIGEST_LENGTH,signature_size)) == 0);
+        verified = (memcmp(result,signature,min(MACHO_SHA1_DIGEST_LENGTH,signature_size)) == 0);
         
-        assert(CC_SHA1_DIGEST_LENGTH == signature_size);
+        assert(MACHO_SHA1_DIGEST_LENGTH == signature_size);
     }
     
     return verified;
 }
 
+typedef struct{
+    macho_file *macho;
+    bool sha256;
+    uint8_t *hashes;
+    uint32_t hashSize;
+    const uint8_t *code; // the signed pages, from the mach header up to the code signature
+    uint64_t headeroff;
+    uint32_t pageSize;
+    uint32_t lastPageSize;
+    uint32_t nCodeSlots;
+    bool *verified;
+} code_page_job;
 
-void macho_parse_code_directory(mach_header_t header, uint32_t headeroff, bool swap, uint32_t offset, uint32_t size)
-{
-    SuperBlob *superblob = (SuperBlob*)macho_get_bytes(headeroff + offset);
-    uint32_t blobcount = swap32(superblob->count);
+// verifies one group of up to MACHO_SHA_LANES consecutive pages, the full pages of a group
+// are hashed side by side by the multi-buffer engine and the groups run on the thread pool
+static void macho_verify_code_pages(void *ctx, uint32_t group){
+    code_page_job *job = (code_page_job*)ctx;
+    uint32_t first = group * MACHO_SHA_LANES;
+    uint32_t count = min(job->nCodeSlots - first, (uint32_t)MACHO_SHA_LANES);
+    uint32_t full = count;
     
-    printf("%u blobs\n",blobcount);
+    const uint8_t *pages[MACHO_SHA_LANES];
+    uint8_t digests[MACHO_SHA_LANES][MACHO_SHA256_DIGEST_LENGTH];
+    uint8_t *out[MACHO_SHA_LANES];
     
-    for(int blob = 0; blob < blobcount; blob++){
-        BlobIndex index = superblob->index[blob];
-        uint32_t blobtype = swap32(index.type);
+    // the last page is cut short at the code signature so it can't share the lanes
+    if(first + count == job->nCodeSlots){
+        full--;
+        
+        job->verified[first + full] = macho_verify_code_slot(job->code + (uint64_t)(first + full) * job->pageSize,
+                                                             job->lastPageSize,
+                                                             job->sha256,
+                                                             (char*)(job->hashes + (first + full) * job->hashSize),
+                                                             job->hashSize);
+    }
+    
+    for(uint32_t i = 0; i < full; i++){
+        pages[i] = job->code + (uint64_t)(first + i) * job->pageSize;
+        out[i] = digests[i];
+    }
+    
+    if(job->sha256)
+        macho_sha256_multi(pages, job->pageSize, out, full);
+    else
+        macho_sha1_multi(pages, job->pageSize, out, full);
+    
+    uint32_t digest_size = job->sha256 ? MACHO_SHA256_DIGEST_LENGTH : MACHO_SHA1_DIGEST_LENGTH;
+    
+    for(uint32_t i = 0; i < full; i++)
+        job->verified[first + i] = memcmp(digests[i],
+                                          job->hashes + (first + i) * job->hashSize,
+                                          min(digest_size, job->hashSize)) == 0;
+    
+    // a windowed mapping lets go of every group once it's hashed
+    macho_window_drop(job->macho, job->headeroff + (uint64_t)first * job->pageSize, (uint64_t)count * job->pageSize);
+}
+
+void macho_parse_code_directory(macho_file *macho, mach_header_t header, uint64_t headeroff, bool swap, uint32_t offset, uint32_t size)
+{
+    SuperBlob *superblob = (SuperBlob*)macho_get_range(macho, headeroff + offset, sizeof(SuperBlob));
+    
+    if(!superblob){
+        macho_print(macho, "Code signature is outside the file\n");
+        return;
+    }
+    
+    uint32_t blobcount = swap32(superblob->count);
+    
+    macho_print(macho, "%u blobs\n",blobcount);
+    
+    for(int blob = 0; blob < blobcount; blob++){
+        BlobIndex index;
+        
+        if(!macho_read(macho, headeroff + offset + sizeof(SuperBlob) + blob * sizeof(BlobIndex), &index, sizeof(BlobIndex)))
+            break;
+        
+        uint32_t blobtype = swap32(index.type);
         uint32_t bloboffset = swap32(index.offset);
-        uint32_t begin = headeroff + offset + bloboffset;
+        uint64_t begin = headeroff + offset + bloboffset;
+        
+        Blob *blob = macho_get_range(macho, begin, sizeof(Blob));
+        
+        if(!blob)
+            break;
         
-        Blob *blob = macho_get_bytes(begin);
         uint32_t magic = swap32(blob->magic);
         uint32_t length = swap32(blob->length);
         
+        macho_emit(macho, signature_blob, .type = blobtype, .magic = magic, .offset = begin, .length = length,
+                   .data = macho_get_range(macho, begin, length));
+        
         switch(magic){
             case CSMAGIC_CODEDIRECTORY:
                 ;
-                code_directory_t directory = macho_get_bytes(begin);
+                code_directory_t directory = macho_get_range(macho, begin, sizeof(*directory));
+                
+                if(!directory)
+                    break;
+                
                 uint32_t hashOffset = swap32(directory->hashOffset);
                 uint32_t identOffset = swap32(directory->identOffset);
                 uint32_t nSpecialSlots = swap32(directory->nSpecialSlots);
@@ -349,112 +922,192 @@ void macho_parse_code_directory(mach_header_t header, uint32_t headeroff, bool s
                 uint32_t pageSize = directory->pageSize;
                 bool sha256 = false;
                 
-                char *ident = macho_read_string(begin + identOffset);
-                printf("Identifier: %s\n",ident);
-                printf("Page size: %u bytes\n",1 << pageSize);
+                uint32_t codeLimit = swap32(directory->codeLimit);
+                
+                char *ident = macho_read_string(macho, begin + identOffset);
+                macho_print(macho, "Identifier: %s\n",ident ? ident : "");
+                
+                // a page size of 0 means infinite, the code is hashed as a single page up to codeLimit
+                if(pageSize > 31){
+                    macho_print(macho, "Invalid page size 2^%u\n",pageSize);
+                    break;
+                } else if(pageSize){
+                    macho_print(macho, "Page size: %u bytes\n",1u << pageSize);
+                } else {
+                    macho_print(macho, "Page size: unlimited, one page of %u bytes\n",codeLimit);
+                }
+                
+                uint32_t digestSize;
                 
                 if(hashType == HASH_TYPE_SHA1){
-                    printf("CD signatures are signed with SHA1\n");
+                    digestSize = MACHO_SHA1_DIGEST_LENGTH;
+                    macho_print(macho, "CD signatures are signed with SHA1\n");
                 } else if(hashType == HASH_TYPE_SHA256){
                     sha256 = true;
-                    printf("CD signatures are signed with SHA256\n");
+                    digestSize = MACHO_SHA256_DIGEST_LENGTH;
+                    macho_print(macho, "CD signatures are signed with SHA256\n");
                 } else {
-                    printf("Unknown hashing algorithm in pages\n");
+                    macho_print(macho, "Unknown hashing algorithm in pages, not verifying them\n");
+                    break;
+                }
+                
+                // a short hash would compare too few bytes (none at all for 0) and a long one overruns the digest
+                if(hashSize != digestSize){
+                    macho_print(macho, "Hash size %u doesn't match the hashing algorithm, not verifying pages\n",hashSize);
+                    break;
+                }
+                
+                code_page_job job;
+                
+                job.macho = macho;
+                job.sha256 = sha256;
+                job.hashes = macho_get_range(macho, begin + hashOffset, (uint64_t)nCodeSlots * hashSize);
+                job.hashSize = hashSize;
+                job.headeroff = headeroff;
+                job.pageSize = pageSize ? 1u << pageSize : codeLimit;
+                job.nCodeSlots = nCodeSlots;
+                
+                // the last page is hashed only up to codeLimit, where the code signature starts,
+                // so that the code signature doesn't get included into the hash
+                uint64_t fullPages = nCodeSlots ? (uint64_t)(nCodeSlots - 1) * job.pageSize : 0;
+                
+                if(nCodeSlots && (codeLimit <= fullPages || codeLimit - fullPages > job.pageSize)){
+                    macho_print(macho, "Code limit 0x%x doesn't match %u code slots\n",codeLimit,nCodeSlots);
+                    break;
                 }
                 
+                job.lastPageSize = nCodeSlots ? (uint32_t)(codeLimit - fullPages) : 0;
+                job.code = nCodeSlots ? macho_get_range(macho, headeroff, (uint64_t)(nCodeSlots - 1) * job.pageSize + job.lastPageSize) : NULL;
+                
+                if(!job.hashes || (nCodeSlots && !job.code)){
+                    macho_print(macho, "Code slots are outside the file\n");
+                    break;
+                }
+                
+                job.verified = macho_arena_calloc(&macho->arena, nCodeSlots ? nCodeSlots : 1, sizeof(bool));
+                
+                if(!job.verified)
+                    break;
+                
+                // verify every page first, then print in page order so the output
+                // is the same no matter how many threads did the hashing
+                struct timespec verify_start, verify_end;
+                clock_gettime(CLOCK_MONOTONIC, &verify_start);
+                
+                uint32_t groups = (nCodeSlots + MACHO_SHA_LANES - 1) / MACHO_SHA_LANES;
+                
+                if(macho->options.verify_threads != 1)
+                    macho_parallel_for(macho->options.verify_threads, groups, macho_verify_code_pages, &job);
+                else
+                    for(uint32_t i = 0; i < groups; i++)
+                        macho_verify_code_pages(&job, i);
+                
+                clock_gettime(CLOCK_MONOTONIC, &verify_end);
+                macho_count(macho, MACHO_COUNTER_PAGES_HASHED, nCodeSlots);
+                
                 for(int i = 0; i < nCodeSlots; i++){
-                    uint32_t pages = nCodeSlots;
+                    macho_print(macho, "\tPage %2u ",i);
                     
-                    if(pages){
-                        printf("\tPage %2u ",i);
-                    }
-                    uint8_t *hash = macho_get_bytes(begin + hashOffset + i * hashSize);
+                    uint8_t *hash = job.hashes + i * hashSize;
+                    
+                    macho_window_use(macho, hash, hashSize);
                     
                     for(int j = 0; j < hashSize; j++){
-                        printf("%.2x",hash[j]);
+                        macho_print(macho, "%.2x",hash[j]);
                     }
                     
-                    if(i + 1 != nCodeSlots)
-                    {
-                        if(macho_verify_code_slot(sha256,(char*)hash,hashSize,headeroff + i * (1 << pageSize), 1 << pageSize))
-                            printf(" OK...");
-                        else
-                            printf(" Invalid!!!");
-                    } else {
-                        if(macho_verify_code_slot(sha256,
-                                                  (char*)hash,
-                                                  hashSize,
-                                                  headeroff + i * (1 << pageSize),
-                                                  (headeroff + offset) % (1 << pageSize)))
-                        // hash the last page only until the code signature,
-                        // so that that code signature doesn't get included into hash
-                            printf(" OK...");
-                    }
+                    if(job.verified[i])
+                        macho_print(macho, " OK...");
+                    else
+                        macho_print(macho, " Invalid!!!");
+                    
+                    macho_print(macho, "\n");
+                }
+                
+                if(macho->options.verify_stats){
+                    double seconds = (verify_end.tv_sec - verify_start.tv_sec) +
+                                     (verify_end.tv_nsec - verify_start.tv_nsec) / 1e9;
+                    uint32_t threads = macho->options.verify_threads ? macho->options.verify_threads : macho_cpu_count();
                     
-                    printf("\n");
+                    macho_print(macho, "Verified %u pages in %.3f ms with %u threads using %s (%.0f pages/s)\n",
+                            nCodeSlots,
+                            seconds * 1e3,
+                            threads,
+                            macho_sha_engine_name(macho_sha_multi_engine()),
+                            seconds > 0 ? nCodeSlots / seconds : 0);
                 }
                 
                 begin = headeroff + offset + bloboffset - hashSize * nSpecialSlots;
                 
-                printf("\nSpecial Slots\n");
+                macho_print(macho, "\nSpecial Slots\n");
                 
                 for(int i = 0; i < nSpecialSlots; i++){
                     
-                    if(i<5)
-                        printf("\t%s ",specialSlots[i].name);
+                    if(i<MACHO_NUM_SPECIAL_SLOTS)
+                        macho_print(macho, "\t%s ",special_slot_names[i]);
                     
-                    uint8_t *hash = macho_get_bytes(begin + hashOffset + i * hashSize);
+                    uint8_t *hash = macho_get_range(macho, begin + hashOffset + i * hashSize, hashSize);
+                    
+                    if(!hash)
+                        break;
                     
                     for(int j = 0; j < hashSize; j++){
-                        printf("%.2x",hash[j]);
+                        macho_print(macho, "%.2x",hash[j]);
                     }
                     
                     
-                    specialSlots[i].sha256 = (hashType == HASH_TYPE_SHA256);
-                    specialSlots[i].hash = hash;
-                    specialSlots[i].hashSize = hashSize;
-                    
-                    uint8_t *zero_buffer = calloc(hashSize, sizeof(uint8_t));
+                    if(i<MACHO_NUM_SPECIAL_SLOTS){
+                        macho->special_slots[i].sha256 = (hashType == HASH_TYPE_SHA256);
+                        macho->special_slots[i].hash = hash;
+                        macho->special_slots[i].hashSize = hashSize;
+                    }
                     
-                    if(memcmp(hash, zero_buffer, hashSize) != 0)
+                    // an empty slot has an all zero hash
+                    if(!macho_hash_is_zero(hash, hashSize))
                     {
                         if(i == BOUND_INFO_PLIST)
                         {
-                            char *path = get_macho()->path;
+                            // tokenize a private copy, the path is shared with whoever owns this image
+                            char *path = macho_arena_strdup(&macho->arena, macho->path);
+                            char *saveptr = NULL;
                             
                             char **res = NULL;
                             bool found = false;
                             uint32_t num_tokens = 0;
                             uint32_t new_length = 0;
                             
-                            char *app_dir = strtok(path, "/");
+                            char *app_dir = path ? strtok_r(path, "/", &saveptr) : NULL;
                             
                             while (app_dir) {
                                 new_length += strlen(app_dir);
                                 
-                                res = realloc (res, sizeof (char*) * ++num_tokens);
+                                res = macho_arena_realloc(&macho->arena, res, sizeof(char*) * num_tokens, sizeof(char*) * (num_tokens + 1));
                                 
                                 if (res == NULL)
                                     break;
                                 
-                                res[num_tokens-1] = app_dir;
+                                res[num_tokens++] = app_dir;
                                 
-                                app_dir = strtok (NULL, "/");
+                                app_dir = strtok_r(NULL, "/", &saveptr);
                                 
-                                if(strcmp(app_dir,"MacOS") == 0)
+                                if(app_dir && strcmp(app_dir,"MacOS") == 0)
                                 {
                                     found = true;
                                     break;
                                 }
-                                
+                            
                             }
                             
                             if(!found)
                                 continue;
                             
-                            new_length += num_tokens + 1;
+                            // a slash before every token and the file name with its nul
+                            new_length += num_tokens + sizeof("/Info.plist");
                             
-                            char *info_plist = malloc(sizeof(char) * new_length);
+                            char *info_plist = macho_arena_calloc(&macho->arena, new_length, sizeof(char));
+                            
+                            if(!info_plist)
+                                continue;
                             
                             for(int j=0; j < num_tokens; j++)
                             {
@@ -465,32 +1118,37 @@ void macho_parse_code_directory(mach_header_t header, uint32_t headeroff, bool s
                             strcat(info_plist,"/Info.plist");
                             
                             FILE *info = fopen(info_plist, "rb");
+                            
+                            if(!info)
+                            {
+                                macho_print(macho, " missing Info.plist\n");
+                                continue;
+                            }
+                            
                             fseek(info,0,SEEK_END);
-                            size_t info_size = ftell(info);
+                            long info_size = ftell(info);
                             fseek(info,0,SEEK_SET);
                             
-                            uint8_t *info_buf = malloc(info_size);
-                            fseek(info,0,SEEK_SET);
-                            fread(info_buf,1,size,info);
+                            uint8_t *info_buf = info_size > 0 ? macho_arena_alloc(&macho->arena, info_size) : NULL;
+                            bool read = info_buf && fread(info_buf,1,info_size,info) == (size_t)info_size;
                             
                             fclose(info);
                             
-                            uint8_t *info_hash = macho_compute_hash(specialSlots[i].sha256, info_buf, (uint32_t)info_size);
+                            uint8_t info_hash[MACHO_SHA256_DIGEST_LENGTH];
                             
-                            if(memcmp(info_hash, specialSlots[i].hash, specialSlots[i].hashSize) == 0)
-                                printf(" OK...");
-                            else
-                                printf(" Invalid!!!");
-                        
+                            if(read)
+                                macho_compute_hash(macho->special_slots[i].sha256, info_buf, (uint32_t)info_size, info_hash);
                             
+                            if(read && memcmp(info_hash, macho->special_slots[i].hash, min(macho->special_slots[i].hashSize, MACHO_SHA256_DIGEST_LENGTH)) == 0)
+                                macho_print(macho, " OK...");
+                            else
+                                macho_print(macho, " Invalid!!!");
                         }
-                        
-                        free(zero_buffer);
-                                                      
+                    
                     }
-                                                  
                     
-                    printf("\n");
+                    
+                    macho_print(macho, "\n");
                 }
                 break;
             case CSMAGIC_BLOBWRAPPER:
@@ -502,26 +1160,33 @@ void macho_parse_code_directory(mach_header_t header, uint32_t headeroff, bool s
             case CSMAGIC_EMBEDDED_ENTITLEMENTS:
                 ;
                 uint8_t *blob_raw;
-                uint8_t *blob_hash;
+                uint8_t blob_hash[MACHO_SHA256_DIGEST_LENGTH];
                 
                 char *entitlements;
                 
-                entitlements = malloc(length - sizeof(struct Blob));
-                memcpy(entitlements, macho_get_bytes(begin + sizeof(struct Blob)), length - sizeof(struct Blob));
+                blob_raw = macho_get_range(macho, begin, length);
                 
-                blob_raw = macho_get_bytes(begin);
-                blob_hash = macho_compute_hash(specialSlots[ENTITLEMENTS].sha256, blob_raw, length);
+                if(!blob_raw || length < sizeof(struct Blob))
+                    break;
                 
-                printf("\nEntitlements ");
+                // the plist in the blob isn't nul terminated
+                entitlements = macho_arena_calloc(&macho->arena, length - sizeof(struct Blob) + 1, sizeof(char));
                 
-                if(macho_compare_hash(specialSlots[ENTITLEMENTS].hash, blob_hash, specialSlots[ENTITLEMENTS].hashSize))
-                    printf("OK...\n");
-                else
-                    printf("Invalid!!!\n");
+                if(!entitlements)
+                    break;
+                
+                macho_read(macho, begin + sizeof(struct Blob), entitlements, length - sizeof(struct Blob));
                 
-                printf("%s\n",entitlements);
+                macho_compute_hash(macho->special_slots[ENTITLEMENTS].sha256, blob_raw, length, blob_hash);
                 
-                free(entitlements);
+                macho_print(macho, "\nEntitlements ");
+                
+                if(macho_compare_hash(macho->special_slots[ENTITLEMENTS].hash, blob_hash, min(macho->special_slots[ENTITLEMENTS].hashSize, MACHO_SHA256_DIGEST_LENGTH)))
+                    macho_print(macho, "OK...\n");
+                else
+                    macho_print(macho, "Invalid!!!\n");
+                
+                macho_print(macho, "%s\n",entitlements);
                 
                 break;
             default:
@@ -531,61 +1196,422 @@ void macho_parse_code_directory(mach_header_t header, uint32_t headeroff, bool s
     }
 }
 
-void macho_parse_load_commands(mach_header_t header, uint32_t headeroff, bool swap, uint32_t offset, uint32_t ncmds){
-    for(int i=0; i<ncmds; i++){
-        struct load_command *load_cmd = (struct load_command*)macho_get_bytes(offset);
-        swap(load_command, load_cmd, swap);
+bool macho_load_command_index_build(macho_file *macho, macho_load_command_index *index, bool swap, uint64_t offset, uint32_t ncmds){
+    index->commands = macho_arena_alloc(&macho->arena, (ncmds ? ncmds : 1) * sizeof(macho_load_command_entry));
+    index->count = 0;
+    
+    if(!index->commands)
+        return false;
+    
+    // only the 8 byte command headers are touched, the commands themselves stay unread until somebody asks
+    for(uint32_t i = 0; i < ncmds && (uint64_t)offset + sizeof(struct load_command) <= macho->size; i++){
+        struct load_command load_cmd;
+        macho_read(macho, offset, &load_cmd, sizeof(struct load_command));
+        swap(load_command,&load_cmd,swap);
+        
+        if(load_cmd.cmdsize < sizeof(struct load_command) || (uint64_t)offset + load_cmd.cmdsize > macho->size)
+            break;
+        
+        macho_load_command_entry *entry = &index->commands[index->count++];
+        entry->cmd = load_cmd.cmd;
+        entry->offset = offset;
+        entry->size = load_cmd.cmdsize;
+        
+        offset += load_cmd.cmdsize;
+    }
+    
+    return true;
+}
+
+const macho_load_command_entry* macho_find_load_command(const macho_load_command_index *index, uint32_t cmd, const macho_load_command_entry *after){
+    uint32_t i = after ? (uint32_t)(after - index->commands) + 1 : 0;
+    
+    for(; i < index->count; i++){
+        if(index->commands[i].cmd == cmd)
+            return &index->commands[i];
+    }
+    
+    return NULL;
+}
+
+typedef struct{
+    macho_file *macho;
+    const char **dylibs; // install names by ordinal - 1
+    uint32_t num_dylibs;
+    uint64_t count;
+} macho_fixup_printer;
+
+static const char* macho_fixup_dylib(const macho_fixup_printer *printer, int32_t ordinal){
+    switch(ordinal){
+        case BIND_SPECIAL_DYLIB_SELF:
+            return "this image";
+        case BIND_SPECIAL_DYLIB_MAIN_EXECUTABLE:
+            return "main executable";
+        case BIND_SPECIAL_DYLIB_FLAT_LOOKUP:
+            return "flat lookup";
+        case BIND_SPECIAL_DYLIB_WEAK_LOOKUP:
+            return "weak lookup";
+        default:
+            break;
+    }
+    
+    if(ordinal > 0 && (uint32_t)ordinal <= printer->num_dylibs)
+        return printer->dylibs[ordinal - 1];
+    
+    return "unknown dylib";
+}
+
+static bool macho_print_fixup(void *ctx, const macho_fixup *fixup){
+    macho_fixup_printer *printer = ctx;
+    macho_file *macho = printer->macho;
+    const char *segname = macho->segment_map.segments[fixup->segment].segname;
+    
+    macho_count(macho, MACHO_COUNTER_FIXUPS, 1);
+    
+    if(fixup->kind == MACHO_FIXUP_REBASE)
+        macho_emit(macho, fixup, .kind = macho_fixup_kind_name(fixup->kind), .segment = segname, .address = fixup->address);
+    else
+        macho_emit(macho, fixup, .kind = macho_fixup_kind_name(fixup->kind), .segment = segname, .address = fixup->address,
+                   .symbol = fixup->symbol ? fixup->symbol : "", .dylib = macho_fixup_dylib(printer, fixup->ordinal),
+                   .addend = fixup->addend);
+    
+    if(fixup->kind == MACHO_FIXUP_REBASE){
+        macho_print(macho, "\t\t%-9s %-16.16s 0x%"PRIx64"\n",macho_fixup_kind_name(fixup->kind),segname,fixup->address);
+    } else {
+        macho_print(macho, "\t\t%-9s %-16.16s 0x%"PRIx64" %s (%s)",macho_fixup_kind_name(fixup->kind),
+                                                              segname,
+                                                              fixup->address,
+                                                              fixup->symbol ? fixup->symbol : "?",
+                                                              macho_fixup_dylib(printer, fixup->ordinal));
+        
+        if(fixup->addend)
+            macho_print(macho, " + %"PRId64,fixup->addend);
+        
+        macho_print(macho, "\n");
+    }
+    
+    printer->count++;
+    
+    return true;
+}
+
+// bind ordinals count every kind of dylib load in command order
+static bool macho_fixup_printer_init(macho_fixup_printer *printer, macho_file *macho, const macho_load_command_index *index, bool swap){
+    printer->macho = macho;
+    printer->num_dylibs = 0;
+    printer->count = 0;
+    printer->dylibs = macho_arena_calloc(&macho->arena, index->count ? index->count : 1, sizeof(const char*));
+    
+    if(!printer->dylibs)
+        return false;
+    
+    for(uint32_t i = 0; i < index->count; i++){
+        const macho_load_command_entry *entry = &index->commands[i];
+        
+        if(entry->cmd != LC_LOAD_DYLIB && entry->cmd != LC_LOAD_WEAK_DYLIB && entry->cmd != LC_REEXPORT_DYLIB &&
+           entry->cmd != LC_LOAD_UPWARD_DYLIB && entry->cmd != LC_LAZY_LOAD_DYLIB)
+            continue;
+        
+        struct dylib_command dylib_command;
+        macho_read(macho, entry->offset, &dylib_command, sizeof(struct dylib_command));
+        swap(dylib_command,&dylib_command,swap);
+        
+        const char *name = dylib_command.dylib.name.offset < entry->size ?
+                           macho_read_string(macho, entry->offset + dylib_command.dylib.name.offset) :
+                           NULL;
+        
+        printer->dylibs[printer->num_dylibs++] = name ? name : "unknown dylib";
+    }
+    
+    return true;
+}
+
+// decodes the rebase and bind opcodes of LC_DYLD_INFO(_ONLY) and prints every fixup as it's produced
+static void macho_print_dyld_info(macho_file *macho, const macho_load_command_index *index, const struct dyld_info_command *info, bool swap){
+    macho_fixup_printer printer = { .macho = macho };
+    
+    macho_print(macho, "\tRebase opcodes at offset 0x%x with size of %u bytes\n",info->rebase_off,info->rebase_size);
+    macho_print(macho, "\tBind opcodes at offset 0x%x with size of %u bytes\n",info->bind_off,info->bind_size);
+    macho_print(macho, "\tWeak bind opcodes at offset 0x%x with size of %u bytes\n",info->weak_bind_off,info->weak_bind_size);
+    macho_print(macho, "\tLazy bind opcodes at offset 0x%x with size of %u bytes\n",info->lazy_bind_off,info->lazy_bind_size);
+    
+    if(!macho_fixup_printer_init(&printer, macho, index, swap))
+        return;
+    
+    macho_print(macho, "\tFixups\n");
+    
+    if(!macho_walk_dyld_info(macho, info, MACHO_FIXUP_ALL, macho_print_fixup, &printer))
+        macho_print(macho, "\tMalformed or unsupported opcodes, fixups after that point were skipped\n");
+    
+    macho_print(macho, "\t%"PRIu64" fixups\n",printer.count);
+}
+
+// lists every pointer the chains of LC_DYLD_CHAINED_FIXUPS fix up, from the same table pointer reads go through
+static void macho_print_chained_fixups(macho_file *macho, const macho_load_command_index *index, bool swap){
+    macho_fixup_printer printer;
+    macho_chained_fixups *fixups = macho_load_chained_fixups(macho);
+    uint32_t size = 0;
+    
+    if(!fixups || !macho_chained_fixups_data(macho, index, swap, &size))
+        return;
+    
+    if(!macho_fixup_printer_init(&printer, macho, index, swap))
+        return;
+    
+    macho_print(macho, "\t%u imports\n",fixups->num_imports);
+    macho_print(macho, "\tFixups\n");
+    macho_count(macho, MACHO_COUNTER_FIXUPS, fixups->count);
+    
+    for(uint32_t i = 0; i < fixups->count; i++){
+        const macho_chained_fixup *fixup = &fixups->fixups[i];
+        const char *segname = macho->segment_map.segments[fixup->segment].segname;
+        const char *auth = fixup->flags & MACHO_CHAINED_AUTH ? " (auth)" : "";
+        
+        if(fixup->import == MACHO_CHAINED_REBASE){
+            macho_emit(macho, fixup, .kind = "rebase", .chained = true, .segment = segname, .address = fixup->address,
+                       .target = fixup->target, .flags = fixup->flags);
+            macho_print(macho, "\t\t%-9s %-16.16s 0x%"PRIx64" -> 0x%"PRIx64"%s\n","rebase",segname,fixup->address,fixup->target,auth);
+            continue;
+        }
+        
+        if(fixup->import >= fixups->num_imports){
+            macho_emit(macho, fixup, .kind = "bind", .chained = true, .segment = segname, .address = fixup->address,
+                       .target = fixup->target, .flags = fixup->flags);
+            macho_print(macho, "\t\t%-9s %-16.16s 0x%"PRIx64" import %u out of range\n","bind",segname,fixup->address,fixup->import);
+            continue;
+        }
+        
+        const macho_chained_import *import = &fixups->imports[fixup->import];
+        int64_t addend = import->addend + (int64_t)fixup->target;
+        
+        macho_emit(macho, fixup, .kind = "bind", .chained = true, .segment = segname, .address = fixup->address,
+                   .symbol = import->name, .dylib = macho_fixup_dylib(&printer, import->ordinal), .addend = addend,
+                   .target = fixup->target, .flags = fixup->flags);
+        
+        macho_print(macho, "\t\t%-9s %-16.16s 0x%"PRIx64" %s (%s)%s","bind",segname,fixup->address,import->name,macho_fixup_dylib(&printer, import->ordinal),auth);
+        
+        if(addend)
+            macho_print(macho, " + %"PRId64,addend);
+        
+        macho_print(macho, "\n");
+    }
+    
+    macho_print(macho, "\t%u fixups\n",fixups->count);
+}
+
+static bool macho_print_export(void *ctx, const char *name, const macho_export *export){
+    macho_file *macho = ctx;
+    
+    macho_count(macho, MACHO_COUNTER_EXPORTS, 1);
+    
+    if(macho->visitor){
+        if(export->flags & EXPORT_SYMBOL_FLAGS_REEXPORT)
+            macho_emit(macho, export_symbol, .name = name, .flags = export->flags, .other = export->other,
+                       .import_name = export->import_name ? export->import_name : name);
+        else
+            macho_emit(macho, export_symbol, .name = name, .flags = export->flags, .address = export->address, .other = export->other);
+        
+        return true;
+    }
+    
+    if(export->flags & EXPORT_SYMBOL_FLAGS_REEXPORT){
+        macho_print(macho, "\t\t%s re-exported from dylib %"PRIu64" as %s\n",name,export->other,export->import_name ? export->import_name : name);
+        return true;
+    }
+    
+    macho_print(macho, "\t\t0x%"PRIx64" %s",export->address,name);
+    
+    if(export->flags & EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION)
+        macho_print(macho, " (weak)");
+    
+    if((export->flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL)
+        macho_print(macho, " (thread local)");
+    
+    if((export->flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE)
+        macho_print(macho, " (absolute)");
+    
+    if(export->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER)
+        macho_print(macho, " (resolver at 0x%"PRIx64")",export->other);
+    
+    macho_print(macho, "\n");
+    
+    return true;
+}
+
+// lists the export trie and answers the symbols asked for on the command line straight from it
+static void macho_print_exports(macho_file *macho, uint32_t offset, uint32_t size){
+    macho_export_trie trie;
+    
+    macho_print(macho, "\tExport trie at offset 0x%x with size of %u bytes\n",offset,size);
+    
+    if(!macho_export_trie_at(macho, offset, size, &trie))
+        return;
+    
+    symbol_table *symbols = macho->symboltable;
+    
+    for(uint32_t i = 0; symbols && i < symbols->num_symbols; i++){
+        macho_export export;
+        
+        // CLASSNAME-METHOD queries are answered by the objc metadata
+        if(strchr(symbols->symbols[i], '-'))
+            continue;
+        
+        if(macho_export_trie_lookup(&trie, symbols->symbols[i], &export))
+            macho_print(macho, "\tExported symbol %s at 0x%"PRIx64"\n",symbols->symbols[i],export.address);
+        else
+            macho_print(macho, "\tSymbol %s is not exported\n",symbols->symbols[i]);
+    }
+    
+    macho_print(macho, "\tExports\n");
+    
+    if(!macho_export_trie_walk(&trie, macho_print_export, macho))
+        macho_print(macho, "\tMalformed export trie, exports after that point were skipped\n");
+}
+
+static void macho_emit_segment(macho_file *macho, const char *segname, uint64_t address, uint64_t size, uint64_t fileoff, uint64_t filesize){
+    // the names fill all 16 bytes when they're that long, with no terminator
+    char name[17];
+    
+    snprintf(name, sizeof(name), "%.16s", segname);
+    macho_emit(macho, segment, .name = name, .address = address, .size = size,
+               .fileoff = macho->fileoff_base + fileoff, .filesize = filesize);
+}
+
+static void macho_emit_section(macho_file *macho, const char *segname, const char *sectname, uint64_t address, uint64_t size, uint32_t offset){
+    char segment[17];
+    char name[17];
+    
+    snprintf(segment, sizeof(segment), "%.16s", segname);
+    snprintf(name, sizeof(name), "%.16s", sectname);
+    macho_emit(macho, section, .segment = segment, .name = name, .address = address, .size = size,
+               .offset = macho->fileoff_base + offset);
+}
+
+// which --only part a load command belongs to
+static uint32_t macho_load_command_parts(uint32_t cmd){
+    switch(cmd){
+        case LC_SEGMENT:
+            return MACHO_PART_SEGMENTS;
+        case LC_SEGMENT_64:
+            return MACHO_PART_SEGMENTS | MACHO_PART_OBJC;
+        case LC_LOAD_DYLIB:
+            return MACHO_PART_DYLIBS;
+        case LC_SYMTAB:
+            return MACHO_PART_SYMTAB | MACHO_PART_LOOKUPS;
+        case LC_DYSYMTAB:
+            return MACHO_PART_DYSYMTAB;
+        case LC_MAIN:
+            return MACHO_PART_MAIN;
+        case LC_CODE_SIGNATURE:
+            return MACHO_PART_SIGNATURE;
+        case LC_FUNCTION_STARTS:
+            return MACHO_PART_FUNCTIONS;
+        case LC_DYLD_INFO:
+        case LC_DYLD_INFO_ONLY:
+            return MACHO_PART_BINDINGS | MACHO_PART_EXPORTS;
+        case LC_DYLD_EXPORTS_TRIE:
+            return MACHO_PART_EXPORTS;
+        case LC_DYLD_CHAINED_FIXUPS:
+            return MACHO_PART_BINDINGS;
+        default:
+            return 0;
+    }
+}
+
+void macho_parse_load_commands(macho_file *macho, mach_header_t header, uint64_t headeroff, bool swap, uint64_t offset, uint32_t ncmds){
+    macho_load_command_index index;
+    uint32_t parts = macho->options.parts;
+    
+    if(!macho_load_command_index_build(macho, &index, swap, offset, ncmds))
+        return;
+    
+    macho_count(macho, MACHO_COUNTER_LOAD_COMMANDS, index.count);
+    
+    for(uint32_t i=0; i<index.count; i++){
+        uint32_t cmdtype = index.commands[i].cmd;
+        uint32_t cmdsize = index.commands[i].size;
+        macho_phase phase;
+        
+        offset = index.commands[i].offset;
+        
+        macho_emit(macho, load_command, .cmd = cmdtype, .size = cmdsize, .offset = offset, .data = macho_get_range(macho, offset, cmdsize));
         
-        uint32_t cmdtype = load_cmd->cmd;
-        uint32_t cmdsize = load_cmd->cmdsize;
+        // commands nobody asked for are skipped without even copying them out
+        if(!(parts & macho_load_command_parts(cmdtype)))
+            continue;
         
         switch(cmdtype){
             case LC_SEGMENT:
                 ;
-                struct segment_command *segment_command = (struct segment_command*)macho_get_bytes(offset);
-                swap(segment_command, segment_command, swap);
-                uint32_t nsects = segment_command->nsects;
-                uint32_t sect_offset = offset + sizeof(struct segment_command);
-                printf("LC_SEGMENT - %s 0x%08x to 0x%08x \n",segment_command->segname,
-                                                             segment_command->vmaddr,
-                                                             segment_command->vmaddr + segment_command->vmsize);
+                struct segment_command segment_command;
+                macho_read(macho, offset, &segment_command, sizeof(struct segment_command));
+                swap(segment_command,&segment_command,swap);
+                uint32_t nsects = segment_command.nsects;
+                uint64_t sect_offset = offset + sizeof(struct segment_command);
+                macho_print(macho, "LC_SEGMENT - %s 0x%08x to 0x%08x \n",segment_command.segname,
+                                                             segment_command.vmaddr,
+                                                             segment_command.vmaddr + segment_command.vmsize);
+                
+                if(macho->visitor)
+                    macho_emit_segment(macho, segment_command.segname, segment_command.vmaddr, segment_command.vmsize,
+                                       segment_command.fileoff, segment_command.filesize);
                 
                 for(int j=1; j<=nsects; j++){
-                    struct section *section = (struct section*)macho_get_bytes(sect_offset);
-                    printf("\tSection %d: 0x%08x to 0x%08x - %s\n",j,
+                    struct section *section = (struct section*)macho_get_range(macho, sect_offset, sizeof(struct section));
+                    
+                    if(!section)
+                        break;
+                    
+                    macho_print(macho, "\tSection %d: 0x%08x to 0x%08x - %s\n",j,
                                                                    section->addr,
                                                                    section->addr + section->size,
                                                                    section->sectname);
                     
+                    if(macho->visitor)
+                        macho_emit_section(macho, section->segname, section->sectname, section->addr, section->size, section->offset);
+                    
                     sect_offset += sizeof(struct section);
                 }
                 break;
             case LC_SEGMENT_64:
                 ;
-                struct segment_command_64 *segment_command_64 = (struct segment_command_64*)macho_get_bytes(offset);
-                swap(segment_command_64, segment_command_64, swap);
-                nsects = segment_command_64->nsects;
+                struct segment_command_64 segment_command_64;
+                macho_read(macho, offset, &segment_command_64, sizeof(struct segment_command_64));
+                swap(segment_command_64,&segment_command_64,swap);
+                nsects = segment_command_64.nsects;
                 sect_offset = offset + sizeof(struct segment_command_64);
-                printf("LC_SEGMENT_64 - %s 0x%08llx to 0x%08llx \n",segment_command_64->segname,
-                                                                segment_command_64->vmaddr,
-                                                                segment_command_64->vmaddr + segment_command_64->vmsize);
+                
+                // with --only=objc the section headers are still walked to find the class list, just not printed
+                bool print_segments = parts & MACHO_PART_SEGMENTS;
+                
+                if(print_segments)
+                    macho_print(macho, "LC_SEGMENT_64 - %s 0x%08"PRIx64" to 0x%08"PRIx64" \n",segment_command_64.segname,
+                                                                    segment_command_64.vmaddr,
+                                                                    segment_command_64.vmaddr + segment_command_64.vmsize);
+                
+                if(print_segments && macho->visitor)
+                    macho_emit_segment(macho, segment_command_64.segname, segment_command_64.vmaddr, segment_command_64.vmsize,
+                                       segment_command_64.fileoff, segment_command_64.filesize);
                 
                 for(int j=1; j<=nsects; j++){
-                    struct section_64 *section = (struct section_64*)macho_get_bytes(sect_offset);
-                    printf("\tSection %d: 0x%08llx to 0x%08llx - %s\n",j,
-                                                               section->addr,
-                                                               section->addr + section->size,
-                                                               section->sectname);
-                    if(strstr("__objc_classlist__DATA",section->sectname)){
-                        macho_parse_objc_64(section->addr,headeroff + section->offset,section->size);
-                    }
+                    struct section_64 *section = (struct section_64*)macho_get_range(macho, sect_offset, sizeof(struct section_64));
                     
-                    if(strstr("__LINKEDIT",section->sectname))
-                    {
-                        // manually look for the LINKEDIT segment so that we can parse information not covered by load commands
-                        // probably a better way to do this semantically but for now this is fine
-                        // don't cover the indirect/direct symbol tables, code signature etc because those are covered by lc's
-                        macho_parse_linkedit(section->addr,headeroff + section->offset, section->size);
+                    if(!section)
+                        break;
+                    
+                    if(print_segments)
+                        macho_print(macho, "\tSection %d: 0x%08"PRIx64" to 0x%08"PRIx64" - %s\n",j,
+                                                                   section->addr,
+                                                                   section->addr + section->size,
+                                                                   section->sectname);
+                    
+                    if(print_segments && macho->visitor)
+                        macho_emit_section(macho, section->segname, section->sectname, section->addr, section->size, section->offset);
+                    
+                    if((parts & MACHO_PART_OBJC) && strstr("__objc_classlist__DATA",section->sectname)){
+                        phase = macho_stats_enter(macho->stats, MACHO_PHASE_OBJC);
+                        macho_parse_objc_64(macho, section->addr,macho->fileoff_base + section->offset,section->size);
+                        macho_stats_leave(macho->stats, phase);
                     }
                     
                     sect_offset += sizeof(struct section_64);
@@ -594,159 +1620,502 @@ void macho_parse_load_commands(mach_header_t header, uint32_t headeroff, bool sw
                 break;
             case LC_LOAD_DYLIB:
                 ;
-                struct dylib_command *dylib_command = (struct dylib_command*)macho_get_bytes(offset);
-                swap(dylib_command,dylib_command,swap);
-                struct dylib dylib = dylib_command->dylib;
-                uint32_t dylib_name_offset = offset + dylib.name.offset;
-                uint32_t name_len = cmdsize - sizeof(dylib_command);
-                char *name = macho_get_bytes(dylib_name_offset);
-                printf("LC_LOAD_DYLIB - %s\n",name);
-                printf("\tVers - %u Timestamp - %u\n",dylib.current_version,dylib.timestamp);
+                struct dylib_command dylib_command;
+                macho_read(macho, offset, &dylib_command, sizeof(struct dylib_command));
+                swap(dylib_command,&dylib_command,swap);
+                struct dylib dylib = dylib_command.dylib;
+                uint64_t dylib_name_offset = offset + dylib.name.offset;
+                char *name = macho_read_string(macho, dylib_name_offset);
+                macho_print(macho, "LC_LOAD_DYLIB - %s\n",name ? name : "");
+                macho_print(macho, "\tVers - %u Timestamp - %u\n",dylib.current_version,dylib.timestamp);
+                
+                macho_emit(macho, dylib, .name = name ? name : "", .current_version = dylib.current_version,
+                           .compatibility_version = dylib.compatibility_version, .timestamp = dylib.timestamp);
                 
                 break;
             case LC_SYMTAB:
                 ;
-                struct symtab_command *symtab_command = (struct symtab_command*)macho_get_bytes(offset);
-                swap(symtab_command,symtab_command,swap);
-                printf("LC_SYMTAB\n");
-                printf("\tSymbol Table is at offset 0x%x (%u) with %u entries \n",symtab_command->symoff,symtab_command->symoff,symtab_command->nsyms);
-                printf("\tString Table is at offset 0x%x (%u) with size of %u bytes\n",symtab_command->stroff,symtab_command->stroff,symtab_command->strsize);
-                
-                macho_print_symtab(header,
-                                   headeroff,
-                                   symtab_command->symoff,
-                                   symtab_command->nsyms,
-                                   symtab_command->stroff,
-                                   symtab_command->strsize);
+                struct symtab_command symtab_command;
+                macho_read(macho, offset, &symtab_command, sizeof(struct symtab_command));
+                swap(symtab_command,&symtab_command,swap);
+                
+                if(parts & MACHO_PART_SYMTAB){
+                    macho_print(macho, "LC_SYMTAB\n");
+                    macho_print(macho, "\tSymbol Table is at offset 0x%x (%u) with %u entries \n",symtab_command.symoff,symtab_command.symoff,symtab_command.nsyms);
+                    macho_print(macho, "\tString Table is at offset 0x%x (%u) with size of %u bytes\n",symtab_command.stroff,symtab_command.stroff,symtab_command.strsize);
+                    
+                    phase = macho_stats_enter(macho->stats, MACHO_PHASE_SYMTAB);
+                    macho_print_symtab(macho, header,
+                                       macho->fileoff_base,
+                                       symtab_command.symoff,
+                                       symtab_command.nsyms,
+                                       symtab_command.stroff,
+                                       symtab_command.strsize);
+                    macho_stats_leave(macho->stats, phase);
+                }
+                
+                if((parts & MACHO_PART_LOOKUPS) && macho->options.num_lookup_addresses){
+                    phase = macho_stats_enter(macho->stats, MACHO_PHASE_LOOKUPS);
+                    macho_print_lookups(macho,
+                                        headeroff,
+                                        symtab_command.symoff,
+                                        symtab_command.nsyms,
+                                        symtab_command.stroff,
+                                        symtab_command.strsize);
+                    macho_stats_leave(macho->stats, phase);
+                }
                 break;
             case LC_DYSYMTAB:
                 ;
-                struct dysymtab_command *dysymtab_command = (struct dysymtab_command*)macho_get_bytes(offset);
-                swap(dysymtab_command,dysymtab_command,swap);
-                printf("LC_DYSYMTAB\n");
-                printf("\t%u local symbols at index %u\n",dysymtab_command->ilocalsym,dysymtab_command->nlocalsym);
-                printf("\t%u external symbols at index %u\n",dysymtab_command->nextdefsym,dysymtab_command->iextdefsym);
-                printf("\t%u undefined symbols at index %u\n",dysymtab_command->nundefsym,dysymtab_command->iundefsym);
-                printf("\t%u Indirect symbols at offset 0x%x\n",dysymtab_command->nindirectsyms,dysymtab_command->indirectsymoff);
+                struct dysymtab_command dysymtab_command;
+                macho_read(macho, offset, &dysymtab_command, sizeof(struct dysymtab_command));
+                swap(dysymtab_command,&dysymtab_command,swap);
+                macho_print(macho, "LC_DYSYMTAB\n");
+                macho_print(macho, "\t%u local symbols at index %u\n",dysymtab_command.ilocalsym,dysymtab_command.nlocalsym);
+                macho_print(macho, "\t%u external symbols at index %u\n",dysymtab_command.nextdefsym,dysymtab_command.iextdefsym);
+                macho_print(macho, "\t%u undefined symbols at index %u\n",dysymtab_command.nundefsym,dysymtab_command.iundefsym);
+                macho_print(macho, "\t%u Indirect symbols at offset 0x%x\n",dysymtab_command.nindirectsyms,dysymtab_command.indirectsymoff);
                 break;
             case LC_MAIN:
                 ;
-                struct entry_point_command *entry_point_command = (struct entry_point_command*)macho_get_bytes(offset);
-                swap(entry_point_command,entry_point_command,swap);
-                printf("LC_MAIN\n");
-                printf("\tEntry point at offset 0x%llx\n",entry_point_command->entryoff);
+                struct entry_point_command entry_point_command;
+                macho_read(macho, offset, &entry_point_command, sizeof(struct entry_point_command));
+                swap(entry_point_command,&entry_point_command,swap);
+                macho_print(macho, "LC_MAIN\n");
+                macho_print(macho, "\tEntry point at offset 0x%"PRIx64"\n",entry_point_command.entryoff);
+                
+                macho_emit(macho, entry_point, .offset = entry_point_command.entryoff);
+                break;
+            
+            case LC_FUNCTION_STARTS:
+                ;
+                uint64_t *function_starts;
+                uint32_t num_function_starts = macho_load_function_starts(macho, &function_starts);
+                
+                macho_print(macho, "LC_FUNCTION_STARTS\n");
+                macho_print(macho, "\t%u functions\n",num_function_starts);
+                
+                for(uint32_t j = 0; j < num_function_starts; j++){
+                    macho_print(macho, "\t\tFunction at 0x%"PRIx64"\n",function_starts[j]);
+                    macho_emit(macho, function, .address = function_starts[j]);
+                }
                 break;
+            case LC_DYLD_INFO:
+            case LC_DYLD_INFO_ONLY:
+                ;
+                struct dyld_info_command dyld_info;
+                macho_read(macho, offset, &dyld_info, sizeof(struct dyld_info_command));
+                swap(dyld_info_command,&dyld_info,swap);
                 
+                macho_print(macho, "%s\n",cmdtype == LC_DYLD_INFO_ONLY ? "LC_DYLD_INFO_ONLY" : "LC_DYLD_INFO");
+                
+                if(parts & MACHO_PART_BINDINGS){
+                    phase = macho_stats_enter(macho->stats, MACHO_PHASE_FIXUPS);
+                    macho_print_dyld_info(macho, &index, &dyld_info, swap);
+                    macho_stats_leave(macho->stats, phase);
+                }
+                
+                if(parts & MACHO_PART_EXPORTS){
+                    phase = macho_stats_enter(macho->stats, MACHO_PHASE_EXPORTS);
+                    macho_print_exports(macho, dyld_info.export_off, dyld_info.export_size);
+                    macho_stats_leave(macho->stats, phase);
+                }
+                break;
+            case LC_DYLD_CHAINED_FIXUPS:
+                macho_print(macho, "LC_DYLD_CHAINED_FIXUPS\n");
+                phase = macho_stats_enter(macho->stats, MACHO_PHASE_FIXUPS);
+                macho_print_chained_fixups(macho, &index, swap);
+                macho_stats_leave(macho->stats, phase);
+                break;
+            case LC_DYLD_EXPORTS_TRIE:
+                ;
+                struct linkedit_data_command exports_trie;
+                macho_read(macho, offset, &exports_trie, sizeof(struct linkedit_data_command));
+                swap(linkedit_data_command,&exports_trie,swap);
+                
+                macho_print(macho, "LC_DYLD_EXPORTS_TRIE\n");
+                phase = macho_stats_enter(macho->stats, MACHO_PHASE_EXPORTS);
+                macho_print_exports(macho, exports_trie.dataoff, exports_trie.datasize);
+                macho_stats_leave(macho->stats, phase);
+                break;
             case LC_CODE_SIGNATURE:
                 ;
                 // looks weird at first, but the code signature load command refers the linkedit_data_command structure
                 // the code signature still points to the code signature and not the LINKEDIT segment
                 // because the code signature is at the end of the linkedit segment
                 // code signatures are going to always be at the end of the file because they can change based on who signs it
-                struct linkedit_data_command *linkedit = (struct linkedit_data_command*)macho_get_bytes(offset);
-                swap(linkedit_data_command,linkedit,swap);
-                uint32_t dataoff = linkedit->dataoff;
-                uint32_t datasize = linkedit->datasize;
+                struct linkedit_data_command linkedit;
+                macho_read(macho, offset, &linkedit, sizeof(struct linkedit_data_command));
+                swap(linkedit_data_command,&linkedit,swap);
+                uint32_t dataoff = linkedit.dataoff;
+                uint32_t datasize = linkedit.datasize;
                 
-                printf("LC_CODE_SIGNATURE\n");
-                macho_parse_code_directory(header, headeroff, swap, dataoff, datasize);
+                macho_print(macho, "LC_CODE_SIGNATURE\n");
+                // the code directory works from the mach header, wherever the load command offsets count from
+                phase = macho_stats_enter(macho->stats, MACHO_PHASE_SIGNATURE);
+                macho_parse_code_directory(macho, header, headeroff, swap, macho->fileoff_base + dataoff - headeroff, datasize);
+                macho_stats_leave(macho->stats, phase);
                 break;
             default:
                 break;
         }
-        
-        offset += cmdsize;
     }
 }
 
-void macho_parse_header(bool swap, uint32_t offset){
-    uint32_t magic = macho_get_magic(offset);
+void macho_parse_header(macho_file *macho, bool swap, uint64_t offset){
+    uint32_t magic = macho_get_magic(macho, offset);
     swap = macho_swapped(magic);
     
-    printf("MACH MAGIC - %x\n",magic);
+    macho_print(macho, "MACH MAGIC - %x\n",magic);
     
     if(macho_64bit(magic)){
-        printf("Mach-O image is 64 bit\n");
-        
-        gmacho_file->is64bit = true;
+        macho_print(macho, "Mach-O image is 64 bit\n");
         
+        macho->is64bit = true;
+    
     } else if(macho_valid(magic)) {
-        printf("Mach-O image is 32 bit\n");
+        macho_print(macho, "Mach-O image is 32 bit\n");
     } else {
-        printf("Invalid Mach-O Magic, exiting...\n");
+        macho_print(macho, "Invalid Mach-O Magic, exiting...\n");
         return;
     }
     
-    mach_header_t header = macho_get_header(offset);
+    mach_header_t header = macho_get_header(macho, offset);
     swap(mach_header,&header,swap);
     
     cpu_type_t cpu_type = header.cputype;
     
-    if(cpu_type == CPU_TYPE_X86_64)
-        gmacho_file->x86 = true;
+    if(!macho->fat && !macho_arch_selected(macho, cpu_type)){
+        macho_print(macho, "Architecture not selected, skipping\n");
+        return;
+    }
+    
+    if(cpu_type == CPU_TYPE_X86_64 || cpu_type == CPU_TYPE_I386)
+        macho->x86 = true;
     if(cpu_type == CPU_TYPE_ARM)
-        gmacho_file->arm = true;
+        macho->arm = true;
     if(cpu_type == CPU_TYPE_ARM64)
-        gmacho_file->arm = true;
+        macho->arm = true;
+    
+    const char *cpu_name = NULL;
     
     for(int i=0; i<NUM_CPUS; i++){
         struct cpu_type_names cpu = cpu_type_names[i];
         if(cpu_type == cpu.cputype){
-            printf("CPU - %s\n",cpu.cpu_name);
+            macho_print(macho, "CPU - %s\n",cpu.cpu_name);
+            cpu_name = cpu.cpu_name;
             
             break;
         }
     }
     
+    macho_emit(macho, image, .cpu = cpu_name, .cputype = cpu_type, .offset = offset);
+    
     int size_header = macho_64bit(magic) ? sizeof(struct mach_header_64) : sizeof(struct mach_header);
-    macho_parse_load_commands(header, offset, swap, offset + size_header, header.ncmds);
+    
+    // disassembly translates addresses through the segments of the image being parsed
+    macho_load_segments(macho, offset);
+    macho_parse_load_commands(macho, header, offset, swap, offset + size_header, header.ncmds);
+    macho_release_image(macho);
+}
+
+bool macho_arch_selected(macho_file *macho, cpu_type_t cputype){
+    if(!macho->options.num_archs)
+        return true;
+    
+    for(uint32_t i = 0; i < macho->options.num_archs; i++){
+        if(macho->options.archs[i] == cputype)
+            return true;
+    }
+    
+    return false;
 }
 
-void macho_parse_fat_header(bool swap, uint32_t offset){
-    fat_header_t header = macho_get_fat_header(0);
+typedef struct{
+    macho_file *macho;
+    uint64_t *offsets;
+    macho_file *slices;
+    macho_stats *stats; // one per slice with --stats, added to the file's after the slices are done
+    char **output;
+    size_t *output_size;
+} fat_slice_job;
+
+// parses one slice on a private copy of the context, everything it prints goes into its own buffer
+static void macho_parse_fat_slice(void *ctx, uint32_t index){
+    fat_slice_job *job = ctx;
+    macho_file *slice = &job->slices[index];
+    
+    *slice = *job->macho;
+    memset(&slice->segment_map, 0, sizeof(macho_segment_map));
+    slice->disassembler = NULL;
+    slice->chained_fixups = NULL;
+    slice->is64bit = false;
+    slice->arm = false;
+    slice->x86 = false;
+    memset(slice->special_slots, 0, sizeof(slice->special_slots));
+    // the slice parses on its own thread, into an arena of its own
+    memset(&slice->arena, 0, sizeof(macho_arena));
+    
+    slice->out = open_memstream(&job->output[index], &job->output_size[index]);
+    
+    if(!slice->out)
+        return;
+    
+    // records are buffered per slice the same way as text, on a writer of their own
+    slice->writer = job->macho->writer ? macho_writer_create(slice->out, job->macho->writer->format) : NULL;
+    
+    if(job->macho->writer && !slice->writer){
+        fclose(slice->out);
+        free(job->output[index]);
+        job->output[index] = NULL;
+        return;
+    }
+    
+    // a library visitor gets the slice's events directly, they only arrive in order when slices run one at a time
+    slice->visitor = slice->writer ? &slice->writer->visitor : job->macho->visitor;
+    slice->stats = job->stats ? &job->stats[index] : NULL;
+    
+    if(slice->stats)
+        macho_stats_start(slice->stats, MACHO_PHASE_HEADERS);
+    
+    macho_parse_header(slice, false, job->offsets[index]);
+    macho_arena_reset(&slice->arena);
+    
+    if(slice->stats)
+        macho_stats_stop(slice->stats);
+    
+    macho_writer_free(slice->writer);
+    fclose(slice->out);
+}
+
+void macho_parse_fat_header(macho_file *macho, bool swap, uint32_t offset){
+    fat_header_t header = macho_get_fat_header(macho, 0);
     swap(fat_header,&header,swap);
     
-    gmacho_file->fat = true;
+    macho->fat = true;
     
-    printf("FAT MAGIC %x\n",header.magic);
+    macho_print(macho, "FAT MAGIC %x\n",header.magic);
     
     uint32_t n_fat = header.nfat_arch;
     
-    printf("Mach-O image is FAT with %u archs\n",n_fat);
-    for(offset = sizeof(fat_header_t);
-        offset < sizeof(fat_header_t) + n_fat * sizeof(fat_arch_t);
-        offset += sizeof(fat_arch_t)){
-        printf("\nImage %d\n\n",(offset-sizeof(fat_header_t))/sizeof(fat_arch_t)+1);
-        
-        fat_arch_t arch = macho_get_fat_arch(offset);
+    macho_print(macho, "Mach-O image is FAT with %u archs\n",n_fat);
+    
+    uint32_t *images = calloc(n_fat ? n_fat : 1, sizeof(uint32_t));
+    uint64_t *offsets = calloc(n_fat ? n_fat : 1, sizeof(uint64_t));
+    uint32_t selected = 0;
+    
+    if(!images || !offsets){
+        free(images);
+        free(offsets);
+        return;
+    }
+    
+    for(uint32_t i = 0; i < n_fat; i++){
+        fat_arch_t arch = macho_get_fat_arch(macho, sizeof(fat_header_t) + i * sizeof(fat_arch_t));
         swapn(fat_arch,&arch,1,swap);
         
-        uint32_t arch_offset = arch.offset;
-        macho_parse_header(swap, arch_offset);
+        if(!macho_arch_selected(macho, arch.cputype))
+            continue;
+        
+        images[selected] = i + 1;
+        offsets[selected] = arch.offset;
+        selected++;
     }
+    
+    // every slice gets its own copy of the context, so nothing a slice sets (is64bit, arm, x86, the special slots)
+    // leaks into the next one and the slices can be parsed side by side
+    // output is buffered per slice and printed in arch order so it reads the same as a serial run
+    fat_slice_job job;
+    
+    job.macho = macho;
+    job.offsets = offsets;
+    job.slices = calloc(selected ? selected : 1, sizeof(macho_file));
+    job.stats = macho->stats ? calloc(selected ? selected : 1, sizeof(macho_stats)) : NULL;
+    job.output = calloc(selected ? selected : 1, sizeof(char*));
+    job.output_size = calloc(selected ? selected : 1, sizeof(size_t));
+    
+    if(job.slices && job.output && job.output_size && (job.stats || !macho->stats)){
+        if(macho->stats)
+            macho_stats_stop(macho->stats);
+        
+        macho_parallel_for_batch(macho->options.slice_threads, selected, 1, macho_parse_fat_slice, &job);
+        
+        if(macho->stats){
+            macho_stats_resume(macho->stats);
+            
+            for(uint32_t i = 0; i < selected; i++)
+                macho_stats_add(macho->stats, &job.stats[i]);
+        }
+        
+        for(uint32_t i = 0; i < selected; i++){
+            macho_print(macho, "\nImage %d\n\n",images[i]);
+            
+            if(!job.output[i])
+                macho_print(macho, "Failed to parse image %u\n",images[i]);
+            else if(macho->writer)
+                macho_writer_append(macho->writer, job.output[i], job.output_size[i]);
+            else if(!macho->visitor)
+                fwrite(job.output[i], 1, job.output_size[i], macho->out);
+            
+            free(job.output[i]);
+        }
+    }
+    
+    free(job.slices);
+    free(job.stats);
+    free(job.output);
+    free(job.output_size);
+    free(images);
+    free(offsets);
 }
 
-void macho_parse(FILE *mach, char *path, size_t size, symbol_table *symbols){
-    gmacho_file = malloc(sizeof(macho_file));
-    char *buf = malloc(size);
-    fseek(mach,0,SEEK_SET);
-    fread(buf,1,size,mach);
-    gmacho_file->path = path;
-    gmacho_file->file = mach;
-    gmacho_file->buffer = buf;
-    gmacho_file->size = size;
-    gmacho_file->symboltable = symbols;
+// lists the images of a dyld shared cache, or parses the one --image names in place
+static void macho_parse_shared_cache(macho_file *macho){
+    macho_shared_cache cache;
+    
+    if(!macho_shared_cache_open(macho, &cache)){
+        macho_print(macho, "Invalid dyld shared cache, exiting...\n");
+        return;
+    }
+    
+    macho_print(macho, "DYLD SHARED CACHE - %s\n", cache.arch);
+    macho_print(macho, "UUID - ");
     
-    uint32_t magic = macho_get_magic(0);
+    for(size_t i = 0; i < sizeof(cache.uuid); i++)
+        macho_print(macho, "%.2x", cache.uuid[i]);
+    
+    macho_print(macho, "\n");
+    
+    if(cache.num_subcaches)
+        macho_print(macho, "Split cache with %u subcaches, only images in this file can be parsed\n", cache.num_subcaches);
+    
+    if(macho->options.image){
+        const macho_shared_cache_image *image = macho_shared_cache_find_image(&cache, macho->options.image);
+        
+        if(!image)
+            macho_print(macho, "No image %s in the cache\n", macho->options.image);
+        else if(image->headeroff == UINT64_MAX)
+            macho_print(macho, "%s is in another file of the cache\n", image->path);
+        else {
+            macho_print(macho, "\nImage %s\n\n", image->path);
+            
+            macho->shared_cache = &cache;
+            macho_parse_header(macho, false, image->headeroff);
+            macho->shared_cache = NULL;
+        }
+        
+        macho_shared_cache_close(&cache);
+        return;
+    }
+    
+    macho_print(macho, "%u mappings\n", cache.num_mappings);
+    
+    for(uint32_t i = 0; i < cache.num_mappings; i++){
+        const macho_shared_cache_mapping *mapping = &cache.mappings[i];
+        
+        macho_print(macho, "\tMapping %u: 0x%"PRIx64" to 0x%"PRIx64" at offset 0x%"PRIx64, i, mapping->address, mapping->address + mapping->size, mapping->fileoff);
+        
+        if(mapping->slide_version)
+            macho_print(macho, " slide info v%u", mapping->slide_version);
+        
+        macho_print(macho, "\n");
+    }
+    
+    macho_print(macho, "%u images\n", cache.num_images);
+    
+    for(uint32_t i = 0; i < cache.num_images; i++)
+        macho_print(macho, "\tImage %u: 0x%"PRIx64" %s\n", i + 1, cache.images[i].address, cache.images[i].path);
+    
+    macho_shared_cache_close(&cache);
+}
+
+void macho_parse_image(macho_file *macho){
+    uint32_t magic = macho_get_magic(macho, 0);
     bool swap = macho_swapped(magic);
     
-    if(macho_fat(magic)){
-        macho_parse_fat_header(swap,0);
+    if(macho_is_shared_cache(macho)){
+        macho_parse_shared_cache(macho);
+    } else if(macho_fat(magic)){
+        macho_parse_fat_header(macho, swap,0);
     } else {
-        macho_parse_header(swap,0);
+        macho_parse_header(macho, swap,0);
+    }
+}
+
+void macho_parse(FILE *mach, char *path, symbol_table *symbols, const macho_options *options, FILE *out){
+    macho_stats stats;
+    // ndjson and binary output has to stay parseable, what can't be said as a record goes to stderr instead
+    FILE *errors = options && options->format != MACHO_FORMAT_TEXT ? stderr : out;
+    
+    // the clock starts before the file is opened so mapping it is counted as well
+    if(options && options->stats)
+        macho_stats_start(&stats, MACHO_PHASE_LOAD);
+    
+    macho_file *macho = macho_open(mach, path, symbols, out);
+    
+    if(!macho){
+        fprintf(errors, "Failed to load %s\n", path);
+        return;
+    }
+    
+    if(options)
+        macho->options = *options;
+    
+    if(macho->options.stats){
+        macho->stats = &stats;
+        macho_stats_enter(macho->stats, MACHO_PHASE_HEADERS);
     }
     
-    free(buf);
-    free(gmacho_file);
-    gmacho_file = NULL;
+    macho->writer = macho_writer_create(out, macho->options.format);
+    
+    if(macho->options.format != MACHO_FORMAT_TEXT && !macho->writer){
+        fprintf(errors, "Failed to allocate the output buffer\n");
+        macho_close(macho);
+        return;
+    }
+    
+    if(macho->writer){
+        macho->visitor = &macho->writer->visitor;
+        macho_record_begin(macho->writer, MACHO_RECORD_FILE);
+        macho_record_string(macho->writer, MACHO_FIELD_PATH, path);
+        macho_record_end(macho->writer);
+    }
+    
+    // a pipe has no identity to key a cache with, and a shared cache is only ever parsed in place
+    if(macho->options.cache_dir && macho->mapped && !macho_is_shared_cache(macho))
+        macho_cache_query(macho, macho->options.cache_dir);
+    else
+        macho_parse_image(macho);
+    
+    macho_writer_free(macho->writer);
+    macho->writer = NULL;
+    
+    if(macho->stats)
+        macho_stats_report(macho->stats, path, macho->options.stats, stderr);
+    
+    macho_close(macho);
+}
+
+bool macho_parse_visit(FILE *file, const char *path, const macho_options *options, const macho_visitor *visitor){
+    macho_file *macho = macho_open(file, path, NULL, NULL);
+    
+    if(!macho)
+        return false;
+    
+    if(options)
+        macho->options = *options;
+    
+    // callbacks come one at a time on this thread, in the same order the text would have been printed
+    macho->options.slice_threads = 1;
+    macho->options.format = MACHO_FORMAT_TEXT;
+    macho->visitor = visitor;
+    
+    if(macho->options.cache_dir && macho->mapped && !macho_is_shared_cache(macho))
+        macho_cache_query(macho, macho->options.cache_dir);
+    else
+        macho_parse_image(macho);
+    
+    macho_close(macho);
+    
+    return true;
 }
@@ -1,5 +1,7 @@
 #include <mach-o/loader.h>
 #include "parser.h"
+#include "export_trie.h"
+#include "symindex.h"
 
 #ifndef __macho_h
 #define __macho_h
@@ -17,7 +19,7 @@ struct cpu_type_names {
 
 #define NUM_CPUS 4
 
-static struct cpu_type_names cpu_type_names[] = {
+static const struct cpu_type_names cpu_type_names[] = {
     {CPU_TYPE_I386,        "i386"},
     {CPU_TYPE_X86_64,    "x86_64"},
     {CPU_TYPE_ARM,        "arm"},
@@ -82,8 +84,78 @@ typedef struct code_directory {
 
 
 
-void macho_parse(FILE *file, char *path, size_t size, symbol_table *symbols);
-// file to be processed, path of the file, size of the file, and symbols to find in file
+bool macho_fat(uint32_t magic);
+bool macho_32bit(uint32_t magic);
+bool macho_64bit(uint32_t magic);
+
+// disassembles the function at a virtual address of the current image, up to the next symbol or function start
+void macho_disassemble_code(macho_file *macho, mach_vm_address_t address);
+// bounds functions with these symbols and function starts instead of reading them out of the current image
+// they're used in place and have to stay valid until the image is released
+void macho_set_function_bounds(macho_file *macho, const macho_symbol_index *symbols, const uint64_t *starts, uint32_t count);
+
+// makes the image at headeroff current: loads its segment map and drops the previous image's disassembly state
+bool macho_load_segments(macho_file *macho, uint64_t headeroff);
+void macho_release_image(macho_file *macho);
+
+// decodes LC_FUNCTION_STARTS of the current image into *starts (in the image's arena), returns the count
+uint32_t macho_load_function_starts(macho_file *macho, uint64_t **starts);
+
+// finds the export trie of the current image in LC_DYLD_EXPORTS_TRIE or LC_DYLD_INFO, false if it has none
+bool macho_load_export_trie(macho_file *macho, macho_export_trie *trie);
+
+// the segment that maps the mach header, __TEXT, which linkedit offsets and deltas are relative to
+const macho_segment* macho_header_segment(macho_file *macho);
+
+// the address a pointer of the current image stored at address really holds, raw is what's in the file
+// chained fixups are decoded into a table on the first call, images without them get raw back unchanged
+// binds to other images resolve to 0, in a shared cache the slide info of the pointer's mapping is undone instead
+uint64_t macho_resolve_pointer(macho_file *macho, uint64_t address, uint64_t raw);
+
+// segment of the current image containing address, NULL if none does. O(log n) and O(1) when the
+// previous lookup was in the same segment
+const macho_segment* macho_find_segment(macho_file *macho, uint64_t address);
+
+// size bytes at a virtual address of the current image (or of its shared cache), NULL if they aren't all backed by the file
+const void* macho_address_bytes(macho_file *macho, uint64_t address, size_t size);
+
+// file offset -> virtual address in the current image, false if no segment maps it
+bool macho_offset_to_address(macho_file *macho, uint64_t offset, uint64_t *address);
+
+typedef struct{
+    uint32_t cmd;
+    uint64_t offset; // from the start of the file
+    uint32_t size;
+} macho_load_command_entry;
+
+// every load command of one image in file order, built by reading just the command headers
+typedef struct{
+    macho_load_command_entry *commands;
+    uint32_t count;
+} macho_load_command_index;
+
+// the commands come from the image's arena, they're dropped along with the image
+bool macho_load_command_index_build(macho_file *macho, macho_load_command_index *index, bool swap, uint64_t offset, uint32_t ncmds);
+
+// next command of type cmd after the given entry, pass NULL to start from the first one
+const macho_load_command_entry* macho_find_load_command(const macho_load_command_index *index, uint32_t cmd, const macho_load_command_entry *after);
+
+// whether --arch asked for slices of this cpu type
+bool macho_arch_selected(macho_file *macho, cpu_type_t cputype);
+
+// dumps the image at offset, a thin mach-o or one slice of a fat file or of a shared cache
+void macho_parse_header(macho_file *macho, bool swap, uint64_t offset);
+
+void macho_parse_image(macho_file *macho);
+// parses an image opened with macho_open, safe to call concurrently on different images
+
+void macho_parse(FILE *file, char *path, symbol_table *symbols, const macho_options *options, FILE *out);
+// file to be processed, path of the file, symbols to find in file, options (NULL for the defaults) and where to print
+// the file is mmap'd when possible, otherwise (e.g. a pipe) it is read onto the heap
+
+bool macho_parse_visit(FILE *file, const char *path, const macho_options *options, const macho_visitor *visitor);
+// the library entry point: parses file like macho_parse but prints nothing, everything found goes to visitor instead
+// options.parts still picks what gets walked, fat slices are parsed one after another, false if the file couldn't be loaded
 
 #endif
 
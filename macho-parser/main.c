@@ -2,49 +2,210 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "mach-o.h"
+#include "scan.h"
+
+static void usage(const char *name){
+    printf("Usage: %s [options] <file|directory|-> [symbols...]\n", name);
+    printf("\t--only=PARTS\t\tonly parse the listed parts: segments,objc,dylibs,symtab,dysymtab,main,signature,functions,bindings,exports\n");
+    printf("\t--bindings\t\talso print every rebase and bind fixup from LC_DYLD_INFO\n");
+    printf("\t--exports\t\talso list the export trie and look the symbols up in it\n");
+    printf("\t--arch=ARCHS\t\tonly parse the slices of these architectures, e.g. arm64,x86_64\n");
+    printf("\t--slice-threads=N\tparse the slices of a fat binary on N threads (0 = every cpu, the default)\n");
+    printf("\t--verify-threads=N\tverify code signature pages on N threads (0 = every cpu) and report pages/s\n");
+    printf("\t--lookup=FILE\t\tsymbolicate the addresses listed in FILE (one per line, hex or decimal)\n");
+    printf("\t--cache=DIR\t\tanswer the symbol and address queries from a cache kept in DIR, building it on the first run\n");
+    printf("\t--image=NAME\t\tparse this image of a dyld shared cache (install name or file name) instead of listing them\n");
+    printf("\t--scan-threads=N\tparse the files under a directory on N threads (0 = every cpu, the default)\n");
+    printf("\t--format=FORMAT\t\ttext (the default), ndjson or binary records, see output.h\n");
+    printf("\t--stats[=FORMAT]\ttime each phase and count the work done per file, as a table (the default) or json on stderr\n");
+    printf("\t--window=MB\t\tkeep at most about MB megabytes of the file resident, for images too large to map whole\n");
+}
+
+// maps a comma separated list of architecture names onto cpu types
+static bool parse_archs(const char *list, macho_options *options){
+    while(*list){
+        size_t length = strcspn(list, ",");
+        bool known = false;
+        
+        for(int i = 0; i < NUM_CPUS && options->num_archs < MACHO_MAX_ARCHS; i++){
+            if(strlen(cpu_type_names[i].cpu_name) == length && strncmp(list, cpu_type_names[i].cpu_name, length) == 0){
+                options->archs[options->num_archs++] = cpu_type_names[i].cputype;
+                known = true;
+                break;
+            }
+        }
+        
+        if(!known)
+            return false;
+        
+        list += length;
+        
+        if(*list == ',')
+            list++;
+    }
+    
+    return true;
+}
+
+// reads one address per line, anything that doesn't parse as a number is skipped
+static uint64_t* read_addresses(const char *path, size_t *count){
+    FILE *file = fopen(path, "r");
+    uint64_t *addresses = NULL;
+    size_t capacity = 0;
+    char line[128];
+    
+    *count = 0;
+    
+    if(!file)
+        return NULL;
+    
+    while(fgets(line, sizeof(line), file)){
+        char *end;
+        uint64_t address = strtoull(line, &end, 0);
+        
+        if(end == line)
+            continue;
+        
+        if(*count == capacity){
+            capacity = capacity ? capacity * 2 : 64;
+            
+            uint64_t *grown = realloc(addresses, capacity * sizeof(uint64_t));
+            
+            if(!grown)
+                break;
+            
+            addresses = grown;
+        }
+        
+        addresses[(*count)++] = address;
+    }
+    
+    fclose(file);
+    
+    return addresses;
+}
 
 int main(int argc, const char * argv[]) {
+    // options -> every argument starting with -- before the file name
     // arg 1 -> name of file to be processed, expectedly a macho file
     // arg 1 + n -> name of a symbol to be processed/disassembled
     // if symbol is found in objc metadata specify by using CLASSNAME-METHOD
+    // a file name of - reads the image from stdin
     
-    FILE *mach = fopen(argv[1],"rb");
-    // symbol table is list of symbols to be disassembled
-    symbol_table *symbol_table = NULL;
+    macho_options options = MACHO_DEFAULT_OPTIONS;
+    uint64_t *lookup_addresses = NULL;
+    // --only replaces the default parts and --bindings/--exports add to them, in whatever order they're given
+    uint32_t only = options.parts;
+    uint32_t extra_parts = 0;
+    int arg = 1;
     
-    if(!mach){
-        printf("File not found\n");
+    for(; arg < argc && strncmp(argv[arg],"--",2) == 0; arg++){
+        const char *option = argv[arg];
+        
+        if(strncmp(option,"--only=",7) == 0){
+            if(!macho_parse_parts(option + 7, &only)){
+                usage(argv[0]);
+                return 0;
+            }
+        } else if(strcmp(option,"--bindings") == 0){
+            extra_parts |= MACHO_PART_BINDINGS;
+        } else if(strcmp(option,"--exports") == 0){
+            extra_parts |= MACHO_PART_EXPORTS;
+        } else if(strncmp(option,"--arch=",7) == 0){
+            if(!parse_archs(option + 7, &options)){
+                printf("Unknown architecture in %s\n", option + 7);
+                return 0;
+            }
+        } else if(strncmp(option,"--slice-threads=",16) == 0){
+            options.slice_threads = (uint32_t)strtoul(option + 16, NULL, 10);
+        } else if(strncmp(option,"--verify-threads=",17) == 0){
+            options.verify_threads = (uint32_t)strtoul(option + 17, NULL, 10);
+            options.verify_stats = true;
+        } else if(strncmp(option,"--scan-threads=",15) == 0){
+            options.scan_threads = (uint32_t)strtoul(option + 15, NULL, 10);
+        } else if(strncmp(option,"--format=",9) == 0){
+            if(!macho_parse_format(option + 9, &options.format)){
+                usage(argv[0]);
+                return 0;
+            }
+        } else if(strcmp(option,"--stats") == 0){
+            options.stats = MACHO_STATS_TABLE;
+        } else if(strncmp(option,"--stats=",8) == 0){
+            if(!macho_parse_stats_format(option + 8, &options.stats)){
+                usage(argv[0]);
+                return 0;
+            }
+        } else if(strncmp(option,"--image=",8) == 0){
+            options.image = option + 8;
+        } else if(strncmp(option,"--window=",9) == 0){
+            options.window_size = strtoull(option + 9, NULL, 10) << 20;
+        } else if(strncmp(option,"--cache=",8) == 0){
+            options.cache_dir = option + 8;
+        } else if(strncmp(option,"--lookup=",9) == 0){
+            free(lookup_addresses);
+            lookup_addresses = read_addresses(option + 9, &options.num_lookup_addresses);
+            options.lookup_addresses = lookup_addresses;
+            
+            if(!lookup_addresses){
+                printf("Could not read addresses from %s\n", option + 9);
+                return 0;
+            }
+        } else {
+            usage(argv[0]);
+            return 0;
+        }
+    }
+    
+    if(arg >= argc){
+        usage(argv[0]);
         return 0;
     }
     
-    fseek(mach,0,SEEK_END);
-    size_t size = ftell(mach);
-    fseek(mach,0,SEEK_SET);
+    options.parts = only | extra_parts;
     
-    // populate the list if the number of arguments is greater than 1
-    if(argc > 2)
-    {
-        symbol_table = malloc(sizeof(symbol_table));
-        
-        int argcount = argc - 2;
-        symbol_table->symbols = malloc(argcount);
-        symbol_table->num_symbols = argcount;
+    // asking for lookups implies reading the symbol table they're answered from
+    if(options.num_lookup_addresses)
+        options.parts |= MACHO_PART_LOOKUPS;
+    
+    const char *path = argv[arg];
+    // symbol table is list of symbols to be disassembled
+    symbol_table *symbol_table = NULL;
+    struct stat st;
+    
+    // populate the list if any symbols follow the file name
+    if(argc > arg + 1)
+        symbol_table = macho_symbol_table_create(&argv[arg + 1], argc - arg - 1);
+    
+    // a directory is walked and every mach-o under it parsed, the symbols are looked for in each of them
+    if(strcmp(path,"-") != 0 && stat(path, &st) == 0 && S_ISDIR(st.st_mode)){
+        if(!macho_scan_directory(path, symbol_table, &options, stdout))
+            printf("Could not read directory %s\n", path);
         
-        int index = 0;
+        macho_symbol_table_free(symbol_table);
+        free(lookup_addresses);
         
-        while(argcount)
-        {
-            char *symbol = strdup(argv[argcount-- + 1]);
-            
-            symbol_table->symbols[index++] = symbol;
-            
-        }
+        return 0;
+    }
+    
+    FILE *mach = strcmp(path,"-") == 0 ? stdin : fopen(path,"rb");
+    
+    if(!mach){
+        printf("File not found\n");
+        macho_symbol_table_free(symbol_table);
+        free(lookup_addresses);
+        return 0;
     }
     
     // parse all the load commands, segments, objc metadata, multiple architectures, etc
-    macho_parse(mach, argv[1] ,size, symbol_table);
-    fclose(mach);
+    macho_parse(mach, (char*)path, symbol_table, &options, stdout);
+    
+    if(mach != stdin)
+        fclose(mach);
+    
+    macho_symbol_table_free(symbol_table);
+    free(lookup_addresses);
     
     return 0;
 }
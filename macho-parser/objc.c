@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stddef.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
@@ -8,176 +9,287 @@
 #include "mach-o.h"
 #include "objc.h"
 
-extern void macho_disassemble_code(mach_vm_address_t offset);
-
-void macho_parse_objc_methods(const char *classname, mach_vm_address_t diff, uint64_t offset, uint64_t n, bool metaclass){
-    uint64_t off = offset + sizeof(struct _objc_2_class_method_info);
-    
-    printf("\t\t\tMethods\n");
-    
-    for(int i=0; i<n; i++){
-        struct _objc_method *method = macho_get_bytes((uint32_t)off);
-        char *methodname = macho_read_string((uint64_t)method->name - diff);
-        
-        bool found = false;
-        
-        if(gmacho_file->symboltable)
-        {
-            char **symbols = gmacho_file->symboltable->symbols;
-            uint32_t num_symbols = gmacho_file->symboltable->num_symbols;
-            
-            for(int j=0; j<num_symbols; j++)
-            {
-                char *symbolclassname;
-                char *symbolmethodname;
-                
-                char *symbol = strdup(symbols[j]);
-                
-                char **res = NULL;
-                uint32_t num_tokens = 0;
-                
-                char *tmp = NULL;
-                
-                tmp = strtok(symbol, "-");
-                
-                while (tmp) {
-                    
-                    res = realloc (res, sizeof (char*) * ++num_tokens);
-                    
-                    if (res == NULL)
-                        break;
-                    
-                    res[num_tokens-1] = tmp;
-                    
-                    tmp = strtok (NULL, "-");
-                    
-                }
-                
-                if(num_tokens == 2)
-                {
-                    symbolclassname = res[0];
-                    symbolmethodname = res[1];
-                    
-                    if(strcmp(classname,symbolclassname) == 0 &&
-                       strcmp(methodname,symbolmethodname) == 0)
-                    {
-                        found = true;
-                    }
-                }
-            }
-        }
+// the low bits of class_t.data are flags (Swift sets them), the class_ro_t pointer is the rest
+#define MACHO_OBJC_DATA_MASK (~(uint64_t)0x7)
+
+// reads the pointer stored at address, 0 when address isn't backed by the file
+// every pointer goes through the image's chained fixups, so arm64e and other chained images decode too
+static uint64_t macho_objc_pointer(macho_file *macho, uint64_t address){
+    const void *bytes = macho_address_bytes(macho, address, sizeof(uint64_t));
+    uint64_t raw;
+    
+    if(!bytes)
+        return 0;
+    
+    memcpy(&raw, bytes, sizeof(uint64_t));
+    
+    return macho_resolve_pointer(macho, address, raw);
+}
+
+// the string at address, empty if it isn't in the file or runs off its end
+static const char* macho_objc_string(macho_file *macho, uint64_t address){
+    const char *string = macho_address_bytes(macho, address, 1);
+    
+    if(!string || !memchr(string, '\0', macho->size - (size_t)(string - macho->buffer)))
+        return "";
+    
+    return string;
+}
+
+// method lists keep flags in the top half and low bits of entrySize, ivar and property lists have none
+#define MACHO_OBJC_METHOD_LIST_FLAGS 0xffff0003
+// relative method lists hold struct _objc_2_class_relative_method entries, the norm in current arm64 and arm64e images
+#define MACHO_OBJC_METHOD_LIST_RELATIVE 0x80000000
+// set in the shared cache, whose relative method names lead to the selector string instead of its reference
+#define MACHO_OBJC_METHOD_LIST_DIRECT_SELECTORS 0x40000000
+
+typedef struct{
+    uint64_t entries; // address of the first entry
+    uint32_t count;
+    uint32_t entsize; // with the flags masked off
+    uint32_t flags;
+} macho_objc_list;
+
+// reads the list header at address. the count is capped so every entry lies inside the file data of the segment
+// holding the list, a corrupt count would otherwise walk billions of entries past its end
+// false if the header isn't in the file or its entry size is 0
+static bool macho_objc_list_read(macho_file *macho, uint64_t address, uint32_t flagmask, macho_objc_list *list){
+    // method, ivar and property lists all start with entrySize and count
+    const struct _objc_2_class_method_info *info = macho_address_bytes(macho, address, sizeof(struct _objc_2_class_method_info));
+    
+    if(!info || !(info->entrySize & ~flagmask))
+        return false;
+    
+    list->entries = address + sizeof(struct _objc_2_class_method_info);
+    list->count = info->count;
+    list->entsize = info->entrySize & ~flagmask;
+    list->flags = info->entrySize & flagmask;
+    
+    // what's left of the file past the header, and of the segment when the list is in one of this image's
+    uint64_t available = macho->size - (uint64_t)((const char*)(info + 1) - macho->buffer);
+    const macho_segment *segment = macho_segment_map_find(&macho->segment_map, address);
+    
+    if(segment){
+        uint64_t used = list->entries - segment->vmaddr;
+        uint64_t left = segment->filesize > used ? segment->filesize - used : 0;
+        
+        if(left < available)
+            available = left;
+    }
+    
+    if(list->count > available / list->entsize)
+        list->count = (uint32_t)(available / list->entsize);
+    
+    return true;
+}
+
+// a method list with an entry size its kind of entry doesn't have can't be decoded, it's skipped
+static bool macho_objc_method_list_read(macho_file *macho, uint64_t address, macho_objc_list *list){
+    if(!macho_objc_list_read(macho, address, MACHO_OBJC_METHOD_LIST_FLAGS, list))
+        return false;
+    
+    if(list->flags & MACHO_OBJC_METHOD_LIST_RELATIVE)
+        return list->entsize == sizeof(struct _objc_2_class_relative_method);
+    
+    return list->entsize == sizeof(struct _objc_method);
+}
+
+// the name of the method entry at address and its implementation in imp, 0 if it has none
+static const char* macho_objc_method(macho_file *macho, const macho_objc_list *list, uint64_t method, uint64_t *imp){
+    if(!(list->flags & MACHO_OBJC_METHOD_LIST_RELATIVE)){
+        *imp = macho_objc_pointer(macho, method + offsetof(struct _objc_method, offset));
+        
+        return macho_objc_string(macho, macho_objc_pointer(macho, method + offsetof(struct _objc_method, name)));
+    }
+    
+    const void *bytes = macho_address_bytes(macho, method, sizeof(struct _objc_2_class_relative_method));
+    struct _objc_2_class_relative_method relative;
+    
+    *imp = 0;
+    
+    if(!bytes)
+        return "";
+    
+    memcpy(&relative, bytes, sizeof(relative));
+    
+    if(relative.imp)
+        *imp = method + offsetof(struct _objc_2_class_relative_method, imp) + (int64_t)relative.imp;
+    
+    uint64_t name = method + offsetof(struct _objc_2_class_relative_method, name) + (int64_t)relative.name;
+    
+    // outside the shared cache the name leads to a selector reference, which is a pointer like any other
+    if(!(list->flags & MACHO_OBJC_METHOD_LIST_DIRECT_SELECTORS))
+        name = macho_objc_pointer(macho, name);
+    
+    return macho_objc_string(macho, name);
+}
+
+void macho_parse_objc_methods(macho_file *macho, const char *classname, uint64_t address, bool metaclass){
+    macho_objc_list list;
+    
+    macho_print(macho, "\t\t\tMethods\n");
+    
+    if(!macho_objc_method_list_read(macho, address, &list))
+        return;
+    
+    uint64_t method = list.entries;
+    
+    macho_count(macho, MACHO_COUNTER_METHODS, list.count);
+    
+    // classes nobody asked about skip the matching entirely
+    const macho_hash_table *queried = macho_objc_class_queries(macho->symboltable, classname);
+    
+    for(uint32_t i=0; i<list.count; i++){
+        uint64_t imp;
+        const char *methodname = macho_objc_method(macho, &list, method, &imp);
+        
+        bool found = queried && macho_hash_lookup(queried, methodname) != NULL;
         
         if(metaclass)
-            printf("\t\t\t\t0x%08llx: +%s\n",method->offset,methodname);
+            macho_print(macho, "\t\t\t\t0x%08"PRIx64": +%s\n",imp,methodname);
         else
-            printf("\t\t\t\t0x%08llx: -%s\n",method->offset,methodname);
+            macho_print(macho, "\t\t\t\t0x%08"PRIx64": -%s\n",imp,methodname);
+        
+        macho_emit(macho, objc_method, .classname = classname, .name = methodname, .imp = imp, .metaclass = metaclass);
         
         if(found)
-            macho_disassemble_code(method->offset);
+            macho_disassemble_code(macho, imp);
         
-        off += sizeof(struct _objc_method);
+        method += list.entsize;
     }
 }
 
-void macho_parse_objc_properties(const char *classname, mach_vm_address_t diff, uint64_t offset, uint64_t n){
-    uint64_t off = offset + sizeof(struct _objc_2_class_property_info);
+void macho_parse_objc_properties(macho_file *macho, const char *classname, uint64_t address){
+    macho_objc_list list;
+    
+    macho_print(macho, "\t\t\tProperties\n");
     
-    printf("\t\t\tProperties\n");
+    if(!macho_objc_list_read(macho, address, 0, &list) || list.entsize < sizeof(struct _objc_2_class_property))
+        return;
     
-    for(int i=0; i<n; i++){
-        struct _objc_2_class_property *property = macho_get_bytes((uint32_t)off);
-        char *propertyname = macho_read_string((uint64_t)property->name - diff);
-        char *attributes = macho_read_string((uint64_t)property->attributes - diff);
+    uint64_t property = list.entries;
+    
+    for(uint32_t i=0; i<list.count; i++){
+        const char *propertyname = macho_objc_string(macho, macho_objc_pointer(macho, property + offsetof(struct _objc_2_class_property, name)));
+        const char *attributes = macho_objc_string(macho, macho_objc_pointer(macho, property + offsetof(struct _objc_2_class_property, attributes)));
+        
+        macho_print(macho, "\t\t\t\t%s %s\n",attributes,propertyname);
         
-        printf("\t\t\t\t%s %s\n",attributes,propertyname);
+        macho_emit(macho, objc_property, .classname = classname, .name = propertyname, .attributes = attributes);
         
-        off += sizeof(struct _objc_2_class_property);
+        property += list.entsize;
     }
 }
 
-void macho_parse_objc_ivars(const char *classname, mach_vm_address_t diff, uint64_t offset, uint64_t n){
-    uint64_t off = offset + sizeof(struct _objc_2_class_ivar_info);
+void macho_parse_objc_ivars(macho_file *macho, const char *classname, uint64_t address){
+    macho_objc_list list;
     
-    printf("\t\t\tIvars\n");
+    macho_print(macho, "\t\t\tIvars\n");
     
-    for(int i=0; i<n; i++){
-        struct _objc_ivar *ivar = macho_get_bytes((uint32_t)off);
-        char *ivarname = macho_read_string((uint64_t)ivar->name - diff);
+    if(!macho_objc_list_read(macho, address, 0, &list) || list.entsize < sizeof(struct _objc_2_class_ivar))
+        return;
+    
+    uint64_t ivar = list.entries;
+    
+    for(uint32_t i=0; i<list.count; i++){
+        uint64_t ivaroffset = macho_objc_pointer(macho, ivar + offsetof(struct _objc_ivar, offset));
+        const char *ivarname = macho_objc_string(macho, macho_objc_pointer(macho, ivar + offsetof(struct _objc_ivar, name)));
+        
+        macho_print(macho, "\t\t\t\t0x%08"PRIx64": %s\n",ivaroffset,ivarname);
         
-        printf("\t\t\t\t0x%08llx: %s\n",ivar->offset,ivarname);
+        macho_emit(macho, objc_ivar, .classname = classname, .name = ivarname, .offset = ivaroffset);
         
-        off += sizeof(struct _objc_ivar);
+        ivar += list.entsize;
     }
 }
 
-void macho_parse_objc_class(mach_vm_address_t diff, struct _objc_2_class *class, bool metaclass){
-    uint64_t dataptr = (uint64_t)class->data;
-    uint64_t dataoff = dataptr - diff;
+void macho_parse_objc_class(macho_file *macho, uint64_t class, bool metaclass){
+    uint64_t data = macho_objc_pointer(macho, class + offsetof(struct _objc_2_class, data)) & MACHO_OBJC_DATA_MASK;
     
-    struct _objc_2_class_data *data = (struct _objc_2_class_data*)macho_get_bytes((uint32_t)dataoff);
-    
-    char *name = macho_read_string(data->name - diff);
+    const char *name = macho_objc_string(macho, macho_objc_pointer(macho, data + offsetof(struct _objc_2_class_data, name)));
     
     if(metaclass)
-        printf("\t\t$OBJC_METACLASS_%s\n",name);
+        macho_print(macho, "\t\t$OBJC_METACLASS_%s\n",name);
     else
-        printf("\t\t$OBJC_CLASS_%s\n",name);
+        macho_print(macho, "\t\t$OBJC_CLASS_%s\n",name);
     
-    uint64_t ivarinfoptr = data->ivars;
+    macho_emit(macho, objc_class, .name = name, .metaclass = metaclass);
+    macho_count(macho, MACHO_COUNTER_CLASSES, 1);
     
-    if(ivarinfoptr){
-        uint64_t ivarinfooff = ivarinfoptr - diff;
-        struct _objc_2_class_ivar_info *ivar_info = (struct _objc_2_class_ivar_info*)macho_get_bytes((uint32_t)ivarinfooff);
-        uint64_t ivarcount = ivar_info->count;
-        
-        macho_parse_objc_ivars(name,diff,ivarinfooff,ivarcount);
-    }
+    uint64_t ivars = macho_objc_pointer(macho, data + offsetof(struct _objc_2_class_data, ivars));
     
-    uint64_t propertyinfoptr = data->properties;
+    if(ivars)
+        macho_parse_objc_ivars(macho, name, ivars);
     
-    if(propertyinfoptr){
-        uint64_t propertyinfooff = propertyinfoptr - diff;
-        struct _objc_2_class_property_info *property_info = (struct _objc_2_class_property_info*)macho_get_bytes((uint32_t)propertyinfooff);
-        uint64_t propertycount = property_info->count;
-        
-        macho_parse_objc_properties(name,diff,propertyinfooff,propertycount);
-    }
+    uint64_t properties = macho_objc_pointer(macho, data + offsetof(struct _objc_2_class_data, properties));
     
-    uint64_t methodinfoptr = data->methods;
+    if(properties)
+        macho_parse_objc_properties(macho, name, properties);
     
-    if(methodinfoptr){
-        uint64_t methodinfooff = methodinfoptr - diff;
-        struct _objc_2_class_method_info *method_info = (struct _objc_2_class_method_info*)macho_get_bytes((uint32_t)methodinfooff);
+    uint64_t methods = macho_objc_pointer(macho, data + offsetof(struct _objc_2_class_data, methods));
+    
+    if(methods)
+        macho_parse_objc_methods(macho, name, methods, metaclass);
+}
+
+                           
+void macho_parse_objc_64(macho_file *macho, mach_vm_address_t addr, uint64_t offset, uint64_t size){
+    uint64_t sect_end = addr + size;
+    macho_print(macho, "\tProcessing Objective C Segment at offset 0x%"PRIx64"\n",offset);
+    
+    // every pointer is followed by address through the segment map, so classes, their data and their strings
+    // can live in any segment
+    for(; addr + sizeof(uint64_t) <= sect_end; addr += sizeof(uint64_t)){
+        uint64_t class = macho_objc_pointer(macho, addr);
         
-        uint64_t methodcount = method_info->count;
+        macho_parse_objc_class(macho, class, false);
         
-        macho_parse_objc_methods(name,diff,methodinfooff,methodcount,metaclass);
+        uint64_t metaclass = macho_objc_pointer(macho, class + offsetof(struct _objc_2_class, isa));
+        
+        macho_parse_objc_class(macho, metaclass, true);
     }
+
 }
 
-                           
-void macho_parse_objc_64(mach_vm_address_t addr, uint64_t offset, uint64_t size){
-    uint64_t *buffer = (uint64_t*)gmacho_file->buffer;
-    uint64_t diff = addr - offset;
-    uint64_t sect_end = offset + size;
-    printf("\tProcessing Objective C Segment at offset 0x%llx\n",offset);
+static void macho_visit_objc_class(macho_file *macho, uint64_t class, bool metaclass, macho_objc_method_visitor visitor, void *ctx){
+    uint64_t data = macho_objc_pointer(macho, class + offsetof(struct _objc_2_class, data)) & MACHO_OBJC_DATA_MASK;
     
-    while(offset < sect_end){
-        
-        uint64_t classptr = *(buffer + offset/sizeof(uint64_t));
-        uint64_t classoff = classptr - diff;
+    const char *name = macho_objc_string(macho, macho_objc_pointer(macho, data + offsetof(struct _objc_2_class_data, name)));
+    
+    visitor(ctx, name, NULL, 0, metaclass);
+    
+    uint64_t methods = macho_objc_pointer(macho, data + offsetof(struct _objc_2_class_data, methods));
+    
+    if(!methods)
+        return;
+    
+    macho_objc_list list;
+    
+    if(!macho_objc_method_list_read(macho, methods, &list))
+        return;
+    
+    uint64_t method = list.entries;
+    
+    for(uint32_t i = 0; i < list.count; i++){
+        uint64_t imp;
+        const char *methodname = macho_objc_method(macho, &list, method, &imp);
         
-        struct _objc_2_class *class = (struct _objc_2_class*)macho_get_bytes((uint32_t)classoff);
+        visitor(ctx, name, methodname, imp, metaclass);
         
-        macho_parse_objc_class(diff,class,false);
+        method += list.entsize;
+    }
+}
+
+void macho_visit_objc_64(macho_file *macho, mach_vm_address_t addr, uint64_t offset, uint64_t size, macho_objc_method_visitor visitor, void *ctx){
+    uint64_t sect_end = addr + size;
+    
+    for(; addr + sizeof(uint64_t) <= sect_end; addr += sizeof(uint64_t)){
+        uint64_t class = macho_objc_pointer(macho, addr);
         
-        uint64_t metaclassptr = class->isa;
-        uint64_t metaclassoff = metaclassptr - diff;
-        struct _objc_2_class *metaclass = (struct _obj_2_class*)macho_get_bytes((uint32_t)metaclassoff);
+        macho_visit_objc_class(macho, class, false, visitor, ctx);
         
-        macho_parse_objc_class(diff,metaclass,true);
+        uint64_t metaclass = macho_objc_pointer(macho, class + offsetof(struct _objc_2_class, isa));
         
-        offset += sizeof(uint64_t);
+        macho_visit_objc_class(macho, metaclass, true, visitor, ctx);
     }
-    
 }
@@ -92,6 +92,13 @@ struct _objc_2_class_method {
     uint64_t imp;
 };
 
+// an entry of a relative method list, each field an offset from its own address
+struct _objc_2_class_relative_method {
+    int32_t name;  // to the selector reference, or to the selector itself with direct selectors
+    int32_t type;
+    int32_t imp;   // 0 if the method has no implementation
+};
+
 struct _objc_2_class_protocol {
     uint64_t isa;
     uint64_t name;
@@ -142,4 +149,13 @@ struct _objc_2_class {
     struct _objc_2_class_data *data;
 };
 
+// addr and size are the __objc_classlist section, offset where it is in the file
+void macho_parse_objc_64(macho_file *macho, mach_vm_address_t addr, uint64_t offset, uint64_t size);
+
+// called once per class with a NULL methodname, then once for every method of that class
+typedef void (*macho_objc_method_visitor)(void *ctx, const char *classname, const char *methodname, uint64_t imp, bool metaclass);
+
+// walks the same class list as macho_parse_objc_64 without printing anything
+void macho_visit_objc_64(macho_file *macho, mach_vm_address_t addr, uint64_t offset, uint64_t size, macho_objc_method_visitor visitor, void *ctx);
+
 #endif
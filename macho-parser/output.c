@@ -0,0 +1,446 @@
+#include <stdlib.h>
+#include <string.h>
+#include <mach-o/loader.h>
+#include "output.h"
+
+static const char *macho_record_names[MACHO_NUM_RECORDS] = {
+    "file", "image", "segment", "section", "dylib", "symbol", "objc_class", "objc_method",
+    "objc_ivar", "objc_property", "entry_point", "function", "fixup", "export", "lookup"
+};
+
+static const char *macho_field_names[MACHO_NUM_FIELDS] = {
+    "path", "name", "cpu", "offset", "address", "size", "segment", "type", "value", "class", "meta",
+    "imp", "attributes", "version", "timestamp", "kind", "symbol", "dylib", "addend", "target", "flags", "other"
+};
+
+static void macho_writer_visitor(macho_writer *writer);
+
+bool macho_parse_format(const char *name, macho_format *format){
+    if(strcmp(name, "text") == 0)
+        *format = MACHO_FORMAT_TEXT;
+    else if(strcmp(name, "ndjson") == 0)
+        *format = MACHO_FORMAT_NDJSON;
+    else if(strcmp(name, "binary") == 0)
+        *format = MACHO_FORMAT_BINARY;
+    else
+        return false;
+    
+    return true;
+}
+
+macho_writer* macho_writer_create(FILE *out, macho_format format){
+    if(format == MACHO_FORMAT_TEXT)
+        return NULL;
+    
+    macho_writer *writer = calloc(1, sizeof(macho_writer));
+    
+    if(!writer)
+        return NULL;
+    
+    writer->buffer = malloc(MACHO_WRITER_BUFFER_SIZE);
+    
+    if(!writer->buffer){
+        free(writer);
+        return NULL;
+    }
+    
+    writer->out = out;
+    writer->format = format;
+    writer->capacity = MACHO_WRITER_BUFFER_SIZE;
+    macho_writer_visitor(writer);
+    
+    return writer;
+}
+
+void macho_writer_flush(macho_writer *writer){
+    // a record that's still being built stays in the buffer
+    if(writer->record){
+        fwrite(writer->buffer, 1, writer->record, writer->out);
+        memmove(writer->buffer, writer->buffer + writer->record, writer->used - writer->record);
+        writer->used -= writer->record;
+        writer->record = 0;
+    }
+}
+
+void macho_writer_free(macho_writer *writer){
+    if(!writer)
+        return;
+    
+    writer->record = writer->used;
+    macho_writer_flush(writer);
+    fflush(writer->out);
+    free(writer->buffer);
+    free(writer);
+}
+
+// room for size more bytes, writing out finished records first and growing only for a record bigger than the buffer
+static bool macho_writer_reserve(macho_writer *writer, size_t size){
+    if(writer->used + size <= writer->capacity)
+        return true;
+    
+    macho_writer_flush(writer);
+    
+    if(writer->used + size <= writer->capacity)
+        return true;
+    
+    size_t capacity = writer->capacity;
+    
+    while(writer->used + size > capacity)
+        capacity *= 2;
+    
+    uint8_t *grown = realloc(writer->buffer, capacity);
+    
+    if(!grown)
+        return false;
+    
+    writer->buffer = grown;
+    writer->capacity = capacity;
+    
+    return true;
+}
+
+static inline void macho_writer_put(macho_writer *writer, const void *bytes, size_t size){
+    memcpy(writer->buffer + writer->used, bytes, size);
+    writer->used += size;
+}
+
+void macho_writer_append(macho_writer *writer, const void *bytes, size_t size){
+    if(!macho_writer_reserve(writer, size))
+        return;
+    
+    macho_writer_put(writer, bytes, size);
+    writer->record = writer->used;
+}
+
+// decimal digits of value at the end of a 20 byte buffer, returns where they start
+static char* macho_format_decimal(char digits[20], uint64_t value){
+    char *p = digits + 20;
+    
+    do{
+        *--p = '0' + (char)(value % 10);
+        value /= 10;
+    } while(value);
+    
+    return p;
+}
+
+void macho_record_begin(macho_writer *writer, macho_record_type type){
+    writer->record = writer->used;
+    
+    if(writer->format == MACHO_FORMAT_BINARY){
+        uint8_t header[5] = { 0, 0, 0, 0, (uint8_t)type };
+        
+        if(macho_writer_reserve(writer, sizeof(header)))
+            macho_writer_put(writer, header, sizeof(header));
+    } else {
+        const char *name = macho_record_names[type];
+        size_t length = strlen(name);
+        
+        if(macho_writer_reserve(writer, length + 12)){
+            macho_writer_put(writer, "{\"record\":\"", 11);
+            macho_writer_put(writer, name, length);
+            macho_writer_put(writer, "\"", 1);
+        }
+    }
+}
+
+// ,"field": in front of every json value, the record name is always the first member so there's always a comma
+static void macho_json_key(macho_writer *writer, macho_field field){
+    const char *name = macho_field_names[field];
+    size_t length = strlen(name);
+    
+    if(!macho_writer_reserve(writer, length + 4))
+        return;
+    
+    macho_writer_put(writer, ",\"", 2);
+    macho_writer_put(writer, name, length);
+    macho_writer_put(writer, "\":", 2);
+}
+
+static void macho_binary_key(macho_writer *writer, macho_field field, uint8_t kind, size_t size){
+    uint8_t key[2] = { (uint8_t)field, kind };
+    
+    if(macho_writer_reserve(writer, sizeof(key) + size))
+        macho_writer_put(writer, key, sizeof(key));
+}
+
+static void macho_binary_u64(macho_writer *writer, uint64_t value){
+    uint8_t bytes[8];
+    
+    for(int i = 0; i < 8; i++)
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    
+    macho_writer_put(writer, bytes, sizeof(bytes));
+}
+
+void macho_record_string(macho_writer *writer, macho_field field, const char *value){
+    size_t length = strlen(value);
+    
+    if(writer->format == MACHO_FORMAT_BINARY){
+        uint8_t size[4] = { (uint8_t)length, (uint8_t)(length >> 8), (uint8_t)(length >> 16), (uint8_t)(length >> 24) };
+        
+        macho_binary_key(writer, field, MACHO_VALUE_STRING, sizeof(size) + length);
+        macho_writer_put(writer, size, sizeof(size));
+        macho_writer_put(writer, value, length);
+        return;
+    }
+    
+    macho_json_key(writer, field);
+    
+    // every byte escapes to at most 6
+    if(!macho_writer_reserve(writer, 6 * length + 2))
+        return;
+    
+    static const char hex[] = "0123456789abcdef";
+    uint8_t *p = writer->buffer + writer->used;
+    
+    *p++ = '"';
+    
+    for(size_t i = 0; i < length; i++){
+        uint8_t c = (uint8_t)value[i];
+        
+        if(c == '"' || c == '\\'){
+            *p++ = '\\';
+            *p++ = c;
+        } else if(c < 0x20){
+            memcpy(p, "\\u00", 4);
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 0xf];
+            p += 6;
+        } else {
+            *p++ = c;
+        }
+    }
+    
+    *p++ = '"';
+    writer->used = p - writer->buffer;
+}
+
+void macho_record_uint(macho_writer *writer, macho_field field, uint64_t value){
+    if(writer->format == MACHO_FORMAT_BINARY){
+        macho_binary_key(writer, field, MACHO_VALUE_UINT, sizeof(uint64_t));
+        macho_binary_u64(writer, value);
+        return;
+    }
+    
+    char digits[20];
+    char *start = macho_format_decimal(digits, value);
+    
+    macho_json_key(writer, field);
+    
+    if(macho_writer_reserve(writer, digits + 20 - start))
+        macho_writer_put(writer, start, digits + 20 - start);
+}
+
+void macho_record_int(macho_writer *writer, macho_field field, int64_t value){
+    if(writer->format == MACHO_FORMAT_BINARY){
+        macho_binary_key(writer, field, MACHO_VALUE_INT, sizeof(uint64_t));
+        macho_binary_u64(writer, (uint64_t)value);
+        return;
+    }
+    
+    char digits[21];
+    char *start = macho_format_decimal(digits + 1, value < 0 ? -(uint64_t)value : (uint64_t)value);
+    
+    if(value < 0)
+        *--start = '-';
+    
+    macho_json_key(writer, field);
+    
+    if(macho_writer_reserve(writer, digits + 21 - start))
+        macho_writer_put(writer, start, digits + 21 - start);
+}
+
+void macho_record_end(macho_writer *writer){
+    if(writer->format == MACHO_FORMAT_BINARY){
+        // the header didn't fit, there's no record to finish
+        if(writer->used - writer->record < 5)
+            return;
+        
+        // the length counts everything after itself
+        uint32_t length = (uint32_t)(writer->used - writer->record - sizeof(uint32_t));
+        uint8_t *p = writer->buffer + writer->record;
+        
+        p[0] = (uint8_t)length;
+        p[1] = (uint8_t)(length >> 8);
+        p[2] = (uint8_t)(length >> 16);
+        p[3] = (uint8_t)(length >> 24);
+    } else if(macho_writer_reserve(writer, 2)){
+        macho_writer_put(writer, "}\n", 2);
+    }
+    
+    writer->record = writer->used;
+}
+
+static void macho_write_image(void *ctx, const macho_image_event *image){
+    macho_record_begin(ctx, MACHO_RECORD_IMAGE);
+    
+    if(image->cpu)
+        macho_record_string(ctx, MACHO_FIELD_CPU, image->cpu);
+    
+    macho_record_int(ctx, MACHO_FIELD_TYPE, image->cputype);
+    macho_record_uint(ctx, MACHO_FIELD_OFFSET, image->offset);
+    macho_record_end(ctx);
+}
+
+static void macho_write_segment(void *ctx, const macho_segment_event *segment){
+    macho_record_begin(ctx, MACHO_RECORD_SEGMENT);
+    macho_record_string(ctx, MACHO_FIELD_NAME, segment->name);
+    macho_record_uint(ctx, MACHO_FIELD_ADDRESS, segment->address);
+    macho_record_uint(ctx, MACHO_FIELD_SIZE, segment->size);
+    macho_record_end(ctx);
+}
+
+static void macho_write_section(void *ctx, const macho_section_event *section){
+    macho_record_begin(ctx, MACHO_RECORD_SECTION);
+    macho_record_string(ctx, MACHO_FIELD_NAME, section->name);
+    macho_record_string(ctx, MACHO_FIELD_SEGMENT, section->segment);
+    macho_record_uint(ctx, MACHO_FIELD_ADDRESS, section->address);
+    macho_record_uint(ctx, MACHO_FIELD_SIZE, section->size);
+    macho_record_end(ctx);
+}
+
+static void macho_write_dylib(void *ctx, const macho_dylib_event *dylib){
+    macho_record_begin(ctx, MACHO_RECORD_DYLIB);
+    macho_record_string(ctx, MACHO_FIELD_NAME, dylib->name);
+    macho_record_uint(ctx, MACHO_FIELD_VERSION, dylib->current_version);
+    macho_record_uint(ctx, MACHO_FIELD_TIMESTAMP, dylib->timestamp);
+    macho_record_end(ctx);
+}
+
+static void macho_write_symbol(void *ctx, const macho_symbol_event *symbol){
+    macho_record_begin(ctx, MACHO_RECORD_SYMBOL);
+    macho_record_string(ctx, MACHO_FIELD_NAME, symbol->name);
+    
+    if(symbol->type)
+        macho_record_string(ctx, MACHO_FIELD_TYPE, symbol->type);
+    
+    macho_record_uint(ctx, MACHO_FIELD_VALUE, symbol->value);
+    
+    if(symbol->segment){
+        macho_record_uint(ctx, MACHO_FIELD_SIZE, symbol->size);
+        macho_record_string(ctx, MACHO_FIELD_SEGMENT, symbol->segment);
+    }
+    
+    macho_record_end(ctx);
+}
+
+static void macho_write_objc_class(void *ctx, const macho_objc_class_event *objc_class){
+    macho_record_begin(ctx, MACHO_RECORD_OBJC_CLASS);
+    macho_record_string(ctx, MACHO_FIELD_NAME, objc_class->name);
+    macho_record_uint(ctx, MACHO_FIELD_META, objc_class->metaclass);
+    macho_record_end(ctx);
+}
+
+static void macho_write_objc_method(void *ctx, const macho_objc_method_event *method){
+    macho_record_begin(ctx, MACHO_RECORD_OBJC_METHOD);
+    macho_record_string(ctx, MACHO_FIELD_CLASS, method->classname);
+    macho_record_string(ctx, MACHO_FIELD_NAME, method->name);
+    macho_record_uint(ctx, MACHO_FIELD_IMP, method->imp);
+    macho_record_uint(ctx, MACHO_FIELD_META, method->metaclass);
+    macho_record_end(ctx);
+}
+
+static void macho_write_objc_ivar(void *ctx, const macho_objc_ivar_event *ivar){
+    macho_record_begin(ctx, MACHO_RECORD_OBJC_IVAR);
+    macho_record_string(ctx, MACHO_FIELD_CLASS, ivar->classname);
+    macho_record_string(ctx, MACHO_FIELD_NAME, ivar->name);
+    macho_record_uint(ctx, MACHO_FIELD_OFFSET, ivar->offset);
+    macho_record_end(ctx);
+}
+
+static void macho_write_objc_property(void *ctx, const macho_objc_property_event *property){
+    macho_record_begin(ctx, MACHO_RECORD_OBJC_PROPERTY);
+    macho_record_string(ctx, MACHO_FIELD_CLASS, property->classname);
+    macho_record_string(ctx, MACHO_FIELD_NAME, property->name);
+    macho_record_string(ctx, MACHO_FIELD_ATTRIBUTES, property->attributes);
+    macho_record_end(ctx);
+}
+
+static void macho_write_entry_point(void *ctx, const macho_entry_point_event *entry_point){
+    macho_record_begin(ctx, MACHO_RECORD_ENTRY_POINT);
+    macho_record_uint(ctx, MACHO_FIELD_OFFSET, entry_point->offset);
+    macho_record_end(ctx);
+}
+
+static void macho_write_function(void *ctx, const macho_function_event *function){
+    macho_record_begin(ctx, MACHO_RECORD_FUNCTION);
+    macho_record_uint(ctx, MACHO_FIELD_ADDRESS, function->address);
+    macho_record_end(ctx);
+}
+
+static void macho_write_fixup(void *ctx, const macho_fixup_event *fixup){
+    macho_record_begin(ctx, MACHO_RECORD_FIXUP);
+    macho_record_string(ctx, MACHO_FIELD_KIND, fixup->kind);
+    macho_record_string(ctx, MACHO_FIELD_SEGMENT, fixup->segment);
+    macho_record_uint(ctx, MACHO_FIELD_ADDRESS, fixup->address);
+    
+    if(fixup->chained)
+        macho_record_uint(ctx, MACHO_FIELD_FLAGS, fixup->flags);
+    
+    if(fixup->symbol){
+        macho_record_string(ctx, MACHO_FIELD_SYMBOL, fixup->symbol);
+        macho_record_string(ctx, MACHO_FIELD_DYLIB, fixup->dylib);
+        macho_record_int(ctx, MACHO_FIELD_ADDEND, fixup->addend);
+    } else if(fixup->chained && strcmp(fixup->kind, "rebase") == 0){
+        macho_record_uint(ctx, MACHO_FIELD_TARGET, fixup->target);
+    }
+    
+    macho_record_end(ctx);
+}
+
+static void macho_write_export(void *ctx, const macho_export_symbol_event *symbol){
+    macho_record_begin(ctx, MACHO_RECORD_EXPORT);
+    macho_record_string(ctx, MACHO_FIELD_NAME, symbol->name);
+    macho_record_uint(ctx, MACHO_FIELD_FLAGS, symbol->flags);
+    
+    if(symbol->flags & EXPORT_SYMBOL_FLAGS_REEXPORT){
+        macho_record_uint(ctx, MACHO_FIELD_OTHER, symbol->other);
+        macho_record_string(ctx, MACHO_FIELD_SYMBOL, symbol->import_name);
+    } else {
+        macho_record_uint(ctx, MACHO_FIELD_ADDRESS, symbol->address);
+        
+        if(symbol->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER)
+            macho_record_uint(ctx, MACHO_FIELD_OTHER, symbol->other);
+    }
+    
+    macho_record_end(ctx);
+}
+
+static void macho_write_lookup(void *ctx, const macho_lookup_event *lookup){
+    macho_record_begin(ctx, MACHO_RECORD_LOOKUP);
+    macho_record_uint(ctx, MACHO_FIELD_ADDRESS, lookup->address);
+    
+    if(lookup->symbol){
+        macho_record_string(ctx, MACHO_FIELD_SYMBOL, lookup->symbol);
+        macho_record_uint(ctx, MACHO_FIELD_OFFSET, lookup->offset);
+        
+        if(lookup->segment)
+            macho_record_string(ctx, MACHO_FIELD_SEGMENT, lookup->segment);
+    } else if(lookup->function){
+        macho_record_uint(ctx, MACHO_FIELD_TARGET, lookup->function);
+        macho_record_uint(ctx, MACHO_FIELD_OFFSET, lookup->offset);
+    }
+    
+    macho_record_end(ctx);
+}
+
+static void macho_writer_visitor(macho_writer *writer){
+    macho_visitor *visitor = &writer->visitor;
+    
+    visitor->ctx = writer;
+    visitor->image = macho_write_image;
+    visitor->segment = macho_write_segment;
+    visitor->section = macho_write_section;
+    visitor->dylib = macho_write_dylib;
+    visitor->symbol = macho_write_symbol;
+    visitor->objc_class = macho_write_objc_class;
+    visitor->objc_method = macho_write_objc_method;
+    visitor->objc_ivar = macho_write_objc_ivar;
+    visitor->objc_property = macho_write_objc_property;
+    visitor->entry_point = macho_write_entry_point;
+    visitor->function = macho_write_function;
+    visitor->fixup = macho_write_fixup;
+    visitor->export_symbol = macho_write_export;
+    visitor->lookup = macho_write_lookup;
+}
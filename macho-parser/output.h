@@ -0,0 +1,113 @@
+#ifndef __output_h
+#define __output_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "visitor.h"
+
+/*
+ * structured output for pipelines, picked with --format. the text format is what the parser has always printed
+ * and doesn't go through here, the other two get every result as a record of named fields:
+ *
+ *  ndjson  one json object per line, {"record":"symbol","name":"_main","type":"N_SECT","value":4294983520}
+ *          numbers are plain decimal integers, strings are escaped but otherwise passed through byte for byte
+ *  binary  uint32 length of the rest of the record, uint8 record type, then the fields, each one
+ *          uint8 field, uint8 kind and the value: a little endian uint64 or int64, or a uint32 length and the bytes
+ *          record and field numbers are the enums below and never get reused
+ *
+ * each parsed file starts with a file record and each mach header with an image record, the rest belong to the last image
+ * a writer is a visitor that turns each event into its record, load commands and signature blobs don't have one
+ * records are built straight into one large buffer that is reused for the whole run and written out when it fills up,
+ * nothing is allocated per record
+ */
+
+typedef enum{
+    MACHO_FORMAT_TEXT,
+    MACHO_FORMAT_NDJSON,
+    MACHO_FORMAT_BINARY
+} macho_format;
+
+typedef enum{
+    MACHO_RECORD_FILE,
+    MACHO_RECORD_IMAGE,
+    MACHO_RECORD_SEGMENT,
+    MACHO_RECORD_SECTION,
+    MACHO_RECORD_DYLIB,
+    MACHO_RECORD_SYMBOL,
+    MACHO_RECORD_OBJC_CLASS,
+    MACHO_RECORD_OBJC_METHOD,
+    MACHO_RECORD_OBJC_IVAR,
+    MACHO_RECORD_OBJC_PROPERTY,
+    MACHO_RECORD_ENTRY_POINT,
+    MACHO_RECORD_FUNCTION,
+    MACHO_RECORD_FIXUP,
+    MACHO_RECORD_EXPORT,
+    MACHO_RECORD_LOOKUP,
+    MACHO_NUM_RECORDS
+} macho_record_type;
+
+typedef enum{
+    MACHO_FIELD_PATH,
+    MACHO_FIELD_NAME,
+    MACHO_FIELD_CPU,
+    MACHO_FIELD_OFFSET,
+    MACHO_FIELD_ADDRESS,
+    MACHO_FIELD_SIZE,
+    MACHO_FIELD_SEGMENT,
+    MACHO_FIELD_TYPE,
+    MACHO_FIELD_VALUE,
+    MACHO_FIELD_CLASS,
+    MACHO_FIELD_META,
+    MACHO_FIELD_IMP,
+    MACHO_FIELD_ATTRIBUTES,
+    MACHO_FIELD_VERSION,
+    MACHO_FIELD_TIMESTAMP,
+    MACHO_FIELD_KIND,
+    MACHO_FIELD_SYMBOL,
+    MACHO_FIELD_DYLIB,
+    MACHO_FIELD_ADDEND,
+    MACHO_FIELD_TARGET,
+    MACHO_FIELD_FLAGS,
+    MACHO_FIELD_OTHER,
+    MACHO_NUM_FIELDS
+} macho_field;
+
+enum{
+    MACHO_VALUE_UINT,
+    MACHO_VALUE_INT,
+    MACHO_VALUE_STRING
+};
+
+#define MACHO_WRITER_BUFFER_SIZE (1 << 20)
+
+typedef struct{
+    FILE *out;
+    macho_format format;
+    uint8_t *buffer;
+    size_t used;
+    size_t capacity;
+    size_t record; // where the record being built starts, it can't be written out before it's finished
+    macho_visitor visitor; // encodes into this writer, ctx is the writer
+} macho_writer;
+
+// parses "text", "ndjson" or "binary", false for anything else
+bool macho_parse_format(const char *name, macho_format *format);
+
+// NULL for the text format, which prints directly
+macho_writer* macho_writer_create(FILE *out, macho_format format);
+// writes out whatever is buffered and frees the writer
+void macho_writer_free(macho_writer *writer);
+void macho_writer_flush(macho_writer *writer);
+
+// bytes that are already records of this format, e.g. the buffered output of a fat slice
+void macho_writer_append(macho_writer *writer, const void *bytes, size_t size);
+
+void macho_record_begin(macho_writer *writer, macho_record_type type);
+void macho_record_string(macho_writer *writer, macho_field field, const char *value);
+void macho_record_uint(macho_writer *writer, macho_field field, uint64_t value);
+void macho_record_int(macho_writer *writer, macho_field field, int64_t value);
+void macho_record_end(macho_writer *writer);
+
+#endif
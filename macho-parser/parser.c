@@ -1,29 +1,419 @@
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "parser.h"
 
+#define MACHO_READ_CHUNK 0x100000
+
 /*
- * macho_get_bytes is a dummy function that loads temporary data from the file onto the heap
- * a better way to do this is use a universal buffer that gets operated on instead and do pointer arithmetic
- * (we learn from our mistakes)
+ * the image is mapped read-only straight from the file so that parsing only faults in the pages it touches
+ * files that can't be mapped (pipes, character devices) get read onto the heap instead
+ * either way every accessor below just does pointer arithmetic on the universal buffer
  */
 
-void* macho_get_bytes(uint32_t offset){
-    uint8_t *buffer = (uint8_t*)gmacho_file->buffer;
-    return (void*)&buffer[offset];
+static bool macho_read_file(macho_file *macho, FILE *file){
+    size_t capacity = 0;
+    size_t size = 0;
+    char *buffer = NULL;
+    
+    for(;;){
+        if(size == capacity){
+            capacity = capacity ? capacity * 2 : MACHO_READ_CHUNK;
+            
+            char *grown = realloc(buffer, capacity);
+            
+            if(!grown){
+                free(buffer);
+                return false;
+            }
+            
+            buffer = grown;
+        }
+        
+        size_t n = fread(buffer + size, 1, capacity - size, file);
+        
+        if(n == 0)
+            break;
+        
+        size += n;
+    }
+    
+    if(ferror(file)){
+        free(buffer);
+        return false;
+    }
+    
+    macho->buffer = buffer;
+    macho->size = size;
+    macho->mapped = false;
+    
+    return true;
 }
 
-size_t macho_string_size(uint64_t offset){
-    char *buffer = (char*)((uint64_t)gmacho_file->buffer + offset);
+bool macho_map_file(macho_file *macho, FILE *file){
+    struct stat st;
+    int fd = fileno(file);
     
-    size_t size = 0;
+    macho->file = file;
+    
+    if(fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        
+        if(map != MAP_FAILED){
+            macho->buffer = (char*)map;
+            macho->size = (size_t)st.st_size;
+            macho->mapped = true;
+            
+            return true;
+        }
+    }
+    
+    return macho_read_file(macho, file);
+}
+
+void macho_unmap_file(macho_file *macho){
+    if(!macho->buffer)
+        return;
+    
+    if(macho->mapped)
+        munmap(macho->buffer, macho->size);
+    else
+        free(macho->buffer);
+    
+    macho->buffer = NULL;
+    macho->size = 0;
+    macho->mapped = false;
+}
+
+// splits every CLASSNAME-METHOD query once into a class -> selector set lookup
+// so the objc walker does one lookup per class and one per method of a queried class
+static void macho_objc_queries_create(symbol_table *table){
+    macho_hash_init(&table->objc_classes, 0);
+    
+    table->objc_queries = calloc(table->num_symbols ? table->num_symbols : 1, sizeof(char*));
+    
+    if(!table->objc_queries)
+        return;
+    
+    for(uint32_t i = 0; i < table->num_symbols; i++){
+        char *separator = strchr(table->symbols[i], '-');
+        
+        // exactly one separator with a name on both sides, anything else is a plain symbol
+        if(!separator || separator == table->symbols[i] || !separator[1] || strchr(separator + 1, '-'))
+            continue;
+        
+        char *query = strdup(table->symbols[i]);
+        
+        if(!query)
+            continue;
+        
+        char *classname = query;
+        char *methodname = query + (separator - table->symbols[i]) + 1;
+        methodname[-1] = '\0';
+        
+        macho_hash_entry *class_entry = macho_hash_insert(&table->objc_classes, classname, NULL);
+        
+        if(!class_entry){
+            free(query);
+            continue;
+        }
+        
+        if(!class_entry->value){
+            macho_hash_table *methods = calloc(1, sizeof(macho_hash_table));
+            
+            if(!methods){
+                free(query);
+                continue;
+            }
+            
+            macho_hash_init(methods, 0);
+            class_entry->value = methods;
+        }
+        
+        macho_hash_insert((macho_hash_table*)class_entry->value, methodname, methodname);
+        table->objc_queries[table->num_objc_queries++] = query;
+    }
+}
+
+symbol_table* macho_symbol_table_create(const char *const *symbols, uint32_t num_symbols){
+    symbol_table *table = calloc(1, sizeof(symbol_table));
+    
+    if(!table)
+        return NULL;
+    
+    table->symbols = calloc(num_symbols ? num_symbols : 1, sizeof(char*));
+    
+    if(!table->symbols){
+        free(table);
+        return NULL;
+    }
     
-    for(char *s = buffer; *s; s++) size++;
+    macho_hash_init(&table->lookup, num_symbols);
     
-    return size;
+    for(uint32_t i = 0; i < num_symbols; i++){
+        char *symbol = strdup(symbols[i]);
+        
+        if(!symbol)
+            continue;
+        
+        table->symbols[table->num_symbols++] = symbol;
+        macho_hash_insert(&table->lookup, symbol, symbol);
+    }
+    
+    macho_objc_queries_create(table);
+    
+    return table;
+}
+
+void macho_symbol_table_free(symbol_table *table){
+    if(!table)
+        return;
+    
+    for(uint32_t i = 0; i < table->objc_classes.capacity; i++){
+        macho_hash_table *methods = table->objc_classes.entries[i].value;
+        
+        if(methods){
+            macho_hash_free(methods);
+            free(methods);
+        }
+    }
+    
+    for(uint32_t i = 0; i < table->num_objc_queries; i++)
+        free(table->objc_queries[i]);
+    
+    for(uint32_t i = 0; i < table->num_symbols; i++)
+        free(table->symbols[i]);
+    
+    macho_hash_free(&table->objc_classes);
+    macho_hash_free(&table->lookup);
+    free(table->objc_queries);
+    free(table->symbols);
+    free(table);
+}
+
+bool macho_symbol_requested(const symbol_table *table, const char *name){
+    return table && macho_hash_lookup(&table->lookup, name) != NULL;
+}
+
+const macho_hash_table* macho_objc_class_queries(const symbol_table *table, const char *classname){
+    if(!table)
+        return NULL;
+    
+    macho_hash_entry *entry = macho_hash_lookup(&table->objc_classes, classname);
+    
+    return entry ? (const macho_hash_table*)entry->value : NULL;
+}
+
+static const struct{
+    const char *name;
+    uint32_t part;
+} macho_part_names[] = {
+    {"segments",  MACHO_PART_SEGMENTS},
+    {"objc",      MACHO_PART_OBJC},
+    {"dylibs",    MACHO_PART_DYLIBS},
+    {"symtab",    MACHO_PART_SYMTAB},
+    {"dysymtab",  MACHO_PART_DYSYMTAB},
+    {"main",      MACHO_PART_MAIN},
+    {"signature", MACHO_PART_SIGNATURE},
+    {"functions", MACHO_PART_FUNCTIONS},
+    {"bindings",  MACHO_PART_BINDINGS},
+    {"exports",   MACHO_PART_EXPORTS},
+    {"all",       MACHO_PART_ALL}
+};
+
+bool macho_parse_parts(const char *list, uint32_t *parts){
+    *parts = 0;
+    
+    while(*list){
+        size_t length = strcspn(list, ",");
+        bool known = false;
+        
+        for(size_t i = 0; i < sizeof(macho_part_names) / sizeof(macho_part_names[0]); i++){
+            if(strlen(macho_part_names[i].name) == length && strncmp(list, macho_part_names[i].name, length) == 0){
+                *parts |= macho_part_names[i].part;
+                known = true;
+                break;
+            }
+        }
+        
+        if(!known && length)
+            return false;
+        
+        list += length;
+        
+        if(*list == ',')
+            list++;
+    }
+    
+    return true;
 }
 
-char* macho_read_string(uint64_t offset){
-    size_t size = macho_string_size(offset);
-    return (char*)macho_get_bytes((uint32_t)offset);
+macho_file* macho_open(FILE *file, const char *path, symbol_table *symbols, FILE *out){
+    macho_file *macho = calloc(1, sizeof(macho_file));
+    
+    if(!macho)
+        return NULL;
+    
+    macho->path = strdup(path);
+    macho->symboltable = symbols;
+    macho->out = out ? out : stdout;
+    macho->options = (macho_options)MACHO_DEFAULT_OPTIONS;
+    
+    if(!macho->path || !macho_map_file(macho, file)){
+        free(macho->path);
+        free(macho);
+        return NULL;
+    }
+    
+    return macho;
 }
 
+void macho_close(macho_file *macho){
+    if(!macho)
+        return;
+    
+    macho_unmap_file(macho);
+    macho_arena_reset(&macho->arena);
+    free(macho->path);
+    free(macho);
+}
+
+void macho_window_drop(macho_file *macho, uint64_t offset, uint64_t size){
+    if(!macho->mapped || !macho->options.window_size || offset >= macho->size)
+        return;
+    
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t end = size > macho->size - offset ? macho->size : offset + size;
+    
+    // only whole pages inside the range, except that the range may end in the partial last page of the file
+    uint64_t first = (offset + page - 1) & ~(page - 1);
+    uint64_t last = end == macho->size ? (end + page - 1) & ~(page - 1) : end & ~(page - 1);
+    
+    if(first < last)
+        madvise(macho->buffer + first, (size_t)(last - first), MADV_DONTNEED);
+}
+
+// makes the chunk holding offset resident, evicting the chunk touched longest ago if every slot is taken
+static void macho_window_touch(macho_file *macho, uint64_t offset){
+    macho_window *window = &macho->window;
+    uint64_t chunk = offset / window->chunk_size + 1;
+    
+    if(window->chunks[window->last] == chunk)
+        return;
+    
+    uint32_t victim = 0;
+    
+    window->clock++;
+    
+    for(uint32_t i = 0; i < MACHO_WINDOW_SLOTS; i++){
+        if(window->chunks[i] == chunk){
+            window->used[i] = window->clock;
+            window->last = i;
+            return;
+        }
+        
+        // free slots were never used, so they go first
+        if(window->used[i] < window->used[victim])
+            victim = i;
+    }
+    
+    if(window->chunks[victim])
+        macho_window_drop(macho, (window->chunks[victim] - 1) * window->chunk_size, window->chunk_size);
+    
+    window->chunks[victim] = chunk;
+    window->used[victim] = window->clock;
+    window->last = victim;
+}
+
+// touches every chunk the range covers, a range wider than the window only gets its first MACHO_WINDOW_SLOTS chunks
+// and whoever walks the rest of it has to go through macho_window_use as it goes
+static void macho_window_track(macho_file *macho, uint64_t offset, uint64_t size){
+    macho_window *window = &macho->window;
+    
+    if(!macho->mapped || !macho->options.window_size || !size || offset >= macho->size)
+        return;
+    
+    if(!window->chunk_size){
+        uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+        uint64_t chunk_size = macho->options.window_size / MACHO_WINDOW_SLOTS;
+        
+        window->chunk_size = chunk_size > page ? (chunk_size + page - 1) & ~(page - 1) : page;
+    }
+    
+    uint64_t end = size > macho->size - offset ? macho->size : offset + size;
+    uint64_t first = offset / window->chunk_size;
+    uint64_t last = (end - 1) / window->chunk_size;
+    
+    if(last - first >= MACHO_WINDOW_SLOTS)
+        last = first + MACHO_WINDOW_SLOTS - 1;
+    
+    for(uint64_t chunk = first; chunk <= last; chunk++)
+        macho_window_touch(macho, chunk == first ? offset : chunk * window->chunk_size);
+}
+
+void macho_window_use(macho_file *macho, const void *bytes, uint64_t size){
+    const char *start = bytes;
+    
+    if(start >= macho->buffer && start < macho->buffer + macho->size)
+        macho_window_track(macho, (uint64_t)(start - macho->buffer), size);
+}
+
+void* macho_get_bytes(macho_file *macho, uint64_t offset){
+    // one past the last byte is still a valid (empty) place to point at
+    if(offset > macho->size)
+        return NULL;
+    
+    macho_window_track(macho, offset, 1);
+    
+    return macho->buffer + offset;
+}
+
+void* macho_get_range(macho_file *macho, uint64_t offset, uint64_t size){
+    if(offset > macho->size || size > macho->size - offset)
+        return NULL;
+    
+    macho_count(macho, MACHO_COUNTER_BYTES, size);
+    macho_window_track(macho, offset, size);
+    
+    return macho->buffer + offset;
+}
+
+bool macho_read(macho_file *macho, uint64_t offset, void *out, size_t size){
+    void *bytes = macho_get_range(macho, offset, size);
+    
+    if(!bytes){
+        memset(out, 0, size);
+        return false;
+    }
+    
+    memcpy(out, bytes, size);
+    
+    return true;
+}
+
+size_t macho_string_size(macho_file *macho, uint64_t offset){
+    char *string = macho_get_bytes(macho, offset);
+    
+    if(!string)
+        return 0;
+    
+    char *end = memchr(string, '\0', macho->size - offset);
+    
+    return end ? (size_t)(end - string) : macho->size - offset;
+}
+
+char* macho_read_string(macho_file *macho, uint64_t offset){
+    char *string = macho_get_bytes(macho, offset);
+    char *end = string ? memchr(string, '\0', macho->size - offset) : NULL;
+    
+    if(!end)
+        return NULL;
+    
+    macho_count(macho, MACHO_COUNTER_BYTES, end - string + 1);
+    
+    return string;
+}
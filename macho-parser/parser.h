@@ -6,31 +6,156 @@
 #define swap(x,y,s) if(s) swap_ ## x(y,NXHostByteOrder())
 #define swapn(x,y,n,s) if(s) swap_ ## x(y,n,NXHostByteOrder())
 
+#include <stddef.h>
 #include <stdbool.h>
+#include "hashtable.h"
+#include "arena.h"
+#include "segment_map.h"
+#include "output.h"
+#include "visitor.h"
+#include "stats.h"
 
 typedef struct{
     uint32_t num_symbols;
     char **symbols;
+    macho_hash_table lookup; // every entry of symbols, built once so matching a symbol is O(1)
+    macho_hash_table objc_classes; // CLASSNAME -> macho_hash_table of the METHODs queried on that class
+    char **objc_queries; // split copies of the CLASSNAME-METHOD entries, owned by the table
+    uint32_t num_objc_queries;
 } symbol_table;
 
-// add some instance methods to make this object oriented using POD
+symbol_table* macho_symbol_table_create(const char *const *symbols, uint32_t num_symbols);
+void macho_symbol_table_free(symbol_table *table);
+bool macho_symbol_requested(const symbol_table *table, const char *name);
+const macho_hash_table* macho_objc_class_queries(const symbol_table *table, const char *classname);
+
+#define MACHO_NUM_SPECIAL_SLOTS 5
+
+typedef struct{
+    uint8_t *data;
+    uint8_t *hash;
+    uint32_t hashSize;
+    bool sha256;
+} special_slot;
+
+// pieces of an image that can be selected with --only, everything but the fixups and exports is parsed by default
+enum{
+    MACHO_PART_SEGMENTS  = 1 << 0,
+    MACHO_PART_OBJC      = 1 << 1,
+    MACHO_PART_DYLIBS    = 1 << 2,
+    MACHO_PART_SYMTAB    = 1 << 3,
+    MACHO_PART_DYSYMTAB  = 1 << 4,
+    MACHO_PART_MAIN      = 1 << 5,
+    MACHO_PART_SIGNATURE = 1 << 6,
+    MACHO_PART_LOOKUPS   = 1 << 7,
+    MACHO_PART_FUNCTIONS = 1 << 8,
+    MACHO_PART_BINDINGS  = 1 << 9, // every rebase and bind, one line each, so only printed when asked for
+    MACHO_PART_EXPORTS   = 1 << 10, // the same goes for the export trie
+    MACHO_PART_ALL       = 0xffffffff,
+    MACHO_PART_DEFAULT   = MACHO_PART_ALL & ~(MACHO_PART_BINDINGS | MACHO_PART_EXPORTS)
+};
+
+// parses a comma separated list like "dylibs,symtab" into MACHO_PART_ flags, false on an unknown name
+bool macho_parse_parts(const char *list, uint32_t *parts);
+
+#define MACHO_MAX_ARCHS 8
+
+typedef struct{
+    uint32_t parts;          // MACHO_PART_ flags of what to parse and print
+    int32_t archs[MACHO_MAX_ARCHS]; // cpu types of the slices to parse, every slice when num_archs is 0
+    uint32_t num_archs;
+    uint32_t slice_threads;  // threads parsing the slices of a fat binary, 0 uses every cpu
+    uint32_t verify_threads; // threads hashing code pages, 1 verifies serially and 0 uses every cpu
+    bool verify_stats;       // report how many pages per second were verified
+    const uint64_t *lookup_addresses; // addresses to symbolicate against the symbol table
+    size_t num_lookup_addresses;
+    const char *cache_dir; // answer queries from a sidecar cache kept in here instead of dumping the image
+    uint64_t window_size;  // keep about this many bytes of a mapped file resident, 0 leaves every touched page in
+    const char *image;     // in a dyld shared cache, parse this image (install name or file name) instead of listing them all
+    uint32_t scan_threads; // threads parsing the files of a directory, 0 uses every cpu
+    macho_format format;   // text for people, ndjson or binary records for pipelines
+    macho_stats_format stats; // time the phases of each file and count the work done, reported on stderr
+} macho_options;
+
+#define MACHO_DEFAULT_OPTIONS { .parts = MACHO_PART_DEFAULT, .num_archs = 0, .slice_threads = 0, .verify_threads = 1, .verify_stats = false, .lookup_addresses = NULL, .num_lookup_addresses = 0, .cache_dir = NULL, .window_size = 0, .image = NULL, .scan_threads = 0, .format = MACHO_FORMAT_TEXT, .stats = MACHO_STATS_NONE }
+
+#define MACHO_WINDOW_SLOTS 16
+
+/*
+ * the resident part of a mapping when window_size is set, the file is cut into window_size / MACHO_WINDOW_SLOTS chunks
+ * and touching a chunk that isn't in here drops the pages of the one touched longest ago
+ * the mapping is private and never written, so dropped pages just fault back in from the file when they're needed again
+ */
+typedef struct{
+    uint64_t chunk_size;                 // set on the first access, 0 until then
+    uint64_t chunks[MACHO_WINDOW_SLOTS]; // chunk number + 1 of each resident chunk, 0 for a free slot
+    uint64_t used[MACHO_WINDOW_SLOTS];   // clock of the last access to each chunk
+    uint64_t clock;
+    uint32_t last;                       // slot of the last access, most accesses land right next to it
+} macho_window;
+
+// everything known about one image lives in here, nothing is shared between images
+// so separate images can be parsed on separate threads at the same time
 typedef struct{
     bool fat;
     bool is64bit;
     bool arm;
     bool x86;
+    bool mapped; // buffer is a read-only mmap of the file, otherwise it was read onto the heap
     char *path;
     FILE *file;
     char *buffer;
     size_t size;
+    macho_window window;     // only used by mapped files with options.window_size set
+    FILE *out; // where the results for this image are printed
+    macho_writer *writer;    // records go in here with --format ndjson or binary, NULL for text
+    const macho_visitor *visitor; // gets everything as it's parsed instead of it being printed, the writer's own visitor for ndjson and binary
+    macho_stats *stats;      // phase timers and counters with --stats, NULL otherwise
     symbol_table *symboltable;
+    macho_options options;
+    uint64_t headeroff;      // mach header of the image being parsed, the slice offset inside a fat file
+    uint64_t fileoff_base;   // what the file offsets in its load commands count from, headeroff except inside a shared cache
+    void *shared_cache;      // the dyld shared cache the image sits in, NULL for a thin or fat file
+    macho_segment_map segment_map; // segments of that image, loaded along with its header
+    void *disassembler;      // capstone handle and function bounds, created by the first disassembly
+    void *chained_fixups;    // decoded LC_DYLD_CHAINED_FIXUPS, loaded by the first pointer read
+    special_slot special_slots[MACHO_NUM_SPECIAL_SLOTS];
+    macho_arena arena;       // everything parsed out of the image being parsed, reset when it's released
 } macho_file;
 
-extern macho_file *gmacho_file;
+// free text output, which only the text format has, with a visitor everything goes through macho_emit instead
+#define macho_print(macho, ...) do{ if(!(macho)->visitor) fprintf((macho)->out, __VA_ARGS__); } while(0)
+
+// hands the visitor's kind callback a macho_kind_event built from the designated initializers, if it has one
+#define macho_emit(macho, kind, ...) do{ \
+    if((macho)->visitor && (macho)->visitor->kind) \
+        (macho)->visitor->kind((macho)->visitor->ctx, &(macho_ ## kind ## _event){ __VA_ARGS__ }); \
+} while(0)
+
+macho_file* macho_open(FILE *file, const char *path, symbol_table *symbols, FILE *out);
+void macho_close(macho_file *macho);
+
+bool macho_map_file(macho_file *macho, FILE *file);
+void macho_unmap_file(macho_file *macho);
+
+// every accessor takes a 64 bit offset from the start of the file and checks it against the file size
+// the bytes at offset, NULL past the end of the file
+void* macho_get_bytes(macho_file *macho, uint64_t offset);
+// the size bytes at offset, NULL unless all of them are inside the file
+void* macho_get_range(macho_file *macho, uint64_t offset, uint64_t size);
+// copies size bytes at offset into out, zero fills out and returns false if they aren't all inside the file
+bool macho_read(macho_file *macho, uint64_t offset, void *out, size_t size);
+// length of the string at offset, stopping at the end of the file if it isn't terminated before
+size_t macho_string_size(macho_file *macho, uint64_t offset);
+// the string at offset, NULL if it isn't terminated inside the file
+char* macho_read_string(macho_file *macho, uint64_t offset);
 
-void* macho_get_bytes(uint32_t offset);
-size_t macho_string_size(uint64_t offset);
-char* macho_read_string(uint64_t offset);
+// drops the pages of a windowed mapping in this range, for long scans that don't go through the accessors
+// only reads the options, so the workers of a parallel scan can call it on a shared context
+void macho_window_drop(macho_file *macho, uint64_t offset, uint64_t size);
+// keeps the window on bytes..bytes+size of the mapping, for walkers stepping through a range they got in one piece
+// from macho_get_range, so the part they've moved past can be evicted
+void macho_window_use(macho_file *macho, const void *bytes, uint64_t size);
 
 
 #endif
@@ -0,0 +1,438 @@
+#include <mach-o/fat.h>
+#include <mach-o/loader.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "mach-o.h"
+#include "shared_cache.h"
+#include "thread_pool.h"
+#include "batch_io.h"
+#include "scan.h"
+
+// java class files share the fat magic, their version sits where nfat_arch would and is never below 45
+#define MACHO_SCAN_MAX_FAT_ARCHS 32
+
+// read ahead of parsing for every file: the mach header and load commands of nearly every image fit in here
+#define MACHO_SCAN_HEAD_SIZE (32 * 1024)
+// files whose heads are read together, bounds the memory and open files of the read ahead
+#define MACHO_SCAN_INGEST_BATCH 256
+// output of finished files kept in memory while an earlier file is still being parsed, past it they spill to temp files
+#define MACHO_SCAN_MAX_PENDING (64 * 1024 * 1024)
+// copies spilled output back out in pieces of this size
+#define MACHO_SCAN_COPY_SIZE (64 * 1024)
+
+typedef struct{
+    char *path;
+    uint64_t size;
+    char *output;
+    size_t output_size;
+    FILE *spill;     // the output, moved out of memory because too much was waiting to be written
+    bool recognized; // its head looked like something macho_parse handles
+    bool done;
+} scan_entry;
+
+typedef struct{
+    scan_entry *entries; // sorted by path, the order they're printed in
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *order;     // recognized entries by size, biggest first, the order they're parsed in
+    uint32_t num_order;
+    symbol_table *symbols;
+    macho_options options;
+    FILE *out;
+    pthread_mutex_t lock; // guards printed, pending, flushing and the done flags
+    uint32_t printed;     // entries before this one are written out, or being written by the flushing thread
+    size_t pending;       // bytes of output done and in memory but not written yet
+    bool flushing;        // a thread is writing, the others leave what they finish to it
+} scan_job;
+
+bool macho_scan_recognized(const uint8_t *bytes, size_t length){
+    if(length < 2 * sizeof(uint32_t))
+        return false;
+    
+    if(memcmp(bytes, MACHO_SHARED_CACHE_MAGIC, strlen(MACHO_SHARED_CACHE_MAGIC)) == 0)
+        return true;
+    
+    uint32_t magic;
+    memcpy(&magic, bytes, sizeof(magic));
+    
+    if(macho_32bit(magic) || macho_64bit(magic))
+        return true;
+    
+    if(!macho_fat(magic))
+        return false;
+    
+    // the fat header is big endian
+    uint32_t nfat_arch = (uint32_t)bytes[4] << 24 | (uint32_t)bytes[5] << 16 | (uint32_t)bytes[6] << 8 | bytes[7];
+    
+    return nfat_arch > 0 && nfat_arch <= MACHO_SCAN_MAX_FAT_ARCHS;
+}
+
+static bool macho_scan_add(scan_job *job, const char *path, uint64_t size){
+    if(job->count == job->capacity){
+        uint32_t capacity = job->capacity ? job->capacity * 2 : 256;
+        scan_entry *grown = realloc(job->entries, capacity * sizeof(scan_entry));
+        
+        if(!grown)
+            return false;
+        
+        job->entries = grown;
+        job->capacity = capacity;
+    }
+    
+    scan_entry *entry = &job->entries[job->count];
+    
+    memset(entry, 0, sizeof(scan_entry));
+    entry->path = strdup(path);
+    entry->size = size;
+    
+    if(!entry->path)
+        return false;
+    
+    job->count++;
+    
+    return true;
+}
+
+// collects every regular file under dir, symlinks aren't followed so a link back up the tree can't loop
+static bool macho_scan_walk(scan_job *job, const char *dir){
+    DIR *handle = opendir(dir);
+    struct dirent *dirent;
+    
+    if(!handle)
+        return false;
+    
+    while((dirent = readdir(handle))){
+        if(strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0)
+            continue;
+        
+        size_t length = strlen(dir) + 1 + strlen(dirent->d_name) + 1;
+        char *path = malloc(length);
+        struct stat st;
+        
+        if(!path)
+            break;
+        
+        snprintf(path, length, "%s/%s", dir, dirent->d_name);
+        
+        if(lstat(path, &st) == 0){
+            // a directory that can't be opened is skipped like the files that can't be read
+            if(S_ISDIR(st.st_mode))
+                macho_scan_walk(job, path);
+            else if(S_ISREG(st.st_mode) && st.st_size >= (off_t)(2 * sizeof(uint32_t)))
+                macho_scan_add(job, path, (uint64_t)st.st_size);
+        }
+        
+        free(path);
+    }
+    
+    closedir(handle);
+    
+    return true;
+}
+
+static int macho_scan_compare_path(const void *a, const void *b){
+    return strcmp(((const scan_entry*)a)->path, ((const scan_entry*)b)->path);
+}
+
+typedef struct{
+    uint64_t size;
+    uint32_t entry;
+} scan_order;
+
+static int macho_scan_compare_size(const void *a, const void *b){
+    uint64_t size_a = ((const scan_order*)a)->size;
+    uint64_t size_b = ((const scan_order*)b)->size;
+    
+    return size_a < size_b ? 1 : size_a > size_b ? -1 : 0;
+}
+
+static void macho_scan_write(scan_job *job, scan_entry *entry){
+    // the other formats start every file with a file record of their own
+    if((entry->output || entry->spill) && job->options.format == MACHO_FORMAT_TEXT)
+        fprintf(job->out, "\nFile %s\n\n", entry->path);
+    
+    if(entry->output)
+        fwrite(entry->output, 1, entry->output_size, job->out);
+    
+    if(entry->spill){
+        char buffer[MACHO_SCAN_COPY_SIZE];
+        size_t length;
+        
+        rewind(entry->spill);
+        
+        while((length = fread(buffer, 1, sizeof(buffer), entry->spill)) > 0)
+            fwrite(buffer, 1, length, job->out);
+        
+        fclose(entry->spill);
+        entry->spill = NULL;
+    }
+    
+    free(entry->output);
+    entry->output = NULL;
+}
+
+/*
+ * writes out every finished file that has nothing unfinished before it
+ * the range is claimed under the lock and written after letting go of it, so the workers never wait on the output
+ * only one thread writes at a time to keep path order, what finishes meanwhile is picked up by its next round
+ */
+static void macho_scan_flush(scan_job *job){
+    pthread_mutex_lock(&job->lock);
+    
+    if(job->flushing){
+        pthread_mutex_unlock(&job->lock);
+        return;
+    }
+    
+    job->flushing = true;
+    
+    for(;;){
+        uint32_t begin = job->printed;
+        size_t written = 0;
+        
+        while(job->printed < job->count && job->entries[job->printed].done)
+            job->printed++;
+        
+        uint32_t end = job->printed;
+        
+        if(begin == end)
+            break;
+        
+        pthread_mutex_unlock(&job->lock);
+        
+        for(uint32_t i = begin; i < end; i++){
+            written += job->entries[i].output ? job->entries[i].output_size : 0;
+            macho_scan_write(job, &job->entries[i]);
+        }
+        
+        pthread_mutex_lock(&job->lock);
+        job->pending -= written;
+    }
+    
+    job->flushing = false;
+    pthread_mutex_unlock(&job->lock);
+}
+
+// moves output to a temp file, it stays in memory if there's no temp file to be had
+static void macho_scan_spill(scan_entry *entry){
+    FILE *spill = tmpfile();
+    
+    if(!spill)
+        return;
+    
+    if(fwrite(entry->output, 1, entry->output_size, spill) != entry->output_size){
+        fclose(spill);
+        return;
+    }
+    
+    free(entry->output);
+    entry->output = NULL;
+    entry->output_size = 0;
+    entry->spill = spill;
+}
+
+static void macho_scan_file(void *ctx, uint32_t index){
+    scan_job *job = ctx;
+    uint32_t position = job->order[index];
+    scan_entry *entry = &job->entries[position];
+    FILE *file = fopen(entry->path, "rb");
+    
+    if(file){
+        FILE *out = open_memstream(&entry->output, &entry->output_size);
+        
+        if(out){
+            macho_parse(file, entry->path, job->symbols, &job->options, out);
+            fclose(out);
+        }
+    }
+    
+    if(file)
+        fclose(file);
+    
+    // biggest first parsing against path order printing can hold every later file behind one early big one,
+    // so past a limit output that has to wait goes to disk
+    pthread_mutex_lock(&job->lock);
+    
+    bool spill = entry->output && position != job->printed && job->pending + entry->output_size > MACHO_SCAN_MAX_PENDING;
+    
+    if(!spill){
+        job->pending += entry->output ? entry->output_size : 0;
+        entry->done = true;
+    }
+    
+    pthread_mutex_unlock(&job->lock);
+    
+    if(spill){
+        macho_scan_spill(entry);
+        
+        pthread_mutex_lock(&job->lock);
+        job->pending += entry->output ? entry->output_size : 0;
+        entry->done = true;
+        pthread_mutex_unlock(&job->lock);
+    }
+    
+    macho_scan_flush(job);
+}
+
+// queues a read of the head of every slice of the fat file whose head is in bytes
+static uint32_t macho_scan_fat_requests(scan_job *job, const scan_entry *entry, const uint8_t *bytes, size_t length, macho_batch_request *requests){
+    uint32_t magic;
+    uint32_t count = 0;
+    
+    memcpy(&magic, bytes, sizeof(magic));
+    
+    if(!macho_fat(magic))
+        return 0;
+    
+    uint32_t nfat_arch = (uint32_t)bytes[4] << 24 | (uint32_t)bytes[5] << 16 | (uint32_t)bytes[6] << 8 | bytes[7];
+    
+    for(uint32_t i = 0; i < nfat_arch && sizeof(struct fat_header) + (i + 1) * sizeof(struct fat_arch) <= length; i++){
+        const uint8_t *arch = bytes + sizeof(struct fat_header) + i * sizeof(struct fat_arch);
+        int32_t cputype = (int32_t)((uint32_t)arch[0] << 24 | (uint32_t)arch[1] << 16 | (uint32_t)arch[2] << 8 | arch[3]);
+        uint32_t offset = (uint32_t)arch[8] << 24 | (uint32_t)arch[9] << 16 | (uint32_t)arch[10] << 8 | arch[11];
+        bool selected = !job->options.num_archs;
+        
+        for(uint32_t j = 0; j < job->options.num_archs; j++)
+            selected |= job->options.archs[j] == cputype;
+        
+        if(!selected || offset < MACHO_SCAN_HEAD_SIZE)
+            continue;
+        
+        requests[count].path = entry->path;
+        requests[count].offset = offset;
+        requests[count].size = MACHO_SCAN_HEAD_SIZE;
+        count++;
+    }
+    
+    return count;
+}
+
+/*
+ * reads the head of every file in batches before anything is parsed, so the magic check doesn't open the files one by one
+ * and the headers and load commands the parser walks first are already in the page cache when it maps them
+ * fat files get a second round for the heads of their slices, everything deeper (linkedit, the signature)
+ * is still only paged in when the parser gets to it
+ */
+static void macho_scan_ingest(scan_job *job){
+    macho_batch_request *requests = calloc(MACHO_SCAN_INGEST_BATCH, sizeof(macho_batch_request));
+    macho_batch_request *slices = calloc(MACHO_SCAN_INGEST_BATCH * MACHO_SCAN_MAX_FAT_ARCHS, sizeof(macho_batch_request));
+    uint8_t *buffer = malloc((size_t)MACHO_SCAN_INGEST_BATCH * MACHO_SCAN_HEAD_SIZE);
+    // reads wait on the disk rather than the cpu, so the pool can be wider than the machine
+    uint32_t threads = 4 * macho_cpu_count();
+    
+    if(!requests || !slices || !buffer){
+        // parse everything and let macho_parse reject what it doesn't know
+        for(uint32_t i = 0; i < job->count; i++)
+            job->entries[i].recognized = true;
+        
+        free(requests);
+        free(slices);
+        free(buffer);
+        return;
+    }
+    
+    for(uint32_t begin = 0; begin < job->count; begin += MACHO_SCAN_INGEST_BATCH){
+        uint32_t count = job->count - begin < MACHO_SCAN_INGEST_BATCH ? job->count - begin : MACHO_SCAN_INGEST_BATCH;
+        uint32_t num_slices = 0;
+        
+        for(uint32_t i = 0; i < count; i++){
+            requests[i].path = job->entries[begin + i].path;
+            requests[i].offset = 0;
+            requests[i].size = MACHO_SCAN_HEAD_SIZE;
+            requests[i].buffer = buffer + (size_t)i * MACHO_SCAN_HEAD_SIZE;
+        }
+        
+        macho_batch_read(requests, count, threads);
+        
+        for(uint32_t i = 0; i < count; i++){
+            scan_entry *entry = &job->entries[begin + i];
+            size_t length = requests[i].result > 0 ? (size_t)requests[i].result : 0;
+            
+            entry->recognized = macho_scan_recognized(requests[i].buffer, length);
+            entry->done = !entry->recognized;
+            
+            if(entry->recognized)
+                num_slices += macho_scan_fat_requests(job, entry, requests[i].buffer, length, &slices[num_slices]);
+        }
+        
+        // only warms the cache, the bytes themselves aren't needed so the buffer is reused
+        for(uint32_t done = 0; done < num_slices; done += MACHO_SCAN_INGEST_BATCH){
+            uint32_t round = num_slices - done < MACHO_SCAN_INGEST_BATCH ? num_slices - done : MACHO_SCAN_INGEST_BATCH;
+            
+            for(uint32_t i = 0; i < round; i++)
+                slices[done + i].buffer = buffer + (size_t)i * MACHO_SCAN_HEAD_SIZE;
+            
+            macho_batch_read(&slices[done], round, threads);
+        }
+    }
+    
+    free(requests);
+    free(slices);
+    free(buffer);
+}
+
+bool macho_scan_directory(const char *dir, symbol_table *symbols, const macho_options *options, FILE *out){
+    scan_job job;
+    
+    memset(&job, 0, sizeof(job));
+    
+    if(!macho_scan_walk(&job, dir))
+        return false;
+    
+    job.symbols = symbols;
+    job.options = *options;
+    job.out = out;
+    job.order = calloc(job.count ? job.count : 1, sizeof(uint32_t));
+    
+    scan_order *by_size = calloc(job.count ? job.count : 1, sizeof(scan_order));
+    
+    // the pool already keeps every cpu busy with whole files, threads inside a file would only fight it
+    job.options.slice_threads = 1;
+    job.options.verify_threads = 1;
+    
+    if(job.order && by_size){
+        qsort(job.entries, job.count, sizeof(scan_entry), macho_scan_compare_path);
+        macho_scan_ingest(&job);
+        
+        for(uint32_t i = 0; i < job.count; i++){
+            if(!job.entries[i].recognized)
+                continue;
+            
+            by_size[job.num_order].size = job.entries[i].size;
+            by_size[job.num_order].entry = i;
+            job.num_order++;
+        }
+        
+        // a big file started last would leave every other thread idle while it finishes
+        qsort(by_size, job.num_order, sizeof(scan_order), macho_scan_compare_size);
+        
+        for(uint32_t i = 0; i < job.num_order; i++)
+            job.order[i] = by_size[i].entry;
+        
+        pthread_mutex_init(&job.lock, NULL);
+        
+        // files that aren't parsed at all can still be ahead of the first one that is
+        macho_scan_flush(&job);
+        
+        macho_parallel_for_stealing(options->scan_threads, job.num_order, macho_scan_file, &job);
+        pthread_mutex_destroy(&job.lock);
+    }
+    
+    for(uint32_t i = 0; i < job.count; i++){
+        free(job.entries[i].path);
+        free(job.entries[i].output);
+        
+        if(job.entries[i].spill)
+            fclose(job.entries[i].spill);
+    }
+    
+    free(job.entries);
+    free(job.order);
+    free(by_size);
+    
+    return true;
+}
@@ -0,0 +1,24 @@
+#ifndef __scan_h
+#define __scan_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "parser.h"
+
+/*
+ * directory mode: every Mach-O, fat or shared cache file under a directory (an .app bundle, an SDK) is parsed in one process
+ * files are told apart by their first bytes, not their names, since most binaries in a bundle have no extension
+ * those bytes are read for many files at once (see batch_io.h) before any of them is parsed
+ * the files run on a work stealing pool biggest first, each one printing into its own buffer
+ * and the buffers are written out whole in path order as soon as every file before them is done
+ * finished output waiting on an earlier file is kept in memory up to a limit and spilled to temp files past it
+ */
+
+// whether the first length bytes of a file look like something macho_parse handles
+bool macho_scan_recognized(const uint8_t *bytes, size_t length);
+
+// parses every recognized file under dir with options, false if dir can't be walked
+bool macho_scan_directory(const char *dir, symbol_table *symbols, const macho_options *options, FILE *out);
+
+#endif
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "segment_map.h"
+
+// images have a handful of segments, usually already in order, so an insertion sort is all this needs
+static void macho_sort_segments(const macho_segment *segments, uint32_t *indexes, uint32_t count, bool by_offset){
+    for(uint32_t i = 1; i < count; i++){
+        uint32_t index = indexes[i];
+        uint64_t key = by_offset ? segments[index].fileoff : segments[index].vmaddr;
+        uint32_t j = i;
+        
+        for(; j > 0; j--){
+            const macho_segment *previous = &segments[indexes[j - 1]];
+            
+            if((by_offset ? previous->fileoff : previous->vmaddr) <= key)
+                break;
+            
+            indexes[j] = indexes[j - 1];
+        }
+        
+        indexes[j] = index;
+    }
+}
+
+bool macho_segment_map_build(macho_segment_map *map, macho_arena *arena, macho_segment *segments, uint32_t count){
+    memset(map, 0, sizeof(macho_segment_map));
+    
+    uint32_t *by_address = macho_arena_alloc(arena, (count ? count : 1) * sizeof(uint32_t));
+    uint32_t *by_offset = macho_arena_alloc(arena, (count ? count : 1) * sizeof(uint32_t));
+    
+    if(!by_address || !by_offset)
+        return false;
+    
+    map->segments = segments;
+    map->count = count;
+    map->by_address = by_address;
+    map->by_offset = by_offset;
+    
+    for(uint32_t i = 0; i < count; i++){
+        if(segments[i].vmsize)
+            map->by_address[map->num_mapped++] = i;
+        
+        if(segments[i].filesize)
+            map->by_offset[map->num_backed++] = i;
+    }
+    
+    macho_sort_segments(segments, map->by_address, map->num_mapped, false);
+    macho_sort_segments(segments, map->by_offset, map->num_backed, true);
+    
+    return true;
+}
+
+const macho_segment* macho_segment_map_find(macho_segment_map *map, uint64_t address){
+    if(!map->num_mapped)
+        return NULL;
+    
+    const macho_segment *last = &map->segments[map->by_address[map->last_address]];
+    
+    if(address >= last->vmaddr && address - last->vmaddr < last->vmsize)
+        return last;
+    
+    // the last segment starting at or below address is the only one that can contain it
+    uint32_t lo = 0;
+    uint32_t hi = map->num_mapped;
+    
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        
+        if(map->segments[map->by_address[mid]].vmaddr <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    if(!lo)
+        return NULL;
+    
+    const macho_segment *segment = &map->segments[map->by_address[lo - 1]];
+    
+    if(address - segment->vmaddr >= segment->vmsize)
+        return NULL;
+    
+    map->last_address = lo - 1;
+    
+    return segment;
+}
+
+const macho_segment* macho_segment_map_find_offset(macho_segment_map *map, uint64_t offset){
+    if(!map->num_backed)
+        return NULL;
+    
+    const macho_segment *last = &map->segments[map->by_offset[map->last_offset]];
+    
+    if(offset >= last->fileoff && offset - last->fileoff < last->filesize)
+        return last;
+    
+    uint32_t lo = 0;
+    uint32_t hi = map->num_backed;
+    
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        
+        if(map->segments[map->by_offset[mid]].fileoff <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    if(!lo)
+        return NULL;
+    
+    const macho_segment *segment = &map->segments[map->by_offset[lo - 1]];
+    
+    if(offset - segment->fileoff >= segment->filesize)
+        return NULL;
+    
+    map->last_offset = lo - 1;
+    
+    return segment;
+}
+
+bool macho_segment_map_to_offset(macho_segment_map *map, uint64_t address, uint64_t *offset){
+    const macho_segment *segment = macho_segment_map_find(map, address);
+    
+    if(!segment || address - segment->vmaddr >= segment->filesize)
+        return false;
+    
+    *offset = segment->fileoff + (address - segment->vmaddr);
+    
+    return true;
+}
+
+bool macho_segment_map_to_address(macho_segment_map *map, uint64_t offset, uint64_t *address){
+    const macho_segment *segment = macho_segment_map_find_offset(map, offset);
+    
+    if(!segment)
+        return false;
+    
+    *address = segment->vmaddr + (offset - segment->fileoff);
+    
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef __segment_map_h
+#define __segment_map_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "arena.h"
+
+typedef struct{
+    char segname[16];
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    uint64_t fileoff; // from the fileoff_base of the image, its mach header or the start of its shared cache
+    uint64_t filesize;
+} macho_segment;
+
+/*
+ * the segments of one image with both directions of address translation
+ * lookups binary search a copy of the segments sorted by address (or by file offset), after checking the
+ * segment the previous lookup landed in first since pointers tend to cluster in one segment
+ * the last hit makes a map per thread state, which it is since every image has its own
+ */
+typedef struct{
+    macho_segment *segments; // load command order, what segment indexes in fixups and binds refer to
+    uint32_t count;
+    uint32_t *by_address;    // indexes into segments sorted by vmaddr, empty segments left out
+    uint32_t num_mapped;
+    uint32_t *by_offset;     // indexes of the file backed segments sorted by fileoff
+    uint32_t num_backed;
+    uint32_t last_address;   // segment the last address lookup hit
+    uint32_t last_offset;    // segment the last offset lookup hit
+} macho_segment_map;
+
+// keeps segments, the sorted indexes come from arena, both live until the arena is reset
+bool macho_segment_map_build(macho_segment_map *map, macho_arena *arena, macho_segment *segments, uint32_t count);
+
+// segment containing address, NULL if none does
+const macho_segment* macho_segment_map_find(macho_segment_map *map, uint64_t address);
+
+// file backed segment containing offset (from the mach header), NULL if none does
+const macho_segment* macho_segment_map_find_offset(macho_segment_map *map, uint64_t offset);
+
+// address -> offset from the mach header, false if address isn't backed by the file (unmapped or zero fill)
+bool macho_segment_map_to_offset(macho_segment_map *map, uint64_t address, uint64_t *offset);
+
+// offset from the mach header -> address, false if no segment maps it
+bool macho_segment_map_to_address(macho_segment_map *map, uint64_t offset, uint64_t *address);
+
+#endif
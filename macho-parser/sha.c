@@ -0,0 +1,547 @@
+#include <string.h>
+#include <pthread.h>
+#include "sha.h"
+
+/*
+ * built in SHA-1/SHA-256 so code signatures can be checked without CommonCrypto
+ * the scalar code runs anywhere, on x86 the SHA extensions hash a single buffer and
+ * AVX2 hashes 8 independent buffers at once by giving every buffer its own 32 bit lane
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MACHO_SHA_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define MACHO_SHA_X86 0
+#endif
+
+#define SHA_BLOCK_SIZE 64
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t sha256_h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint32_t sha1_h0[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+static const uint32_t sha1_k[4] = {
+    0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6
+};
+
+typedef void (*sha_blocks_fn)(uint32_t *state, const uint8_t *data, size_t blocks);
+
+#define ROTR32(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTL32(x,n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static inline uint32_t load_be32(const uint8_t *p){
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void store_be32(uint8_t *p, uint32_t v){
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// builds the final 1 or 2 blocks of a message (leftover bytes, 0x80, zeros, bit length)
+// returns how many bytes of tail were filled
+static size_t sha_pad(uint8_t tail[2 * SHA_BLOCK_SIZE], const uint8_t *rest, size_t rem, uint64_t size){
+    size_t len = rem + 1 + 8 <= SHA_BLOCK_SIZE ? SHA_BLOCK_SIZE : 2 * SHA_BLOCK_SIZE;
+    uint64_t bits = size * 8;
+
+    memset(tail, 0, len);
+    memcpy(tail, rest, rem);
+    tail[rem] = 0x80;
+
+    for(int i = 0; i < 8; i++)
+        tail[len - 1 - i] = (uint8_t)(bits >> (8 * i));
+
+    return len;
+}
+
+static void sha256_blocks_scalar(uint32_t *state, const uint8_t *data, size_t blocks){
+    uint32_t w[64];
+
+    while(blocks--){
+        for(int t = 0; t < 16; t++)
+            w[t] = load_be32(data + 4 * t);
+
+        for(int t = 16; t < 64; t++){
+            uint32_t s0 = ROTR32(w[t-15], 7) ^ ROTR32(w[t-15], 18) ^ (w[t-15] >> 3);
+            uint32_t s1 = ROTR32(w[t-2], 17) ^ ROTR32(w[t-2], 19) ^ (w[t-2] >> 10);
+            w[t] = w[t-16] + s0 + w[t-7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for(int t = 0; t < 64; t++){
+            uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[t] + w[t];
+            uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+        data += SHA_BLOCK_SIZE;
+    }
+}
+
+static void sha1_blocks_scalar(uint32_t *state, const uint8_t *data, size_t blocks){
+    uint32_t w[80];
+
+    while(blocks--){
+        for(int t = 0; t < 16; t++)
+            w[t] = load_be32(data + 4 * t);
+
+        for(int t = 16; t < 80; t++)
+            w[t] = ROTL32(w[t-3] ^ w[t-8] ^ w[t-14] ^ w[t-16], 1);
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+        for(int t = 0; t < 80; t++){
+            uint32_t f;
+
+            if(t < 20)
+                f = (b & c) | (~b & d);
+            else if(t < 40 || t >= 60)
+                f = b ^ c ^ d;
+            else
+                f = (b & c) | (b & d) | (c & d);
+
+            uint32_t temp = ROTL32(a, 5) + f + e + sha1_k[t / 20] + w[t];
+
+            e = d; d = c; c = ROTL32(b, 30); b = a; a = temp;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+
+        data += SHA_BLOCK_SIZE;
+    }
+}
+
+#if MACHO_SHA_X86
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_shani(uint32_t *state, const uint8_t *data, size_t blocks){
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // the sha256rnds2 instruction wants the state as ABEF/CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xb1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1b);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    while(blocks--){
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+        __m128i m[4];
+
+        for(int i = 0; i < 16; i++){
+            if(i < 4){
+                m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), mask);
+            } else {
+                // W[i] from W[i-4], W[i-3], W[i-2] and W[i-1] (in groups of four words)
+                __m128i x = _mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]);
+                x = _mm_add_epi32(x, _mm_alignr_epi8(m[(i + 3) & 3], m[(i + 2) & 3], 4));
+                m[i & 3] = _mm_sha256msg2_epu32(x, m[(i + 3) & 3]);
+            }
+
+            __m128i msg = _mm_add_epi32(m[i & 3], _mm_loadu_si128((const __m128i*)&sha256_k[4 * i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0e));
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+
+        data += SHA_BLOCK_SIZE;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+// one group of four SHA-1 rounds, e_in carries E (or the rotated A) into this group
+// and e_out receives ABCD so the next group can derive its E from it
+#define SHA1_SHANI_GROUP(g, e_in, e_out) \
+    do { \
+        if((g) >= 4) \
+            m[(g) & 3] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(m[(g) & 3], m[((g) + 1) & 3]), \
+                                                          m[((g) + 2) & 3]), \
+                                            m[((g) + 3) & 3]); \
+        if((g) == 0) \
+            e_in = _mm_add_epi32(e_in, m[0]); \
+        else \
+            e_in = _mm_sha1nexte_epu32(e_in, m[(g) & 3]); \
+        e_out = abcd; \
+        abcd = _mm_sha1rnds4_epu32(abcd, e_in, (g) / 5); \
+    } while(0)
+
+__attribute__((target("sha,sse4.1")))
+static void sha1_blocks_shani(uint32_t *state, const uint8_t *data, size_t blocks){
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1b);
+    __m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+    while(blocks--){
+        __m128i abcd_save = abcd;
+        __m128i e_save = e0;
+        __m128i e1;
+        __m128i m[4];
+
+        for(int i = 0; i < 4; i++)
+            m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), mask);
+
+        SHA1_SHANI_GROUP(0, e0, e1);   SHA1_SHANI_GROUP(1, e1, e0);
+        SHA1_SHANI_GROUP(2, e0, e1);   SHA1_SHANI_GROUP(3, e1, e0);
+        SHA1_SHANI_GROUP(4, e0, e1);   SHA1_SHANI_GROUP(5, e1, e0);
+        SHA1_SHANI_GROUP(6, e0, e1);   SHA1_SHANI_GROUP(7, e1, e0);
+        SHA1_SHANI_GROUP(8, e0, e1);   SHA1_SHANI_GROUP(9, e1, e0);
+        SHA1_SHANI_GROUP(10, e0, e1);  SHA1_SHANI_GROUP(11, e1, e0);
+        SHA1_SHANI_GROUP(12, e0, e1);  SHA1_SHANI_GROUP(13, e1, e0);
+        SHA1_SHANI_GROUP(14, e0, e1);  SHA1_SHANI_GROUP(15, e1, e0);
+        SHA1_SHANI_GROUP(16, e0, e1);  SHA1_SHANI_GROUP(17, e1, e0);
+        SHA1_SHANI_GROUP(18, e0, e1);  SHA1_SHANI_GROUP(19, e1, e0);
+
+        e0 = _mm_sha1nexte_epu32(e0, e_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+
+        data += SHA_BLOCK_SIZE;
+    }
+
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#define X8_ROTR(x,n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+#define X8_ROTL(x,n) _mm256_or_si256(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+#define X8_ADD(a,b) _mm256_add_epi32((a), (b))
+#define X8_XOR(a,b) _mm256_xor_si256((a), (b))
+#define X8_AND(a,b) _mm256_and_si256((a), (b))
+#define X8_OR(a,b)  _mm256_or_si256((a), (b))
+
+// loads 8 big endian words from each of the 8 lanes and transposes them
+// so that out[i] holds word i of every lane
+__attribute__((target("avx2")))
+static inline void x8_load_words(__m256i out[8], const uint8_t *const p[8], size_t offset){
+    const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                          12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i r[8], t[8], u[8];
+
+    for(int i = 0; i < 8; i++)
+        r[i] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(p[i] + offset)), bswap);
+
+    for(int i = 0; i < 8; i += 2){
+        t[i]     = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+    }
+
+    for(int i = 0; i < 8; i += 4){
+        u[i]     = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+
+    for(int i = 0; i < 4; i++){
+        out[i]     = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        out[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+}
+
+__attribute__((target("avx2")))
+static void sha256_blocks_x8(__m256i s[8], const uint8_t *const p[8], size_t blocks){
+    for(size_t block = 0; block < blocks; block++){
+        size_t offset = block * SHA_BLOCK_SIZE;
+        __m256i w[16];
+
+        x8_load_words(&w[0], p, offset);
+        x8_load_words(&w[8], p, offset + 32);
+
+        __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+        __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+
+        for(int t = 0; t < 64; t++){
+            if(t >= 16){
+                __m256i w15 = w[(t - 15) & 15];
+                __m256i w2 = w[(t - 2) & 15];
+                __m256i s0 = X8_XOR(X8_XOR(X8_ROTR(w15, 7), X8_ROTR(w15, 18)), _mm256_srli_epi32(w15, 3));
+                __m256i s1 = X8_XOR(X8_XOR(X8_ROTR(w2, 17), X8_ROTR(w2, 19)), _mm256_srli_epi32(w2, 10));
+                w[t & 15] = X8_ADD(X8_ADD(w[t & 15], s0), X8_ADD(w[(t - 7) & 15], s1));
+            }
+
+            __m256i sigma1 = X8_XOR(X8_XOR(X8_ROTR(e, 6), X8_ROTR(e, 11)), X8_ROTR(e, 25));
+            __m256i ch = X8_XOR(X8_AND(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = X8_ADD(X8_ADD(h, sigma1), X8_ADD(ch, X8_ADD(_mm256_set1_epi32((int)sha256_k[t]), w[t & 15])));
+            __m256i sigma0 = X8_XOR(X8_XOR(X8_ROTR(a, 2), X8_ROTR(a, 13)), X8_ROTR(a, 22));
+            __m256i maj = X8_OR(X8_AND(a, b), X8_AND(c, X8_OR(a, b)));
+            __m256i t2 = X8_ADD(sigma0, maj);
+
+            h = g; g = f; f = e; e = X8_ADD(d, t1);
+            d = c; c = b; b = a; a = X8_ADD(t1, t2);
+        }
+
+        s[0] = X8_ADD(s[0], a); s[1] = X8_ADD(s[1], b); s[2] = X8_ADD(s[2], c); s[3] = X8_ADD(s[3], d);
+        s[4] = X8_ADD(s[4], e); s[5] = X8_ADD(s[5], f); s[6] = X8_ADD(s[6], g); s[7] = X8_ADD(s[7], h);
+    }
+}
+
+__attribute__((target("avx2")))
+static void sha1_blocks_x8(__m256i s[5], const uint8_t *const p[8], size_t blocks){
+    for(size_t block = 0; block < blocks; block++){
+        size_t offset = block * SHA_BLOCK_SIZE;
+        __m256i w[16];
+
+        x8_load_words(&w[0], p, offset);
+        x8_load_words(&w[8], p, offset + 32);
+
+        __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4];
+
+        for(int t = 0; t < 80; t++){
+            if(t >= 16)
+                w[t & 15] = X8_ROTL(X8_XOR(X8_XOR(w[(t - 3) & 15], w[(t - 8) & 15]),
+                                           X8_XOR(w[(t - 14) & 15], w[t & 15])), 1);
+
+            __m256i f;
+
+            if(t < 20)
+                f = X8_XOR(d, X8_AND(b, X8_XOR(c, d)));
+            else if(t < 40 || t >= 60)
+                f = X8_XOR(X8_XOR(b, c), d);
+            else
+                f = X8_OR(X8_AND(b, c), X8_AND(d, X8_OR(b, c)));
+
+            __m256i temp = X8_ADD(X8_ADD(X8_ROTL(a, 5), f),
+                                  X8_ADD(X8_ADD(e, _mm256_set1_epi32((int)sha1_k[t / 20])), w[t & 15]));
+
+            e = d; d = c; c = X8_ROTL(b, 30); b = a; a = temp;
+        }
+
+        s[0] = X8_ADD(s[0], a); s[1] = X8_ADD(s[1], b); s[2] = X8_ADD(s[2], c);
+        s[3] = X8_ADD(s[3], d); s[4] = X8_ADD(s[4], e);
+    }
+}
+
+// hashes exactly 8 equally sized buffers, words is 5 for SHA-1 and 8 for SHA-256
+__attribute__((target("avx2")))
+static void sha_x8(bool sha256, const uint8_t *const p[8], size_t size, uint8_t *const digests[8]){
+    uint32_t words = sha256 ? 8 : 5;
+    const uint32_t *h0 = sha256 ? sha256_h0 : sha1_h0;
+    uint8_t tails[8][2 * SHA_BLOCK_SIZE];
+    const uint8_t *lanes[8];
+    size_t full = size / SHA_BLOCK_SIZE;
+    size_t tail_size = 0;
+    __m256i s[8];
+
+    for(uint32_t i = 0; i < words; i++)
+        s[i] = _mm256_set1_epi32((int)h0[i]);
+
+    if(sha256)
+        sha256_blocks_x8(s, p, full);
+    else
+        sha1_blocks_x8(s, p, full);
+
+    for(int lane = 0; lane < 8; lane++){
+        tail_size = sha_pad(tails[lane], p[lane] + full * SHA_BLOCK_SIZE, size % SHA_BLOCK_SIZE, size);
+        lanes[lane] = tails[lane];
+    }
+
+    if(sha256)
+        sha256_blocks_x8(s, lanes, tail_size / SHA_BLOCK_SIZE);
+    else
+        sha1_blocks_x8(s, lanes, tail_size / SHA_BLOCK_SIZE);
+
+    uint32_t state[8][8];
+
+    for(uint32_t i = 0; i < words; i++)
+        _mm256_storeu_si256((__m256i*)state[i], s[i]);
+
+    for(int lane = 0; lane < 8; lane++)
+        for(uint32_t i = 0; i < words; i++)
+            store_be32(digests[lane] + 4 * i, state[i][lane]);
+}
+
+#endif
+
+#define SHA_CPU_AVX2  0x1
+#define SHA_CPU_SHANI 0x2
+
+static pthread_once_t sha_cpu_once = PTHREAD_ONCE_INIT;
+static uint32_t sha_cpu_features = 0;
+
+static void sha_detect_cpu(void){
+#if MACHO_SHA_X86
+    unsigned int eax, ebx, ecx, edx;
+
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return;
+
+    bool ssse3 = ecx & (1u << 9);
+    bool sse41 = ecx & (1u << 19);
+    bool osxsave = ecx & (1u << 27);
+    bool avx_state = false;
+
+    if(osxsave){
+        uint32_t lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        // the os has to save both xmm and ymm state for us to touch ymm registers
+        avx_state = (lo & 0x6) == 0x6;
+    }
+
+    if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return;
+
+    if(avx_state && (ebx & (1u << 5)))
+        sha_cpu_features |= SHA_CPU_AVX2;
+
+    if(ssse3 && sse41 && (ebx & (1u << 29)))
+        sha_cpu_features |= SHA_CPU_SHANI;
+#endif
+}
+
+bool macho_sha_engine_supported(macho_sha_engine engine){
+    pthread_once(&sha_cpu_once, sha_detect_cpu);
+
+    switch(engine){
+        case MACHO_SHA_ENGINE_SCALAR:
+            return true;
+        case MACHO_SHA_ENGINE_AVX2:
+            return (sha_cpu_features & SHA_CPU_AVX2) != 0;
+        case MACHO_SHA_ENGINE_SHANI:
+            return (sha_cpu_features & SHA_CPU_SHANI) != 0;
+    }
+
+    return false;
+}
+
+const char* macho_sha_engine_name(macho_sha_engine engine){
+    switch(engine){
+        case MACHO_SHA_ENGINE_SCALAR:
+            return "scalar";
+        case MACHO_SHA_ENGINE_AVX2:
+            return "avx2 x8";
+        case MACHO_SHA_ENGINE_SHANI:
+            return "sha-ni";
+    }
+
+    return "unknown";
+}
+
+// on page sized buffers the SHA extensions still edge out 8 AVX2 lanes where both exist,
+// and AVX2 lanes are several times faster than hashing one buffer at a time in C
+macho_sha_engine macho_sha_multi_engine(void){
+    if(macho_sha_engine_supported(MACHO_SHA_ENGINE_SHANI))
+        return MACHO_SHA_ENGINE_SHANI;
+
+    if(macho_sha_engine_supported(MACHO_SHA_ENGINE_AVX2))
+        return MACHO_SHA_ENGINE_AVX2;
+
+    return MACHO_SHA_ENGINE_SCALAR;
+}
+
+static sha_blocks_fn sha_single_blocks(bool sha256, macho_sha_engine engine){
+#if MACHO_SHA_X86
+    if(engine == MACHO_SHA_ENGINE_SHANI && macho_sha_engine_supported(MACHO_SHA_ENGINE_SHANI))
+        return sha256 ? sha256_blocks_shani : sha1_blocks_shani;
+#endif
+    return sha256 ? sha256_blocks_scalar : sha1_blocks_scalar;
+}
+
+static void sha_single(sha_blocks_fn blocks, bool sha256, const uint8_t *data, size_t size, uint8_t *digest){
+    uint32_t words = sha256 ? 8 : 5;
+    uint32_t state[8];
+    uint8_t tail[2 * SHA_BLOCK_SIZE];
+    size_t full = size / SHA_BLOCK_SIZE;
+
+    memcpy(state, sha256 ? sha256_h0 : sha1_h0, words * sizeof(uint32_t));
+
+    blocks(state, data, full);
+
+    size_t tail_size = sha_pad(tail, data + full * SHA_BLOCK_SIZE, size % SHA_BLOCK_SIZE, size);
+    blocks(state, tail, tail_size / SHA_BLOCK_SIZE);
+
+    for(uint32_t i = 0; i < words; i++)
+        store_be32(digest + 4 * i, state[i]);
+}
+
+static void sha_multi(bool sha256, macho_sha_engine engine, const uint8_t *const *data, size_t size, uint8_t *const *digests, uint32_t n){
+    uint32_t i = 0;
+
+#if MACHO_SHA_X86
+    if(engine == MACHO_SHA_ENGINE_AVX2 && macho_sha_engine_supported(MACHO_SHA_ENGINE_AVX2)){
+        for(; i + MACHO_SHA_LANES <= n; i += MACHO_SHA_LANES)
+            sha_x8(sha256, &data[i], size, &digests[i]);
+
+        // a partial group still goes through the lanes, idle lanes just rehash the first buffer
+        if(i < n){
+            const uint8_t *lanes[MACHO_SHA_LANES];
+            uint8_t scratch[MACHO_SHA_LANES][MACHO_SHA256_DIGEST_LENGTH];
+            uint8_t *out[MACHO_SHA_LANES];
+
+            for(uint32_t lane = 0; lane < MACHO_SHA_LANES; lane++){
+                bool used = i + lane < n;
+
+                lanes[lane] = used ? data[i + lane] : data[i];
+                out[lane] = used ? digests[i + lane] : scratch[lane];
+            }
+
+            sha_x8(sha256, lanes, size, out);
+        }
+
+        return;
+    }
+#endif
+
+    sha_blocks_fn blocks = sha_single_blocks(sha256, engine);
+
+    for(; i < n; i++)
+        sha_single(blocks, sha256, data[i], size, digests[i]);
+}
+
+void macho_sha1(const void *data, size_t size, uint8_t *digest){
+    sha_single(sha_single_blocks(false, MACHO_SHA_ENGINE_SHANI), false, (const uint8_t*)data, size, digest);
+}
+
+void macho_sha256(const void *data, size_t size, uint8_t *digest){
+    sha_single(sha_single_blocks(true, MACHO_SHA_ENGINE_SHANI), true, (const uint8_t*)data, size, digest);
+}
+
+void macho_sha1_multi_with(macho_sha_engine engine, const uint8_t *const *data, size_t size, uint8_t *const *digests, uint32_t n){
+    sha_multi(false, engine, data, size, digests, n);
+}
+
+void macho_sha256_multi_with(macho_sha_engine engine, const uint8_t *const *data, size_t size, uint8_t *const *digests, uint32_t n){
+    sha_multi(true, engine, data, size, digests, n);
+}
+
+void macho_sha1_multi(const uint8_t *const *data, size_t size, uint8_t *const *digests, uint32_t n){
+    sha_multi(false, macho_sha_multi_engine(), data, size, digests, n);
+}
+
+void macho_sha256_multi(const uint8_t *const *data, size_t size, uint8_t *const *digests, uint32_t n){
+    sha_multi(true, macho_sha_multi_engine(), data, size, digests, n);
+}
@@ -0,0 +1,37 @@
+#ifndef __sha_h
+#define __sha_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MACHO_SHA1_DIGEST_LENGTH   20
+#define MACHO_SHA256_DIGEST_LENGTH 32
+
+// number of independent buffers the multi-buffer engine hashes side by side
+#define MACHO_SHA_LANES 8
+
+typedef enum {
+    MACHO_SHA_ENGINE_SCALAR = 0, // plain C, works everywhere
+    MACHO_SHA_ENGINE_AVX2,       // 8 buffers at once, one per 32 bit lane of a ymm register
+    MACHO_SHA_ENGINE_SHANI       // x86 SHA extensions, one buffer at a time
+} macho_sha_engine;
+
+// one-shot digests of a single buffer, using the fastest single stream engine available
+void macho_sha1(const void *data, size_t size, uint8_t *digest);
+void macho_sha256(const void *data, size_t size, uint8_t *digest);
+
+// digests n independent buffers that all have the same size (e.g. the full code pages of an image)
+void macho_sha1_multi(const uint8_t *const *data, size_t size, uint8_t *const *digests, uint32_t n);
+void macho_sha256_multi(const uint8_t *const *data, size_t size, uint8_t *const *digests, uint32_t n);
+
+// same as above but on a specific engine, used by the benchmark to compare them
+// an engine the cpu doesn't support falls back to the scalar one
+void macho_sha1_multi_with(macho_sha_engine engine, const uint8_t *const *data, size_t size, uint8_t *const *digests, uint32_t n);
+void macho_sha256_multi_with(macho_sha_engine engine, const uint8_t *const *data, size_t size, uint8_t *const *digests, uint32_t n);
+
+bool macho_sha_engine_supported(macho_sha_engine engine);
+macho_sha_engine macho_sha_multi_engine(void);
+const char* macho_sha_engine_name(macho_sha_engine engine);
+
+#endif
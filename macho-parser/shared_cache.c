@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "shared_cache.h"
+
+// the first fields of every dyld_cache_slide_info version
+typedef struct{
+    uint32_t version;
+    uint32_t page_size;
+} macho_slide_info;
+
+typedef struct{
+    uint32_t version; // 2
+    uint32_t page_size;
+    uint32_t page_starts_offset;
+    uint32_t page_starts_count;
+    uint32_t page_extras_offset;
+    uint32_t page_extras_count;
+    uint64_t delta_mask;
+    uint64_t value_add;
+} macho_slide_info2;
+
+// versions 3 and 5 have the same head, the value to add is for signed pointers in 3 and for every pointer in 5
+typedef struct{
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t page_starts_count;
+    uint32_t pad;
+    uint64_t value_add;
+} macho_slide_info3;
+
+bool macho_is_shared_cache(macho_file *macho){
+    char magic[sizeof(MACHO_SHARED_CACHE_MAGIC) - 1];
+    
+    return macho_read(macho, 0, magic, sizeof(magic)) && memcmp(magic, MACHO_SHARED_CACHE_MAGIC, sizeof(magic)) == 0;
+}
+
+// fills in how the pointers of a mapping are encoded from the slide info at offset
+static void macho_shared_cache_slide_info(macho_file *macho, uint64_t offset, uint64_t size, macho_shared_cache_mapping *mapping){
+    macho_slide_info info;
+    
+    if(!offset || size < sizeof(info) || !macho_read(macho, offset, &info, sizeof(info)))
+        return;
+    
+    if(info.version == 2 && size >= sizeof(macho_slide_info2)){
+        macho_slide_info2 info2;
+        macho_read(macho, offset, &info2, sizeof(info2));
+        
+        mapping->slide_version = 2;
+        mapping->delta_mask = info2.delta_mask;
+        mapping->value_add = info2.value_add;
+    } else if((info.version == 3 || info.version == 5) && size >= sizeof(macho_slide_info3)){
+        macho_slide_info3 info3;
+        macho_read(macho, offset, &info3, sizeof(info3));
+        
+        mapping->slide_version = info.version;
+        mapping->value_add = info3.value_add;
+    }
+    
+    // version 1 caches store plain pointers, version 4 ones are 32 bit
+}
+
+static bool macho_shared_cache_read_mappings(macho_file *macho, const macho_shared_cache_header *header, macho_shared_cache *cache){
+    bool with_slide = header->mapping_with_slide_offset && header->mapping_with_slide_count;
+    uint32_t count = with_slide ? header->mapping_with_slide_count : header->mapping_count;
+    
+    cache->mappings = calloc(count ? count : 1, sizeof(macho_shared_cache_mapping));
+    
+    if(!cache->mappings)
+        return false;
+    
+    for(uint32_t i = 0; i < count; i++){
+        macho_shared_cache_mapping *mapping = &cache->mappings[cache->num_mappings];
+        
+        if(with_slide){
+            macho_shared_cache_mapping_and_slide_info info;
+            
+            if(!macho_read(macho, header->mapping_with_slide_offset + (uint64_t)i * sizeof(info), &info, sizeof(info)))
+                return false;
+            
+            mapping->address = info.address;
+            mapping->size = info.size;
+            mapping->fileoff = info.file_offset;
+            macho_shared_cache_slide_info(macho, info.slide_info_file_offset, info.slide_info_file_size, mapping);
+        } else {
+            macho_shared_cache_mapping_info info;
+            
+            if(!macho_read(macho, header->mapping_offset + (uint64_t)i * sizeof(info), &info, sizeof(info)))
+                return false;
+            
+            mapping->address = info.address;
+            mapping->size = info.size;
+            mapping->fileoff = info.file_offset;
+            
+            // the old header has one slide info, it belongs to the second mapping which is __DATA
+            if(i == 1)
+                macho_shared_cache_slide_info(macho, header->slide_info_offset, header->slide_info_size, mapping);
+        }
+        
+        cache->num_mappings++;
+    }
+    
+    return true;
+}
+
+bool macho_shared_cache_open(macho_file *macho, macho_shared_cache *cache){
+    macho_shared_cache_header header;
+    
+    memset(cache, 0, sizeof(macho_shared_cache));
+    memset(&header, 0, sizeof(header));
+    
+    if(!macho_is_shared_cache(macho) || !macho_read(macho, 0, &header, sizeof(header.magic) + 2 * sizeof(uint32_t)))
+        return false;
+    
+    // the mappings follow the header, so wherever they start is where this version of the header ends
+    size_t header_size = header.mapping_offset < sizeof(header) ? header.mapping_offset : sizeof(header);
+    
+    if(header_size < offsetof(macho_shared_cache_header, dyld_base_address) || !macho_read(macho, 0, &header, header_size))
+        return false;
+    
+    memset((uint8_t*)&header + header_size, 0, sizeof(header) - header_size);
+    
+    const char *arch = header.magic + strlen(MACHO_SHARED_CACHE_MAGIC);
+    
+    while(arch < header.magic + sizeof(header.magic) && *arch == ' ')
+        arch++;
+    
+    memcpy(cache->arch, arch, header.magic + sizeof(header.magic) - arch);
+    memcpy(cache->uuid, header.uuid, sizeof(cache->uuid));
+    cache->num_subcaches = header.subcache_array_count;
+    
+    if(!macho_shared_cache_read_mappings(macho, &header, cache)){
+        macho_shared_cache_close(cache);
+        return false;
+    }
+    
+    cache->base = cache->num_mappings ? cache->mappings[0].address : 0;
+    
+    // newer caches moved the image table and left the old fields 0
+    bool images_moved = header.images_count != 0;
+    uint32_t images_offset = images_moved ? header.images_offset : header.images_offset_old;
+    uint32_t images_count = images_moved ? header.images_count : header.images_count_old;
+    
+    if(!macho_get_range(macho, images_offset, (uint64_t)images_count * sizeof(macho_shared_cache_image_info))){
+        macho_shared_cache_close(cache);
+        return false;
+    }
+    
+    cache->images = calloc(images_count ? images_count : 1, sizeof(macho_shared_cache_image));
+    
+    if(!cache->images){
+        macho_shared_cache_close(cache);
+        return false;
+    }
+    
+    for(uint32_t i = 0; i < images_count; i++){
+        macho_shared_cache_image_info info;
+        macho_shared_cache_image *image = &cache->images[cache->num_images++];
+        
+        macho_read(macho, images_offset + (uint64_t)i * sizeof(info), &info, sizeof(info));
+        
+        image->path = macho_read_string(macho, info.path_file_offset);
+        image->address = info.address;
+        
+        if(!image->path)
+            image->path = "";
+        
+        if(!macho_shared_cache_address_to_offset(cache, info.address, &image->headeroff))
+            image->headeroff = UINT64_MAX;
+    }
+    
+    return true;
+}
+
+void macho_shared_cache_close(macho_shared_cache *cache){
+    free(cache->mappings);
+    free(cache->images);
+    memset(cache, 0, sizeof(macho_shared_cache));
+}
+
+const macho_shared_cache_image* macho_shared_cache_find_image(const macho_shared_cache *cache, const char *name){
+    const macho_shared_cache_image *leaf = NULL;
+    
+    for(uint32_t i = 0; i < cache->num_images; i++){
+        const char *path = cache->images[i].path;
+        const char *slash = strrchr(path, '/');
+        
+        if(strcmp(path, name) == 0)
+            return &cache->images[i];
+        
+        if(!leaf && slash && strcmp(slash + 1, name) == 0)
+            leaf = &cache->images[i];
+    }
+    
+    return leaf;
+}
+
+static const macho_shared_cache_mapping* macho_shared_cache_mapping_at(const macho_shared_cache *cache, uint64_t address){
+    for(uint32_t i = 0; i < cache->num_mappings; i++){
+        const macho_shared_cache_mapping *mapping = &cache->mappings[i];
+        
+        if(address >= mapping->address && address - mapping->address < mapping->size)
+            return mapping;
+    }
+    
+    return NULL;
+}
+
+bool macho_shared_cache_address_to_offset(const macho_shared_cache *cache, uint64_t address, uint64_t *offset){
+    const macho_shared_cache_mapping *mapping = macho_shared_cache_mapping_at(cache, address);
+    
+    if(!mapping)
+        return false;
+    
+    *offset = mapping->fileoff + (address - mapping->address);
+    
+    return true;
+}
+
+uint64_t macho_shared_cache_resolve_pointer(const macho_shared_cache *cache, uint64_t address, uint64_t raw){
+    const macho_shared_cache_mapping *mapping = macho_shared_cache_mapping_at(cache, address);
+    
+    if(!mapping)
+        return raw;
+    
+    switch(mapping->slide_version){
+        case 2:
+            ;
+            uint64_t value = raw & ~mapping->delta_mask;
+            
+            return value ? value + mapping->value_add : 0;
+        case 3:
+            // signed pointers hold an offset from the cache, plain ones a 43 bit address under their top byte tag
+            // the tag is dropped like it is for chained fixups
+            if(raw >> 63)
+                return (raw & 0xffffffff) + mapping->value_add;
+            
+            return raw & 0x000007ffffffffffULL;
+        case 5:
+            // signed or not, a 34 bit offset from the cache
+            return (raw & 0x3ffffffffULL) + mapping->value_add;
+        default:
+            return raw;
+    }
+}
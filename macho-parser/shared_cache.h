@@ -0,0 +1,121 @@
+#ifndef __shared_cache_h
+#define __shared_cache_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "parser.h"
+
+/*
+ * a dyld shared cache is every system library prelinked into one file: a header, a table of mappings
+ * (address ranges and where in the file they are), a table of images and the images themselves
+ * the load commands of an image in the cache count their file offsets from the start of the cache,
+ * and all of them share one __LINKEDIT, so an image is parsed in place with macho->fileoff_base at 0
+ * only the header, the two tables and the pages of the images that are asked about get touched
+ *
+ * the SDK doesn't ship dyld_cache_format.h, the layouts below are the parts of it used here
+ */
+
+#define MACHO_SHARED_CACHE_MAGIC "dyld_v1"
+
+// dyld_cache_header up to imagesCount, fields past mappingOffset aren't there in older caches and read as 0
+typedef struct{
+    char magic[16];                     // "dyld_v1" padded with spaces up to the architecture name
+    uint32_t mapping_offset;
+    uint32_t mapping_count;
+    uint32_t images_offset_old;         // the image table before imagesOffset moved it
+    uint32_t images_count_old;
+    uint64_t dyld_base_address;
+    uint64_t code_signature_offset;
+    uint64_t code_signature_size;
+    uint64_t slide_info_offset;         // slide info of the data mapping in caches without mapping_with_slide
+    uint64_t slide_info_size;
+    uint64_t local_symbols_offset;
+    uint64_t local_symbols_size;
+    uint8_t uuid[16];
+    uint8_t unused0[0xe0 - 0x68];
+    uint64_t shared_region_start;
+    uint64_t shared_region_size;
+    uint64_t max_slide;
+    uint8_t unused1[0x138 - 0xf8];
+    uint32_t mapping_with_slide_offset; // dyld_cache_mapping_and_slide_info, one per mapping
+    uint32_t mapping_with_slide_count;
+    uint8_t unused2[0x188 - 0x140];
+    uint32_t subcache_array_offset;     // the .01, .02 ... files of a split cache
+    uint32_t subcache_array_count;
+    uint8_t unused3[0x1c0 - 0x190];
+    uint32_t images_offset;
+    uint32_t images_count;
+} macho_shared_cache_header;
+
+typedef struct{
+    uint64_t address;
+    uint64_t size;
+    uint64_t file_offset;
+    uint32_t max_prot;
+    uint32_t init_prot;
+} macho_shared_cache_mapping_info;
+
+typedef struct{
+    uint64_t address;
+    uint64_t size;
+    uint64_t file_offset;
+    uint64_t slide_info_file_offset;
+    uint64_t slide_info_file_size;
+    uint64_t flags;
+    uint32_t max_prot;
+    uint32_t init_prot;
+} macho_shared_cache_mapping_and_slide_info;
+
+typedef struct{
+    uint64_t address;
+    uint64_t mod_time;
+    uint64_t inode;
+    uint32_t path_file_offset;
+    uint32_t pad;
+} macho_shared_cache_image_info;
+
+// one mapping with what's needed to turn the pointers stored in it back into addresses
+typedef struct{
+    uint64_t address;
+    uint64_t size;
+    uint64_t fileoff;
+    uint32_t slide_version; // 0 when the mapping has no slide info and holds plain pointers
+    uint64_t delta_mask;    // version 2: the bits of a pointer that link it to the next one
+    uint64_t value_add;     // version 2 and 5: added to the offset a pointer holds, version 3: added to signed ones
+} macho_shared_cache_mapping;
+
+typedef struct{
+    const char *path;   // install name, points into the mapped cache
+    uint64_t address;   // of the mach header
+    uint64_t headeroff; // file offset of the mach header, UINT64_MAX when it's in another file of a split cache
+} macho_shared_cache_image;
+
+typedef struct{
+    char arch[16];      // the architecture half of the magic, nul terminated
+    uint8_t uuid[16];
+    uint64_t base;      // address of the first mapping, where the cache gets loaded
+    macho_shared_cache_mapping *mappings;
+    uint32_t num_mappings;
+    macho_shared_cache_image *images;
+    uint32_t num_images;
+    uint32_t num_subcaches;
+} macho_shared_cache;
+
+// whether the file starts with a shared cache magic
+bool macho_is_shared_cache(macho_file *macho);
+
+// reads the header, mappings, slide info headers and the image table, false if they're malformed
+bool macho_shared_cache_open(macho_file *macho, macho_shared_cache *cache);
+void macho_shared_cache_close(macho_shared_cache *cache);
+
+// the image whose install name is name, or whose last path component is if no install name matches
+const macho_shared_cache_image* macho_shared_cache_find_image(const macho_shared_cache *cache, const char *name);
+
+// cache address -> file offset through the mappings, false if no mapping of this file backs it
+bool macho_shared_cache_address_to_offset(const macho_shared_cache *cache, uint64_t address, uint64_t *offset);
+
+// the address a pointer stored at address holds, undoing the slide info encoding of its mapping
+uint64_t macho_shared_cache_resolve_pointer(const macho_shared_cache *cache, uint64_t address, uint64_t raw);
+
+#endif
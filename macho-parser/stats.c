@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+static const char *macho_phase_names[MACHO_NUM_PHASES] = {
+    "load", "headers", "symtab", "lookups", "objc", "signature", "disassembly", "fixups", "exports", "cache"
+};
+
+static const char *macho_counter_names[MACHO_NUM_COUNTERS] = {
+    "bytes", "load_commands", "symbols", "pages_hashed", "classes", "methods", "instructions", "fixups", "exports", "lookups"
+};
+
+bool macho_parse_stats_format(const char *name, macho_stats_format *format){
+    if(strcmp(name, "table") == 0)
+        *format = MACHO_STATS_TABLE;
+    else if(strcmp(name, "json") == 0)
+        *format = MACHO_STATS_JSON;
+    else
+        return false;
+    
+    return true;
+}
+
+uint64_t macho_stats_now(void){
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void macho_stats_start(macho_stats *stats, macho_phase phase){
+    memset(stats, 0, sizeof(macho_stats));
+    stats->start = stats->last = macho_stats_now();
+    stats->current = phase;
+    stats->phase_calls[phase] = 1;
+}
+
+// charges the time since the last switch to the current phase
+static void macho_stats_switch(macho_stats *stats, macho_phase phase){
+    uint64_t now = macho_stats_now();
+    
+    stats->phase_ns[stats->current] += now - stats->last;
+    stats->last = now;
+    stats->current = phase;
+}
+
+macho_phase macho_stats_enter(macho_stats *stats, macho_phase phase){
+    if(!stats)
+        return MACHO_PHASE_HEADERS;
+    
+    macho_phase previous = stats->current;
+    
+    macho_stats_switch(stats, phase);
+    stats->phase_calls[phase]++;
+    
+    return previous;
+}
+
+void macho_stats_leave(macho_stats *stats, macho_phase previous){
+    if(stats)
+        macho_stats_switch(stats, previous);
+}
+
+void macho_stats_stop(macho_stats *stats){
+    macho_stats_switch(stats, stats->current);
+}
+
+void macho_stats_resume(macho_stats *stats){
+    stats->last = macho_stats_now();
+}
+
+void macho_stats_add(macho_stats *stats, const macho_stats *other){
+    for(int i = 0; i < MACHO_NUM_PHASES; i++){
+        stats->phase_ns[i] += other->phase_ns[i];
+        stats->phase_calls[i] += other->phase_calls[i];
+    }
+    
+    for(int i = 0; i < MACHO_NUM_COUNTERS; i++)
+        stats->counters[i] += other->counters[i];
+}
+
+static void macho_stats_json_string(FILE *out, const char *string){
+    fputc('"', out);
+    
+    for(const uint8_t *p = (const uint8_t*)string; *p; p++){
+        if(*p == '"' || *p == '\\')
+            fprintf(out, "\\%c", *p);
+        else if(*p < 0x20)
+            fprintf(out, "\\u%04x", *p);
+        else
+            fputc(*p, out);
+    }
+    
+    fputc('"', out);
+}
+
+void macho_stats_report(macho_stats *stats, const char *path, macho_stats_format format, FILE *out){
+    macho_stats_stop(stats);
+    
+    uint64_t wall = stats->last - stats->start;
+    uint64_t total = 0;
+    
+    for(int i = 0; i < MACHO_NUM_PHASES; i++)
+        total += stats->phase_ns[i];
+    
+    // built whole and written at once
+    char *report = NULL;
+    size_t size = 0;
+    FILE *buffer = open_memstream(&report, &size);
+    
+    if(!buffer)
+        return;
+    
+    if(format == MACHO_STATS_JSON){
+        fprintf(buffer, "{\"path\":");
+        macho_stats_json_string(buffer, path);
+        fprintf(buffer, ",\"wall_ns\":%llu,\"phases\":{", (unsigned long long)wall);
+        
+        for(int i = 0; i < MACHO_NUM_PHASES; i++)
+            fprintf(buffer, "%s\"%s\":{\"ns\":%llu,\"calls\":%llu}", i ? "," : "", macho_phase_names[i],
+                    (unsigned long long)stats->phase_ns[i], (unsigned long long)stats->phase_calls[i]);
+        
+        fprintf(buffer, "},\"counters\":{");
+        
+        for(int i = 0; i < MACHO_NUM_COUNTERS; i++)
+            fprintf(buffer, "%s\"%s\":%llu", i ? "," : "", macho_counter_names[i], (unsigned long long)stats->counters[i]);
+        
+        fprintf(buffer, "}}\n");
+    } else {
+        fprintf(buffer, "Stats for %s, %.3f ms\n", path, wall / 1e6);
+        fprintf(buffer, "\t%-14s %8s %12s %7s\n", "phase", "calls", "ms", "%");
+        
+        for(int i = 0; i < MACHO_NUM_PHASES; i++){
+            if(!stats->phase_calls[i])
+                continue;
+            
+            fprintf(buffer, "\t%-14s %8llu %12.3f %6.1f%%\n", macho_phase_names[i], (unsigned long long)stats->phase_calls[i],
+                    stats->phase_ns[i] / 1e6, total ? 100.0 * stats->phase_ns[i] / total : 0);
+        }
+        
+        for(int i = 0; i < MACHO_NUM_COUNTERS; i++)
+            fprintf(buffer, "\t%-14s %8llu\n", macho_counter_names[i], (unsigned long long)stats->counters[i]);
+    }
+    
+    fclose(buffer);
+    fwrite(report, 1, size, out);
+    fflush(out);
+    free(report);
+}
@@ -0,0 +1,85 @@
+#ifndef __stats_h
+#define __stats_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * --stats: where the time of one file went and how much work it was
+ * time is split into phases with the monotonic clock, a phase entered inside another one (disassembling a symbol
+ * found while walking the symbol table) pauses the outer one, so every nanosecond is counted exactly once
+ * whatever isn't in a named phase (the mach header, load commands, printing) counts as headers
+ * the slices of a fat file are timed separately and added up, so with parallel slices the phases add up to more than the wall time
+ * the report goes to stderr, one write per file so reports of a directory scan don't interleave, and stdout stays parseable
+ */
+
+typedef enum{
+    MACHO_STATS_NONE,
+    MACHO_STATS_TABLE,
+    MACHO_STATS_JSON
+} macho_stats_format;
+
+typedef enum{
+    MACHO_PHASE_LOAD,        // opening and mapping the file
+    MACHO_PHASE_HEADERS,
+    MACHO_PHASE_SYMTAB,
+    MACHO_PHASE_LOOKUPS,
+    MACHO_PHASE_OBJC,
+    MACHO_PHASE_SIGNATURE,   // code directory, page hashing included
+    MACHO_PHASE_DISASSEMBLY,
+    MACHO_PHASE_FIXUPS,
+    MACHO_PHASE_EXPORTS,
+    MACHO_PHASE_CACHE,       // building or querying a --cache
+    MACHO_NUM_PHASES
+} macho_phase;
+
+typedef enum{
+    MACHO_COUNTER_BYTES,         // asked for through macho_get_range, macho_read and macho_read_string
+    MACHO_COUNTER_LOAD_COMMANDS,
+    MACHO_COUNTER_SYMBOLS,       // symbol table entries walked
+    MACHO_COUNTER_PAGES_HASHED,
+    MACHO_COUNTER_CLASSES,       // objc classes and metaclasses
+    MACHO_COUNTER_METHODS,
+    MACHO_COUNTER_INSTRUCTIONS,
+    MACHO_COUNTER_FIXUPS,
+    MACHO_COUNTER_EXPORTS,
+    MACHO_COUNTER_LOOKUPS,
+    MACHO_NUM_COUNTERS
+} macho_counter;
+
+typedef struct{
+    uint64_t phase_ns[MACHO_NUM_PHASES];
+    uint64_t phase_calls[MACHO_NUM_PHASES];
+    uint64_t counters[MACHO_NUM_COUNTERS];
+    uint64_t start;   // when the file was started on
+    uint64_t last;    // when the current phase was last entered or resumed
+    macho_phase current;
+} macho_stats;
+
+// parses "table" or "json", false for anything else
+bool macho_parse_stats_format(const char *name, macho_stats_format *format);
+
+uint64_t macho_stats_now(void);
+
+// zeroes stats and starts timing in phase
+void macho_stats_start(macho_stats *stats, macho_phase phase);
+
+// charges the time so far to the current phase and stops the clock until macho_stats_resume
+// e.g. while fat slices are timed on stats of their own
+void macho_stats_stop(macho_stats *stats);
+void macho_stats_resume(macho_stats *stats);
+
+// switches to phase until macho_stats_leave with what this returns, stats can be NULL when --stats is off
+macho_phase macho_stats_enter(macho_stats *stats, macho_phase phase);
+void macho_stats_leave(macho_stats *stats, macho_phase previous);
+
+// adds the phases and counters of other (a fat slice) into stats
+void macho_stats_add(macho_stats *stats, const macho_stats *other);
+
+// stops the clock and writes the report for path to out
+void macho_stats_report(macho_stats *stats, const char *path, macho_stats_format format, FILE *out);
+
+#define macho_count(macho, counter, n) do{ if((macho)->stats) (macho)->stats->counters[counter] += (n); } while(0)
+
+#endif
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mach-o.h"
+#include "symindex.h"
+
+#define MACHO_MAX_SECTIONS 255
+
+// end address of every section by its 1 based ordinal, which is what n_sect refers to
+static uint32_t macho_section_ends(macho_file *macho, uint64_t headeroff, uint64_t ends[MACHO_MAX_SECTIONS + 1]){
+    struct mach_header header;
+    uint32_t nsections = 0;
+    
+    if(headeroff + sizeof(struct mach_header_64) > macho->size)
+        return 0;
+    
+    macho_read(macho, headeroff, &header, sizeof(struct mach_header));
+    
+    // byte swapped images don't get section bounds, their symbols end at the next symbol
+    if(header.magic != MH_MAGIC && header.magic != MH_MAGIC_64)
+        return 0;
+    
+    bool is64 = header.magic == MH_MAGIC_64;
+    uint64_t offset = headeroff + (is64 ? sizeof(struct mach_header_64) : sizeof(struct mach_header));
+    
+    for(uint32_t i = 0; i < header.ncmds && offset + sizeof(struct load_command) <= macho->size; i++){
+        struct load_command load_cmd;
+        macho_read(macho, offset, &load_cmd, sizeof(struct load_command));
+        
+        if(load_cmd.cmd == LC_SEGMENT_64 && load_cmd.cmdsize >= sizeof(struct segment_command_64) && offset + load_cmd.cmdsize <= macho->size){
+            struct segment_command_64 *segment = macho_get_range(macho, offset, load_cmd.cmdsize);
+            struct section_64 *sections = (struct section_64*)(segment + 1);
+            // never past the end of the command, whatever nsects says
+            uint32_t nsects = (uint32_t)((load_cmd.cmdsize - sizeof(struct segment_command_64)) / sizeof(struct section_64));
+            
+            if(segment->nsects < nsects)
+                nsects = segment->nsects;
+            
+            for(uint32_t j = 0; j < nsects && nsections < MACHO_MAX_SECTIONS; j++)
+                ends[++nsections] = sections[j].addr + sections[j].size;
+        } else if(load_cmd.cmd == LC_SEGMENT && load_cmd.cmdsize >= sizeof(struct segment_command) && offset + load_cmd.cmdsize <= macho->size){
+            struct segment_command *segment = macho_get_range(macho, offset, load_cmd.cmdsize);
+            struct section *sections = (struct section*)(segment + 1);
+            uint32_t nsects = (uint32_t)((load_cmd.cmdsize - sizeof(struct segment_command)) / sizeof(struct section));
+            
+            if(segment->nsects < nsects)
+                nsects = segment->nsects;
+            
+            for(uint32_t j = 0; j < nsects && nsections < MACHO_MAX_SECTIONS; j++)
+                ends[++nsections] = (uint64_t)sections[j].addr + sections[j].size;
+        }
+        
+        if(load_cmd.cmdsize == 0)
+            break;
+        
+        offset += load_cmd.cmdsize;
+    }
+    
+    return nsections;
+}
+
+static int macho_symbol_compare(const void *a, const void *b){
+    const macho_symbol *lhs = a;
+    const macho_symbol *rhs = b;
+    
+    if(lhs->address != rhs->address)
+        return lhs->address < rhs->address ? -1 : 1;
+    
+    return lhs->name < rhs->name ? -1 : lhs->name > rhs->name;
+}
+
+bool macho_symbol_index_build(macho_file *macho,
+                              macho_symbol_index *index,
+                              uint64_t headeroff,
+                              uint32_t symoff,
+                              uint32_t nsyms,
+                              uint32_t stroff,
+                              uint32_t strsize){
+    memset(index, 0, sizeof(macho_symbol_index));
+    
+    uint32_t magic;
+    macho_read(macho, headeroff, &magic, sizeof(uint32_t));
+    
+    bool is64 = macho_64bit(magic);
+    size_t nlist_size = is64 ? sizeof(struct nlist_64) : sizeof(struct nlist);
+    
+    if(macho->fileoff_base + symoff + (uint64_t)nsyms * nlist_size > macho->size ||
+       macho->fileoff_base + stroff + strsize > macho->size)
+        return false;
+    
+    uint64_t section_ends[MACHO_MAX_SECTIONS + 1];
+    uint32_t nsections = macho_section_ends(macho, headeroff, section_ends);
+    
+    index->symbols = macho_arena_alloc(&macho->arena, (nsyms ? nsyms : 1) * sizeof(macho_symbol));
+    index->strtab = macho_get_range(macho, macho->fileoff_base + stroff, strsize);
+    index->strsize = strsize;
+    
+    if(!index->symbols)
+        return false;
+    
+    uint8_t *nlists = macho_get_range(macho, macho->fileoff_base + symoff, (uint64_t)nsyms * nlist_size);
+    
+    for(uint32_t i = 0; i < nsyms; i++){
+        uint8_t type, sect;
+        uint32_t strx;
+        uint64_t value;
+        
+        macho_window_use(macho, nlists + i * nlist_size, nlist_size);
+        
+        if(is64){
+            struct nlist_64 *nl = (struct nlist_64*)(nlists + i * nlist_size);
+            type = nl->n_type; sect = nl->n_sect; strx = nl->n_un.n_strx; value = nl->n_value;
+        } else {
+            struct nlist *nl = (struct nlist*)(nlists + i * nlist_size);
+            type = nl->n_type; sect = nl->n_sect; strx = nl->n_un.n_strx; value = nl->n_value;
+        }
+        
+        if((type & N_STAB) || (type & N_TYPE) != N_SECT || strx >= strsize)
+            continue;
+        
+        macho_symbol *symbol = &index->symbols[index->count++];
+        
+        symbol->address = value;
+        symbol->name = strx;
+        // park the section ordinal in size until the symbols are sorted
+        symbol->size = sect;
+    }
+    
+    qsort(index->symbols, index->count, sizeof(macho_symbol), macho_symbol_compare);
+    
+    // a symbol runs up to the next higher address but never past the end of its own section
+    uint64_t next = UINT64_MAX;
+    
+    for(uint32_t i = index->count; i-- > 0;){
+        macho_symbol *symbol = &index->symbols[i];
+        uint32_t sect = symbol->size;
+        uint64_t end = next;
+        
+        if(sect && sect <= nsections && section_ends[sect] > symbol->address && section_ends[sect] < end)
+            end = section_ends[sect];
+        
+        if(end == UINT64_MAX || end - symbol->address > UINT32_MAX)
+            symbol->size = 0;
+        else
+            symbol->size = (uint32_t)(end - symbol->address);
+        
+        if(i == 0 || index->symbols[i - 1].address != symbol->address)
+            next = symbol->address;
+    }
+    
+    return true;
+}
+
+void macho_symbol_index_bound(macho_symbol_index *index, const uint64_t *starts, uint32_t count){
+    uint32_t next = 0;
+    
+    // both lists are sorted, walk them together
+    for(uint32_t i = 0; i < index->count; i++){
+        macho_symbol *symbol = &index->symbols[i];
+        
+        while(next < count && starts[next] <= symbol->address)
+            next++;
+        
+        if(next == count)
+            break;
+        
+        uint64_t limit = starts[next] - symbol->address;
+        
+        if(limit <= UINT32_MAX && (symbol->size == 0 || limit < symbol->size))
+            symbol->size = (uint32_t)limit;
+    }
+}
+
+static bool macho_symbol_contains(const macho_symbol *symbol, uint64_t address){
+    return address >= symbol->address && (symbol->size == 0 || address - symbol->address < symbol->size);
+}
+
+// index of the first symbol starting above address
+static uint32_t macho_symbol_upper_bound(const macho_symbol_index *index, uint64_t address){
+    uint32_t lo = 0;
+    uint32_t hi = index->count;
+    
+    while(lo < hi){
+        uint32_t mid = lo + (hi - lo) / 2;
+        
+        if(index->symbols[mid].address <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    return lo;
+}
+
+const macho_symbol* macho_symbol_index_next(const macho_symbol_index *index, uint64_t address){
+    uint32_t next = macho_symbol_upper_bound(index, address);
+    
+    return next < index->count ? &index->symbols[next] : NULL;
+}
+
+const macho_symbol* macho_symbol_index_lookup(const macho_symbol_index *index, uint64_t address){
+    // the candidate is the symbol right before the first one above address
+    uint32_t lo = macho_symbol_upper_bound(index, address);
+    
+    if(lo == 0)
+        return NULL;
+    
+    const macho_symbol *symbol = &index->symbols[lo - 1];
+    
+    return macho_symbol_contains(symbol, address) ? symbol : NULL;
+}
+
+typedef struct{
+    uint64_t address;
+    size_t position;
+} macho_address_query;
+
+static int macho_query_compare(const void *a, const void *b){
+    const macho_address_query *lhs = a;
+    const macho_address_query *rhs = b;
+    
+    return lhs->address < rhs->address ? -1 : lhs->address > rhs->address;
+}
+
+void macho_symbol_index_lookup_batch(const macho_symbol_index *index,
+                                     const uint64_t *addresses,
+                                     const macho_symbol **results,
+                                     size_t n){
+    macho_address_query *queries = malloc((n ? n : 1) * sizeof(macho_address_query));
+    
+    if(!queries){
+        for(size_t i = 0; i < n; i++)
+            results[i] = macho_symbol_index_lookup(index, addresses[i]);
+        
+        return;
+    }
+    
+    for(size_t i = 0; i < n; i++){
+        queries[i].address = addresses[i];
+        queries[i].position = i;
+    }
+    
+    qsort(queries, n, sizeof(macho_address_query), macho_query_compare);
+    
+    // both sides are sorted now so one forward pass over the index answers everything
+    uint32_t cursor = 0;
+    
+    for(size_t i = 0; i < n; i++){
+        uint64_t address = queries[i].address;
+        
+        while(cursor < index->count && index->symbols[cursor].address <= address)
+            cursor++;
+        
+        const macho_symbol *symbol = cursor ? &index->symbols[cursor - 1] : NULL;
+        
+        results[queries[i].position] = symbol && macho_symbol_contains(symbol, address) ? symbol : NULL;
+    }
+    
+    free(queries);
+}
+
+const char* macho_symbol_index_name(const macho_symbol_index *index, const macho_symbol *symbol){
+    return index->strtab + symbol->name;
+}
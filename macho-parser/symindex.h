@@ -0,0 +1,54 @@
+#ifndef __symindex_h
+#define __symindex_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "parser.h"
+
+// one defined symbol, 16 bytes so four of them share a cache line during the binary search
+typedef struct{
+    uint64_t address;
+    uint32_t size; // up to the next symbol or the end of its section, 0 if unknown
+    uint32_t name; // offset of the name in the string table
+} macho_symbol;
+
+// every N_SECT symbol of an image sorted by address
+typedef struct{
+    macho_symbol *symbols;
+    uint32_t count;
+    const char *strtab;
+    uint32_t strsize;
+} macho_symbol_index;
+
+// builds the index from an image's nlist/nlist_64 table
+// headeroff is where the mach header starts, the other offsets are the LC_SYMTAB fields
+// and count from the fileoff_base of the current image, so the image has to be loaded first
+// the symbols come from the image's arena and go away when the image is released
+bool macho_symbol_index_build(macho_file *macho,
+                              macho_symbol_index *index,
+                              uint64_t headeroff,
+                              uint32_t symoff,
+                              uint32_t nsyms,
+                              uint32_t stroff,
+                              uint32_t strsize);
+
+// shortens every symbol so it ends at the next function start, starts must be ascending
+void macho_symbol_index_bound(macho_symbol_index *index, const uint64_t *starts, uint32_t count);
+
+// the symbol containing address, NULL if it isn't inside any symbol. O(log n)
+const macho_symbol* macho_symbol_index_lookup(const macho_symbol_index *index, uint64_t address);
+
+// the first symbol starting above address, NULL if there is none
+const macho_symbol* macho_symbol_index_next(const macho_symbol_index *index, uint64_t address);
+
+// resolves n addresses at once, results[i] is the symbol containing addresses[i] or NULL
+// the addresses are sorted once and merged against the index, which beats n binary searches for large batches
+void macho_symbol_index_lookup_batch(const macho_symbol_index *index,
+                                     const uint64_t *addresses,
+                                     const macho_symbol **results,
+                                     size_t n);
+
+const char* macho_symbol_index_name(const macho_symbol_index *index, const macho_symbol *symbol);
+
+#endif
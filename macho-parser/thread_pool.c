@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "thread_pool.h"
+
+#define MACHO_PARALLEL_BATCH 8
+
+typedef struct{
+    macho_parallel_fn fn;
+    void *ctx;
+    uint32_t count;
+    uint32_t batch;
+    _Atomic uint32_t next;
+} parallel_job;
+
+static void* macho_parallel_worker(void *arg){
+    parallel_job *job = (parallel_job*)arg;
+    
+    for(;;){
+        uint32_t begin = atomic_fetch_add(&job->next, job->batch);
+        
+        if(begin >= job->count)
+            break;
+        
+        uint32_t end = begin + job->batch;
+        
+        if(end > job->count)
+            end = job->count;
+        
+        for(uint32_t i = begin; i < end; i++)
+            job->fn(job->ctx, i);
+    }
+    
+    return NULL;
+}
+
+uint32_t macho_cpu_count(void){
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (uint32_t)n : 1;
+}
+
+void macho_parallel_for(uint32_t nthreads, uint32_t count, macho_parallel_fn fn, void *ctx){
+    macho_parallel_for_batch(nthreads, count, MACHO_PARALLEL_BATCH, fn, ctx);
+}
+
+void macho_parallel_for_batch(uint32_t nthreads, uint32_t count, uint32_t batch, macho_parallel_fn fn, void *ctx){
+    parallel_job job;
+    
+    if(batch == 0)
+        batch = 1;
+    
+    job.fn = fn;
+    job.ctx = ctx;
+    job.count = count;
+    job.batch = batch;
+    atomic_init(&job.next, 0);
+    
+    if(nthreads == 0)
+        nthreads = macho_cpu_count();
+    
+    // no point in spinning up threads that will never get a batch
+    uint32_t batches = (count + batch - 1) / batch;
+    
+    if(nthreads > batches)
+        nthreads = batches;
+    
+    pthread_t *threads = nthreads > 1 ? calloc(nthreads - 1, sizeof(pthread_t)) : NULL;
+    uint32_t spawned = 0;
+    
+    for(uint32_t i = 0; threads && i < nthreads - 1; i++){
+        if(pthread_create(&threads[i], NULL, macho_parallel_worker, &job) != 0)
+            break;
+        
+        spawned++;
+    }
+    
+    // the calling thread works too, so this still finishes if no thread could be spawned
+    macho_parallel_worker(&job);
+    
+    for(uint32_t i = 0; i < spawned; i++)
+        pthread_join(threads[i], NULL);
+    
+    free(threads);
+}
+
+// positions left in a queue, the next one in the low half and the end in the high half
+// the owner takes from the front and thieves from the back, both with one compare and swap of the pair
+typedef struct{
+    _Alignas(64) _Atomic uint64_t range;
+} steal_queue;
+
+typedef struct{
+    macho_parallel_fn fn;
+    void *ctx;
+    uint32_t nthreads;
+    uint32_t *starts; // first position of each thread's initial queue, nthreads + 1 entries
+    steal_queue *queues;
+    _Atomic uint32_t next_thread;
+} stealing_job;
+
+static inline uint64_t steal_range(uint32_t begin, uint32_t end){
+    return ((uint64_t)end << 32) | begin;
+}
+
+// queue w starts out with positions [starts[w], starts[w + 1]) which stand for indices w, w + nthreads, w + 2 * nthreads ...
+// positions keep that meaning when they are stolen, so the index of one is found through the queue it started in
+static uint32_t macho_stealing_index(stealing_job *job, uint32_t position){
+    uint32_t owner = 0;
+    
+    while(position >= job->starts[owner + 1])
+        owner++;
+    
+    return owner + (position - job->starts[owner]) * job->nthreads;
+}
+
+static bool macho_stealing_pop(steal_queue *queue, uint32_t *position){
+    uint64_t range = atomic_load(&queue->range);
+    
+    for(;;){
+        uint32_t begin = (uint32_t)range;
+        uint32_t end = (uint32_t)(range >> 32);
+        
+        if(begin >= end)
+            return false;
+        
+        if(atomic_compare_exchange_weak(&queue->range, &range, steal_range(begin + 1, end))){
+            *position = begin;
+            return true;
+        }
+    }
+}
+
+// moves the back half of the fullest other queue into self's empty one, false once every queue is empty
+static bool macho_stealing_steal(stealing_job *job, uint32_t self){
+    for(;;){
+        uint32_t victim = UINT32_MAX;
+        uint32_t most = 0;
+        uint64_t seen = 0;
+        
+        for(uint32_t i = 0; i < job->nthreads; i++){
+            uint64_t range = atomic_load(&job->queues[i].range);
+            uint32_t left = (uint32_t)(range >> 32) - (uint32_t)range;
+            
+            if(i != self && (uint32_t)range < (uint32_t)(range >> 32) && left > most){
+                victim = i;
+                most = left;
+                seen = range;
+            }
+        }
+        
+        if(victim == UINT32_MAX)
+            return false;
+        
+        uint32_t begin = (uint32_t)seen;
+        uint32_t end = (uint32_t)(seen >> 32);
+        uint32_t middle = end - (end - begin + 1) / 2;
+        
+        // nobody else touches an empty queue, so self's can be refilled with a plain store once the steal went through
+        if(atomic_compare_exchange_strong(&job->queues[victim].range, &seen, steal_range(begin, middle))){
+            atomic_store(&job->queues[self].range, steal_range(middle, end));
+            return true;
+        }
+        
+        // the owner or another thief got there first, look again
+    }
+}
+
+static void* macho_stealing_worker(void *arg){
+    stealing_job *job = (stealing_job*)arg;
+    uint32_t self = atomic_fetch_add(&job->next_thread, 1);
+    uint32_t position;
+    
+    do{
+        while(macho_stealing_pop(&job->queues[self], &position))
+            job->fn(job->ctx, macho_stealing_index(job, position));
+    } while(macho_stealing_steal(job, self));
+    
+    return NULL;
+}
+
+void macho_parallel_for_stealing(uint32_t nthreads, uint32_t count, macho_parallel_fn fn, void *ctx){
+    stealing_job job;
+    
+    if(nthreads == 0)
+        nthreads = macho_cpu_count();
+    
+    if(nthreads > count)
+        nthreads = count;
+    
+    if(nthreads <= 1){
+        for(uint32_t i = 0; i < count; i++)
+            fn(ctx, i);
+        
+        return;
+    }
+    
+    job.fn = fn;
+    job.ctx = ctx;
+    job.nthreads = nthreads;
+    job.starts = calloc(nthreads + 1, sizeof(uint32_t));
+    job.queues = aligned_alloc(_Alignof(steal_queue), nthreads * sizeof(steal_queue));
+    atomic_init(&job.next_thread, 0);
+    
+    if(!job.starts || !job.queues){
+        free(job.starts);
+        free(job.queues);
+        macho_parallel_for_batch(nthreads, count, 1, fn, ctx);
+        return;
+    }
+    
+    // thread w gets the indices w, w + nthreads ... so the expensive first items are spread over every queue
+    for(uint32_t i = 0; i < nthreads; i++){
+        job.starts[i + 1] = job.starts[i] + (count - i + nthreads - 1) / nthreads;
+        atomic_init(&job.queues[i].range, steal_range(job.starts[i], job.starts[i + 1]));
+    }
+    
+    pthread_t *threads = calloc(nthreads - 1, sizeof(pthread_t));
+    uint32_t spawned = 0;
+    
+    for(uint32_t i = 0; threads && i < nthreads - 1; i++){
+        if(pthread_create(&threads[i], NULL, macho_stealing_worker, &job) != 0)
+            break;
+        
+        spawned++;
+    }
+    
+    // threads that failed to start leave their queues to be stolen by the ones that did and by the caller
+    macho_stealing_worker(&job);
+    
+    for(uint32_t i = 0; i < spawned; i++)
+        pthread_join(threads[i], NULL);
+    
+    free(threads);
+    free(job.starts);
+    free(job.queues);
+}
@@ -0,0 +1,24 @@
+#ifndef __thread_pool_h
+#define __thread_pool_h
+
+#include <stdint.h>
+
+typedef void (*macho_parallel_fn)(void *ctx, uint32_t index);
+
+// runs fn(ctx, i) for every i in [0, count) on up to nthreads threads (the caller included)
+// indices are handed out in small batches from a shared counter so uneven work still balances
+// returns once every index has been processed
+void macho_parallel_for(uint32_t nthreads, uint32_t count, macho_parallel_fn fn, void *ctx);
+
+// same with a caller chosen batch size, 1 for a few big items (e.g. the slices of a fat binary)
+void macho_parallel_for_batch(uint32_t nthreads, uint32_t count, uint32_t batch, macho_parallel_fn fn, void *ctx);
+
+// runs fn(ctx, i) for every i in [0, count) on work stealing queues, for items whose cost varies a lot (e.g. whole files)
+// each thread starts with every nthreads'th index from its own and steals half of the fullest queue once it runs dry
+// low indices are started first across all threads, so callers put the most expensive items first
+void macho_parallel_for_stealing(uint32_t nthreads, uint32_t count, macho_parallel_fn fn, void *ctx);
+
+// number of cpus online, used when the caller asks for 0 threads
+uint32_t macho_cpu_count(void);
+
+#endif
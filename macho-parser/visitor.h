@@ -0,0 +1,147 @@
+#ifndef __visitor_h
+#define __visitor_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * the library side of the parser: instead of being printed, everything is handed to the callbacks
+ * of a visitor as it's found (see macho_parse_visit in mach-o.h). callbacks left NULL cost nothing, their events aren't even built,
+ * and options.parts still decides which parts of an image get walked at all
+ * strings and data point into the mapped file or the parser's stack and are only valid during the callback
+ * the --format writers in output.h are visitors too
+ */
+
+typedef struct{
+    const char *cpu;      // architecture name, NULL for cpu types the parser doesn't know
+    int32_t cputype;
+    uint64_t offset;      // of the mach header in the file
+} macho_image_event;
+
+typedef struct{
+    uint32_t cmd;
+    uint32_t size;
+    uint64_t offset;
+    const void *data;     // the whole command, size bytes
+} macho_load_command_event;
+
+typedef struct{
+    const char *name;
+    uint64_t address;
+    uint64_t size;
+    uint64_t fileoff;     // from the start of the file, not of the slice
+    uint64_t filesize;
+} macho_segment_event;
+
+typedef struct{
+    const char *segment;
+    const char *name;
+    uint64_t address;
+    uint64_t size;
+    uint64_t offset;      // in the file, like fileoff of a segment
+} macho_section_event;
+
+typedef struct{
+    const char *name;
+    uint32_t current_version;
+    uint32_t compatibility_version;
+    uint32_t timestamp;
+} macho_dylib_event;
+
+typedef struct{
+    const char *name;
+    const char *type;     // N_SECT, N_UNDF ... NULL when answered from a --cache, which keeps defined symbols only
+    uint64_t value;
+    uint32_t size;        // only known to a --cache, 0 otherwise
+    const char *segment;  // likewise, NULL otherwise
+} macho_symbol_event;
+
+typedef struct{
+    const char *name;
+    bool metaclass;
+} macho_objc_class_event;
+
+typedef struct{
+    const char *classname;
+    const char *name;
+    uint64_t imp;
+    bool metaclass;
+} macho_objc_method_event;
+
+typedef struct{
+    const char *classname;
+    const char *name;
+    uint64_t offset;
+} macho_objc_ivar_event;
+
+typedef struct{
+    const char *classname;
+    const char *name;
+    const char *attributes;
+} macho_objc_property_event;
+
+typedef struct{
+    uint64_t offset;      // of the entry point from the mach header
+} macho_entry_point_event;
+
+typedef struct{
+    uint64_t address;
+} macho_function_event;
+
+typedef struct{
+    const char *kind;     // rebase, bind, weak bind or lazy bind
+    bool chained;         // from LC_DYLD_CHAINED_FIXUPS, target and flags are only set for those
+    const char *segment;
+    uint64_t address;
+    const char *symbol;   // NULL for rebases and binds to an import that's out of range
+    const char *dylib;    // where the symbol is bound from, NULL for rebases
+    int64_t addend;
+    uint64_t target;      // what a chained rebase points at
+    uint32_t flags;       // MACHO_CHAINED_ flags of a chained fixup
+} macho_fixup_event;
+
+typedef struct{
+    const char *name;
+    uint64_t flags;       // EXPORT_SYMBOL_FLAGS_
+    uint64_t address;     // 0 for re-exports
+    uint64_t other;       // dylib ordinal of a re-export or the resolver of a stub
+    const char *import_name; // name in the other dylib of a re-export, NULL otherwise
+} macho_export_symbol_event;
+
+typedef struct{
+    uint64_t address;
+    const char *symbol;   // NULL if no symbol covers the address
+    uint64_t offset;      // from the symbol, or from function when there's none
+    uint64_t function;    // start of the stripped function holding address, 0 when a symbol was found or nothing is known
+    const char *segment;  // only known to a --cache, NULL otherwise
+} macho_lookup_event;
+
+typedef struct{
+    uint32_t type;        // CSSLOT_ slot of the blob
+    uint32_t magic;       // CSMAGIC_
+    uint64_t offset;
+    uint32_t length;
+    const void *data;     // the whole blob, length bytes, big endian like on disk
+} macho_signature_blob_event;
+
+typedef struct macho_visitor{
+    void *ctx; // passed back to every callback
+    void (*image)(void *ctx, const macho_image_event *image);
+    void (*load_command)(void *ctx, const macho_load_command_event *command);
+    void (*segment)(void *ctx, const macho_segment_event *segment);
+    void (*section)(void *ctx, const macho_section_event *section);
+    void (*dylib)(void *ctx, const macho_dylib_event *dylib);
+    void (*symbol)(void *ctx, const macho_symbol_event *symbol);
+    void (*objc_class)(void *ctx, const macho_objc_class_event *objc_class);
+    void (*objc_method)(void *ctx, const macho_objc_method_event *method);
+    void (*objc_ivar)(void *ctx, const macho_objc_ivar_event *ivar);
+    void (*objc_property)(void *ctx, const macho_objc_property_event *property);
+    void (*entry_point)(void *ctx, const macho_entry_point_event *entry_point);
+    void (*function)(void *ctx, const macho_function_event *function);
+    void (*fixup)(void *ctx, const macho_fixup_event *fixup);
+    void (*export_symbol)(void *ctx, const macho_export_symbol_event *symbol);
+    void (*lookup)(void *ctx, const macho_lookup_event *lookup);
+    void (*signature_blob)(void *ctx, const macho_signature_blob_event *blob);
+} macho_visitor;
+
+#endif